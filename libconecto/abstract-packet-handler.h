@@ -20,8 +20,10 @@
 
 #pragma once
 
+#include "network-packet.h"
 #include <string>
 #include <memory>
+#include <vector>
 
 namespace Conecto {
 
@@ -36,6 +38,15 @@ class AbstractPacketHandler {
     AbstractPacketHandler () {}
     virtual ~AbstractPacketHandler () {}
 
+    /**
+     * @brief A request sent to a device once its connection has been secured
+     */
+    struct InitialRequest {
+        std::unique_ptr<NetworkPacket> packet;
+        /** @brief Type of the packet answering the request, empty if the device doesn't always answer */
+        std::string response_type;
+    };
+
     /**
      * Get the packet type this class is handling
      *
@@ -54,6 +65,18 @@ class AbstractPacketHandler {
      * @param device The device
      */
     void unregister_device (const std::shared_ptr<Device>& device) noexcept { return unregister_device_virt (device); }
+    /**
+     * Add the requests for the initial state of a (paired) device which has just connected
+     *
+     * The requests of all handlers are sent together.
+     *
+     * @param device The device
+     * @param requests [out] The requests
+     */
+    void add_initial_requests (const std::shared_ptr<Device>& device, std::vector<InitialRequest>& requests) noexcept
+    {
+        add_initial_requests_virt (device, requests);
+    }
 
     AbstractPacketHandler (const AbstractPacketHandler&) = delete;
     AbstractPacketHandler& operator= (const AbstractPacketHandler&) = delete;
@@ -62,6 +85,10 @@ class AbstractPacketHandler {
     virtual std::string get_packet_type_virt () const noexcept = 0;
     virtual void        register_device_virt (const std::shared_ptr<Device>& device) noexcept = 0;
     virtual void        unregister_device_virt (const std::shared_ptr<Device>& device) noexcept = 0;
+    virtual void        add_initial_requests_virt (const std::shared_ptr<Device>& device,
+                                                   std::vector<InitialRequest>&  requests) noexcept
+    {
+    }
 };
 
 } // namespace Conecto
\ No newline at end of file
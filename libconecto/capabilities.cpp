@@ -0,0 +1,192 @@
+/* capabilities.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "capabilities.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace Conecto;
+
+namespace {
+
+constexpr size_t WORD_BITS = 64;
+
+size_t
+popcount (uint64_t word)
+{
+    return static_cast<size_t> (__builtin_popcountll (word));
+}
+
+} // namespace
+
+CapabilityTable&
+CapabilityTable::get_instance ()
+{
+    static CapabilityTable instance;
+    return instance;
+}
+
+CapabilityTable::Id
+CapabilityTable::intern (const std::string& name)
+{
+    auto it = m_ids.find (name);
+    if (it != m_ids.end ()) return it->second;
+
+    Id id = static_cast<Id> (m_names.size ());
+    it = m_ids.insert ({ name, id }).first;
+    m_names.push_back (&it->first);
+    return id;
+}
+
+bool
+CapabilityTable::lookup (const std::string& name, Id& id) const noexcept
+{
+    auto it = m_ids.find (name);
+    if (it == m_ids.end ()) return false;
+    id = it->second;
+    return true;
+}
+
+const std::string&
+CapabilityTable::get_name (Id id) const
+{
+    return *m_names.at (id);
+}
+
+size_t
+CapabilityTable::size () const noexcept
+{
+    return m_names.size ();
+}
+
+void
+CapabilitySet::insert (CapabilityTable::Id id)
+{
+    size_t word = id / WORD_BITS;
+    if (word >= m_words.size ()) m_words.resize (word + 1, 0);
+    m_words[word] |= uint64_t (1) << (id % WORD_BITS);
+}
+
+void
+CapabilitySet::erase (CapabilityTable::Id id) noexcept
+{
+    size_t word = id / WORD_BITS;
+    if (word < m_words.size ()) m_words[word] &= ~(uint64_t (1) << (id % WORD_BITS));
+}
+
+bool
+CapabilitySet::contains (CapabilityTable::Id id) const noexcept
+{
+    size_t word = id / WORD_BITS;
+    return word < m_words.size () && (m_words[word] & (uint64_t (1) << (id % WORD_BITS))) != 0;
+}
+
+bool
+CapabilitySet::contains (const std::string& name) const noexcept
+{
+    CapabilityTable::Id id;
+    return CapabilityTable::get_instance ().lookup (name, id) && contains (id);
+}
+
+bool
+CapabilitySet::empty () const noexcept
+{
+    return std::all_of (m_words.begin (), m_words.end (), [] (uint64_t word) { return word == 0; });
+}
+
+size_t
+CapabilitySet::count () const noexcept
+{
+    size_t res = 0;
+    for (uint64_t word : m_words) res += popcount (word);
+    return res;
+}
+
+void
+CapabilitySet::clear () noexcept
+{
+    m_words.clear ();
+}
+
+std::vector<CapabilityTable::Id>
+CapabilitySet::get_ids () const
+{
+    std::vector<CapabilityTable::Id> res;
+    res.reserve (count ());
+    for (size_t i = 0; i < m_words.size (); i++) {
+        uint64_t word = m_words[i];
+        while (word) {
+            // Index of the lowest set bit
+            size_t bit = static_cast<size_t> (__builtin_ctzll (word));
+            res.push_back (static_cast<CapabilityTable::Id> (i * WORD_BITS + bit));
+            word &= word - 1;
+        }
+    }
+    return res;
+}
+
+std::vector<std::string>
+CapabilitySet::get_names () const
+{
+    const auto&              table = CapabilityTable::get_instance ();
+    std::vector<std::string> res;
+    res.reserve (count ());
+    for (auto id : get_ids ()) res.push_back (table.get_name (id));
+    return res;
+}
+
+CapabilitySet
+CapabilitySet::operator| (const CapabilitySet& other) const
+{
+    CapabilitySet res;
+    res.m_words.resize (std::max (m_words.size (), other.m_words.size ()), 0);
+    for (size_t i = 0; i < m_words.size (); i++) res.m_words[i] |= m_words[i];
+    for (size_t i = 0; i < other.m_words.size (); i++) res.m_words[i] |= other.m_words[i];
+    return res;
+}
+
+CapabilitySet
+CapabilitySet::operator& (const CapabilitySet& other) const
+{
+    CapabilitySet res;
+    res.m_words.resize (std::min (m_words.size (), other.m_words.size ()), 0);
+    for (size_t i = 0; i < res.m_words.size (); i++) res.m_words[i] = m_words[i] & other.m_words[i];
+    return res;
+}
+
+CapabilitySet
+CapabilitySet::operator^ (const CapabilitySet& other) const
+{
+    CapabilitySet res;
+    res.m_words.resize (std::max (m_words.size (), other.m_words.size ()), 0);
+    for (size_t i = 0; i < m_words.size (); i++) res.m_words[i] ^= m_words[i];
+    for (size_t i = 0; i < other.m_words.size (); i++) res.m_words[i] ^= other.m_words[i];
+    return res;
+}
+
+bool
+CapabilitySet::operator== (const CapabilitySet& other) const noexcept
+{
+    // Trailing zero words don't change the set, so compare the common prefix and check the rest is empty
+    const auto& shorter = m_words.size () < other.m_words.size () ? m_words : other.m_words;
+    const auto& longer = m_words.size () < other.m_words.size () ? other.m_words : m_words;
+    if (!std::equal (shorter.begin (), shorter.end (), longer.begin ())) return false;
+    return std::all_of (longer.begin () + shorter.size (), longer.end (), [] (uint64_t word) { return word == 0; });
+}
@@ -0,0 +1,132 @@
+/* capabilities.h
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace Conecto {
+
+/**
+ * @brief Global table of interned capability names
+ *
+ * Every capability name (e.g. kdeconnect.battery) is assigned a small integer id the first time it is seen. Ids are
+ * never reused or removed, so they can be compared and stored in a @p CapabilitySet instead of the full string.
+ *
+ * The table is not thread-safe and is expected to be used from the main loop only.
+ */
+class CapabilityTable {
+  public:
+    using Id = uint32_t;
+
+    static CapabilityTable& get_instance ();
+    ~CapabilityTable () {}
+
+    /**
+     * Get the id for a capability name, adding it to the table if it is not known yet
+     *
+     * @param name The capability name, e.g. kdeconnect.notification
+     * @return The interned id
+     */
+    Id intern (const std::string& name);
+    /**
+     * Look up the id of a capability name without adding it
+     *
+     * @param name The capability name
+     * @param id [out] The interned id (only set if the name is known)
+     * @return true if the name has already been interned
+     */
+    bool lookup (const std::string& name, Id& id) const noexcept;
+    /**
+     * Get the name of an interned capability
+     *
+     * @param id An id previously returned by @p intern
+     * @throw std::out_of_range
+     */
+    const std::string& get_name (Id id) const;
+    /** @brief The number of interned capabilities */
+    size_t size () const noexcept;
+
+    CapabilityTable (const CapabilityTable&) = delete;
+    CapabilityTable& operator= (const CapabilityTable&) = delete;
+
+  private:
+    CapabilityTable () {}
+
+    std::unordered_map<std::string, Id> m_ids;
+    std::vector<const std::string*>     m_names; // points to the keys of m_ids, which never move
+};
+
+/**
+ * @brief A set of capabilities stored as a bitset indexed by @p CapabilityTable ids
+ */
+class CapabilitySet {
+  public:
+    CapabilitySet () {}
+    ~CapabilitySet () {}
+
+    /**
+     * Build a set from a list of capability names, interning them as needed
+     *
+     * @param names Any iterable container of strings
+     */
+    template<class Container>
+    static CapabilitySet
+    from_names (const Container& names)
+    {
+        CapabilitySet res;
+        for (const auto& name : names) res.insert (CapabilityTable::get_instance ().intern (name));
+        return res;
+    }
+
+    /** @brief Add a capability to the set */
+    void insert (CapabilityTable::Id id);
+    /** @brief Remove a capability from the set */
+    void erase (CapabilityTable::Id id) noexcept;
+    /** @brief true if the capability is part of the set */
+    bool contains (CapabilityTable::Id id) const noexcept;
+    /** @brief true if the capability is part of the set (does not intern @p name) */
+    bool contains (const std::string& name) const noexcept;
+    /** @brief true if the set has no members */
+    bool empty () const noexcept;
+    /** @brief The number of members */
+    size_t count () const noexcept;
+    /** @brief Remove all members */
+    void clear () noexcept;
+
+    /** @brief Get the ids of all members in ascending order */
+    std::vector<CapabilityTable::Id> get_ids () const;
+    /** @brief Get the names of all members, ordered by their ids */
+    std::vector<std::string> get_names () const;
+
+    CapabilitySet operator| (const CapabilitySet& other) const;
+    CapabilitySet operator& (const CapabilitySet& other) const;
+    CapabilitySet operator^ (const CapabilitySet& other) const;
+    bool          operator== (const CapabilitySet& other) const noexcept;
+    bool          operator!= (const CapabilitySet& other) const noexcept { return !(*this == other); }
+
+  private:
+    std::vector<uint64_t> m_words;
+};
+
+} // namespace Conecto
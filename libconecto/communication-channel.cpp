@@ -33,19 +33,21 @@
 using namespace Conecto;
 
 CommunicationChannel::CommunicationChannel (const Glib::RefPtr<Gio::InetAddress>& host, uint16_t port)
+    : m_reader (NetworkPacket::create_reader ())
 {
     m_socket_addr = Gio::InetSocketAddress::create (host, port);
+    m_inbound_queue.signal_packet ().connect (
+            [this] (const NetworkPacket& packet) { m_signal_packet_received.emit (packet); });
 }
 
 bool
 CommunicationChannel::receive ()
 {
-    std::string data;
-
     g_assert (m_data_in);
 
-    // Read line up to a newline
-    if (!m_data_in->read_upto (data, "\n")) {
+    // Read line up to a newline (keeping the buffer's capacity from previous packets)
+    m_line.clear ();
+    if (!m_data_in->read_upto (m_line, "\n")) {
         g_warning ("I/O error, connection closed?");
         return false;
     }
@@ -58,11 +60,10 @@ CommunicationChannel::receive ()
         return false;
     }
 
-    g_debug ("Received line: %s", data.c_str ());
+    g_debug ("Received line: %s", m_line.c_str ());
 
     try {
-        NetworkPacket packet (data);
-        handle_packet (packet);
+        handle_packet (std::unique_ptr<NetworkPacket> (new NetworkPacket (m_line, *m_reader)));
         return true;
     } catch (MalformedPacketException& err) {
         g_warning ("Malformed packet: %s", err.what ());
@@ -83,12 +84,27 @@ CommunicationChannel::send (const NetworkPacket& packet)
         g_warning ("Failed to send message");
 }
 
+void
+CommunicationChannel::send (const std::vector<const NetworkPacket*>& packets)
+{
+    std::string to_send;
+    for (const auto* packet : packets) to_send += packet->serialize () + "\n";
+    g_debug ("Send %lu packets: %s", static_cast<unsigned long> (packets.size ()), to_send.c_str ());
+
+    if (!m_data_out)
+        g_warning ("Tried to send messages with no output stream");
+    else if (!m_data_out->put_string (to_send))
+        g_warning ("Failed to send messages");
+}
+
 void
 CommunicationChannel::close ()
 {
     g_debug ("Closing connection");
 
     unmonitor_events ();
+    // Packets which haven't been delivered yet belong to the closed connection
+    m_inbound_queue.clear ();
 
     try {
         if (m_data_in) m_data_in->close ();
@@ -177,15 +193,15 @@ CommunicationChannel::on_io_ready (Glib::IOCondition cond)
 }
 
 void
-CommunicationChannel::handle_packet (const NetworkPacket& packet)
+CommunicationChannel::handle_packet (std::unique_ptr<NetworkPacket> packet)
 {
-    if (packet.get_type () == PacketTypes::TYPE_ENCRYPTED)
+    if (packet->get_type () == PacketTypes::TYPE_ENCRYPTED)
         g_warning (
                 "Received packet with explicit encryption, this usually indicates a protocol version < 6 type packet, "
                 "such packets are no longer supported, dropping..");
     else
-        // Signal that we got a packet
-        m_signal_packet_received.emit (packet);
+        // Signal that we got a packet once it leaves the inbound queue
+        m_inbound_queue.push (std::move (packet));
 }
 
 void
@@ -21,6 +21,7 @@
 #pragma once
 
 #include "network-packet.h"
+#include "inbound-queue.h"
 #include <sigc++/sigc++.h>
 #include <giomm/inetsocketaddress.h>
 #include <giomm/socketconnection.h>
@@ -61,6 +62,12 @@ class CommunicationChannel {
      * @param packet instance of Packet
      */
     void send (const NetworkPacket& packet);
+    /**
+     * Send multiple packets using a single write
+     *
+     * @param packets The packets, in order
+     */
+    void send (const std::vector<const NetworkPacket*>& packets);
     /**
      * Close the communication channel
      */
@@ -88,6 +95,11 @@ class CommunicationChannel {
      * Get the peer certificate
      */
     Glib::RefPtr<Gio::TlsCertificate> get_peer_certificate () { return m_peer_certificate; }
+    /**
+     * Get the queue received packets pass through before @p signal_packet_received is emitted
+     */
+    InboundQueue& get_inbound_queue () { return m_inbound_queue; }
+    const InboundQueue& get_inbound_queue () const { return m_inbound_queue; }
 
     using type_signal_disconnected = sigc::signal<void>;
     /**
@@ -110,7 +122,7 @@ class CommunicationChannel {
     void replace_streams (const Glib::RefPtr<Gio::InputStream>& input, const Glib::RefPtr<Gio::OutputStream>& output);
     void monitor_events ();
     void unmonitor_events ();
-    void handle_packet (const NetworkPacket& packet);
+    void handle_packet (std::unique_ptr<NetworkPacket> packet);
     void fixup_socket ();
     bool on_io_ready (Glib::IOCondition cond);
 
@@ -125,6 +137,12 @@ class CommunicationChannel {
     Glib::RefPtr<Gio::Socket>            m_socket;
     Glib::RefPtr<Gio::TlsCertificate>    m_peer_certificate;
     Glib::RefPtr<Gio::SocketSource>      m_source;
+
+    // Reused for every received packet to avoid allocating a new reader and line buffer each time
+    std::unique_ptr<Json::CharReader> m_reader;
+    std::string                       m_line;
+
+    InboundQueue m_inbound_queue;
 };
 
 } // namespace Conecto
@@ -27,12 +27,21 @@
 #include "device.h"
 #include "network-packet.h"
 #include "communication-channel.h"
+#include "inbound-queue.h"
 #include "crypt.h"
 #include "config-file.h"
 #include "abstract-packet-handler.h"
+#include "capabilities.h"
 
 // Plugins
 #include "ping.h"
 #include "battery.h"
+#include "notification-store.h"
+#include "notification-icon-cache.h"
 #include "notifications.h"
-#include "mouse.h"
\ No newline at end of file
+#include "mouse.h"
+#include "input-backend.h"
+#include "input-backend-atspi.h"
+#include "input-backend-uinput.h"
+#include "input-backend-recording.h"
+#include "sms.h"
\ No newline at end of file
@@ -32,6 +32,8 @@ using namespace Conecto;
 namespace {
 
 constexpr int PAIR_TIMEOUT = 30;
+// Time to wait for the answers to the initial requests (in seconds)
+constexpr int WARM_UP_TIMEOUT = 10;
 
 } // namespace
 
@@ -46,6 +48,9 @@ Device::Device ()
     , m_certificate_fingerprint ("")
     , m_pair_in_progress (false)
     , m_pair_requested (false)
+    , m_connect_time (0)
+    , m_warmed_up (false)
+    , m_sync_duration (-1)
 {
 }
 
@@ -72,6 +77,7 @@ Device::create_from_packet (const NetworkPacket& packet, const Glib::RefPtr<Gio:
     for (Json::Value::ArrayIndex i = 0; i < body["outgoingCapabilities"].size (); i++)
         if (body["outgoingCapabilities"][i].isString ())
             res->m_outgoing_capabilities.push_back (body["outgoingCapabilities"][i].asString ());
+    res->update_identity_strings ();
 
     g_debug ("New device: %s", res->to_string ().c_str ());
     return res;
@@ -112,6 +118,7 @@ Device::create_from_cache (Glib::KeyFile& cache, const std::string& name)
         g_debug ("Failed to parse last known IP address (%s) for device %s", last_ip_str.c_str (), name.c_str ());
         throw InvalidIpAddressException (last_ip_str);
     }
+    res->update_identity_strings ();
 
     return res;
 }
@@ -203,6 +210,12 @@ Device::get_incoming_capabilities () const noexcept
     return m_incoming_capabilities;
 }
 
+const CapabilitySet&
+Device::get_capabilities () const noexcept
+{
+    return m_capabilities;
+}
+
 Glib::RefPtr<Gio::TlsCertificate>
 Device::get_certificate () const noexcept
 {
@@ -222,26 +235,46 @@ Device::get_certificate_fingerprint () const noexcept
     return m_certificate_fingerprint;
 }
 
+std::map<std::string, InboundQueue::Counters>
+Device::get_inbound_counters () const noexcept
+{
+    if (!m_channel) return std::map<std::string, InboundQueue::Counters> ();
+    return m_channel->get_inbound_queue ().get_counters ();
+}
+
+int64_t
+Device::get_sync_duration () const noexcept
+{
+    return m_sync_duration;
+}
+
 void
 Device::set_certificate (Glib::RefPtr<Gio::TlsCertificate> certificate) noexcept
 {
     m_certificate = certificate;
 }
 
-std::string
+const std::string&
 Device::to_string () const noexcept
 {
-    std::stringstream res;
-    res << m_device_id << "-" << m_device_name << "-" << m_device_type << "-" << m_protocol_version;
-    return res.str ();
+    return m_identity_string;
 }
 
-std::string
+const std::string&
 Device::to_unique_string () const noexcept
 {
-    std::string dev = to_string ();
-    std::replace (dev.begin (), dev.end (), '-', ' ');
-    return dev;
+    return m_unique_identity_string;
+}
+
+void
+Device::update_identity_strings () noexcept
+{
+    std::stringstream res;
+    res << m_device_id << "-" << m_device_name << "-" << m_device_type << "-" << m_protocol_version;
+    m_identity_string = res.str ();
+
+    m_unique_identity_string = m_identity_string;
+    std::replace (m_unique_identity_string.begin (), m_unique_identity_string.end (), '-', ' ');
 }
 
 void
@@ -259,6 +292,7 @@ Device::greet (std::function<void ()> cb) noexcept
         g_info ("Secure: %s", success ? "true" : "false");
         if (success) {
             update_certificate (m_channel->get_peer_certificate ());
+            if (m_is_paired) warm_up ();
         } else {
             g_warning ("Failed to enable secure channel");
             close_and_cleanup ();
@@ -266,6 +300,43 @@ Device::greet (std::function<void ()> cb) noexcept
     });
 }
 
+void
+Device::warm_up () noexcept
+{
+    m_warmed_up = true;
+
+    std::vector<AbstractPacketHandler::InitialRequest> requests;
+    for (const auto& handler : m_handlers) handler.second->add_initial_requests (shared_from_this (), requests);
+
+    std::vector<const NetworkPacket*> packets;
+    for (const auto& request : requests) {
+        packets.push_back (request.packet.get ());
+        if (!request.response_type.empty ()) m_pending_responses.insert (request.response_type);
+    }
+    if (!packets.empty ()) m_channel->send (packets);
+
+    if (m_pending_responses.empty ()) {
+        finish_warm_up ();
+        return;
+    }
+    m_warm_up_timeout_connection = Glib::signal_timeout ().connect_seconds (
+            [this] () {
+                g_warning ("Device %s didn't answer all initial requests", to_string ().c_str ());
+                m_pending_responses.clear ();
+                return false;
+            },
+            WARM_UP_TIMEOUT);
+}
+
+void
+Device::finish_warm_up () noexcept
+{
+    m_warm_up_timeout_connection.disconnect ();
+    m_sync_duration = g_get_monotonic_time () - m_connect_time;
+    g_info ("Device %s synced after %ld ms", to_string ().c_str (), static_cast<long> (m_sync_duration / 1000));
+    m_signal_synced.emit ();
+}
+
 void
 Device::pair (bool expect_response) noexcept
 {
@@ -339,6 +410,7 @@ Device::activate () noexcept
         close_and_cleanup ();
     });
     m_channel->signal_packet_received ().connect (sigc::mem_fun (*this, &Device::on_packet_received));
+    m_connect_time = g_get_monotonic_time ();
     m_channel->open ([this] (bool success) {
         g_debug ("Channel opened: %s", success ? "true" : "false");
         m_signal_connected.emit ();
@@ -375,6 +447,9 @@ Device::on_packet_received (const NetworkPacket& packet)
 
         // Emit signal
         m_signal_message.emit (packet);
+
+        // The device is synced once all initial requests have been answered
+        if (m_pending_responses.erase (packet.get_type ()) && m_pending_responses.empty ()) finish_warm_up ();
     }
 }
 
@@ -422,6 +497,9 @@ Device::handle_pair (bool pair) noexcept
         }
     }
 
+    // Paired while being connected
+    if (m_is_paired && !m_warmed_up && m_channel && m_channel->get_peer_certificate ()) warm_up ();
+
     m_signal_paired.emit (m_is_paired);
 }
 
@@ -439,37 +517,27 @@ Device::channel_closed_cleanup () noexcept
     m_channel.reset ();
 
     m_is_active = false;
+    m_warmed_up = false;
+    m_pending_responses.clear ();
+    m_warm_up_timeout_connection.disconnect ();
+    m_sync_duration = -1;
 
     // Emit signal
     m_signal_disconnected.emit ();
 }
 
 void
-Device::merge_capabilities (std::vector<std::string>& added, std::vector<std::string>& removed) noexcept
+Device::merge_capabilities (CapabilitySet& added, CapabilitySet& removed) noexcept
 {
-    std::list<std::string> capabilities;
-    for (const auto& cap : m_outgoing_capabilities) capabilities.push_back (cap);
-    for (const auto& cap : m_incoming_capabilities) capabilities.push_back (cap);
-
-    added.clear ();
-    added.reserve (capabilities.size ());
-    for (const auto& cap : capabilities) added.push_back (cap);
-
     // TODO: Simplify capability names by removing .request suffix
-    for (const auto& cap : m_capabilities) {
-        auto it = std::find (added.begin (), added.end (), cap);
-        if (it != added.end ()) added.erase (it);
-    }
+    CapabilitySet capabilities = CapabilitySet::from_names (m_outgoing_capabilities) |
+                                 CapabilitySet::from_names (m_incoming_capabilities);
 
-    removed.clear ();
-    removed.reserve (m_capabilities.size ());
-    for (const auto& cap : m_capabilities) removed.push_back (cap);
-    for (const auto& cap : capabilities) {
-        auto it = std::find (removed.begin (), removed.end (), cap);
-        if (it != removed.end ()) removed.erase (it);
-    }
+    CapabilitySet changed = capabilities ^ m_capabilities;
+    added = changed & capabilities;
+    removed = changed & m_capabilities;
 
-    m_capabilities.swap (capabilities);
+    m_capabilities = std::move (capabilities);
 }
 
 void
@@ -523,16 +591,19 @@ Device::update (const Device& device) noexcept
     m_outgoing_capabilities = device.m_outgoing_capabilities;
     m_incoming_capabilities = device.m_incoming_capabilities;
 
-    std::vector<std::string> added;
-    std::vector<std::string> removed;
+    CapabilitySet added;
+    CapabilitySet removed;
     merge_capabilities (added, removed);
 
-    for (const auto& cap : added) {
+    const auto& table = CapabilityTable::get_instance ();
+    for (auto id : added.get_ids ()) {
+        const std::string& cap = table.get_name (id);
         g_debug ("Added: %s", cap.c_str ());
         m_signal_capability_added.emit (cap);
     }
 
-    for (const auto& cap : removed) {
+    for (auto id : removed.get_ids ()) {
+        const std::string& cap = table.get_name (id);
         g_debug ("Removed: %s", cap.c_str ());
         m_signal_capability_removed.emit (cap);
         unregister_capability_handler (cap);
@@ -23,9 +23,11 @@
 #include "network-packet.h"
 #include "communication-channel.h"
 #include "abstract-packet-handler.h"
+#include "capabilities.h"
 #include <giomm/inetaddress.h>
 #include <giomm/tlscertificate.h>
 #include <glibmm/keyfile.h>
+#include <set>
 
 namespace Conecto {
 
@@ -97,6 +99,8 @@ class Device : public std::enable_shared_from_this<Device> {
     const std::list<std::string>& get_outgoing_capabilities () const noexcept;
     /** @brief Get a list of incoming capabilities */
     const std::list<std::string>& get_incoming_capabilities () const noexcept;
+    /** @brief Get the merged set of incoming and outgoing capabilities */
+    const CapabilitySet& get_capabilities () const noexcept;
     /** @brief Get the certificate used for encryption */
     Glib::RefPtr<Gio::TlsCertificate> get_certificate () const noexcept;
     /** @brief Get the PEM encoded certificate used for encryption */
@@ -104,6 +108,19 @@ class Device : public std::enable_shared_from_this<Device> {
     /** @brief Get the certificate's SHA1 encoded fingerprint */
     const std::string& get_certificate_fingerprint () const noexcept;
 
+    /**
+     * Get the inbound queue counters (e.g. coalesced or dropped packets) for each packet type received over the
+     * current connection. This is empty if the device is not active.
+     */
+    std::map<std::string, InboundQueue::Counters> get_inbound_counters () const noexcept;
+    /**
+     * Get the time from opening the current connection until the device has answered all initial requests (see
+     * @p AbstractPacketHandler::add_initial_requests), in microseconds
+     *
+     * @return -1 if the device isn't synced (yet)
+     */
+    int64_t get_sync_duration () const noexcept;
+
     /** @brief Update the certificate used for encryption */
     void set_certificate (Glib::RefPtr<Gio::TlsCertificate> certificate) noexcept;
 
@@ -113,11 +130,11 @@ class Device : public std::enable_shared_from_this<Device> {
     /**
      * Get a short string representing this device
      */
-    std::string to_string () const noexcept;
+    const std::string& to_string () const noexcept;
     /**
      * Get a short string representing this device
      */
-    std::string to_unique_string () const noexcept;
+    const std::string& to_unique_string () const noexcept;
 
     /**
      * Internally changes pair requests state tracking.
@@ -177,6 +194,7 @@ class Device : public std::enable_shared_from_this<Device> {
     using type_signal_connected = sigc::signal<void>;
     using type_signal_disconnected = sigc::signal<void>;
     using type_signal_pair_request = sigc::signal<void>;
+    using type_signal_synced = sigc::signal<void>;
     /**
      * @param message The packet received
      */
@@ -205,6 +223,10 @@ class Device : public std::enable_shared_from_this<Device> {
      * Emitted when we are disconnected from the device
      */
     type_signal_disconnected signal_disconnected () { return m_signal_disconnected; }
+    /**
+     * Emitted when the device has answered all initial requests after connecting
+     */
+    type_signal_synced signal_synced () { return m_signal_synced; }
     /**
      * Emitted when we received a new packet from the device
      */
@@ -228,6 +250,11 @@ class Device : public std::enable_shared_from_this<Device> {
     Device ();
 
     void greet (std::function<void ()> cb) noexcept;
+    /**
+     * Send the initial requests of all handlers
+     */
+    void warm_up () noexcept;
+    void finish_warm_up () noexcept;
     bool on_pair_timeout ();
     void on_packet_received (const NetworkPacket& packet);
     void handle_pair (bool pair) noexcept;
@@ -235,12 +262,16 @@ class Device : public std::enable_shared_from_this<Device> {
     void channel_closed_cleanup () noexcept;
     /**
      * Merge and update existing outgoing_capabilities and incoming_capabilities.
-     * Returns lists of added and removed capabilities.
+     * Returns sets of added and removed capabilities.
      *
      * @param added [out] Capabilities that were added
      * @param removed [out] Capabilities that were removed
      */
-    void merge_capabilities (std::vector<std::string>& added, std::vector<std::string>& removed) noexcept;
+    void merge_capabilities (CapabilitySet& added, CapabilitySet& removed) noexcept;
+    /**
+     * Rebuild the cached strings returned by @p to_string and @p to_unique_string
+     */
+    void update_identity_strings () noexcept;
     void update_certificate (const Glib::RefPtr<Gio::TlsCertificate>& certificate) noexcept;
 
     type_signal_paired             m_signal_paired;
@@ -250,6 +281,7 @@ class Device : public std::enable_shared_from_this<Device> {
     type_signal_pair_request       m_signal_pair_request;
     type_signal_capability_added   m_signal_capability_added;
     type_signal_capability_removed m_signal_capability_removed;
+    type_signal_synced             m_signal_synced;
 
     std::string                           m_device_id;
     std::string                           m_device_name;
@@ -261,13 +293,21 @@ class Device : public std::enable_shared_from_this<Device> {
     bool                                  m_is_active;
     std::list<std::string>                m_outgoing_capabilities;
     std::list<std::string>                m_incoming_capabilities;
-    std::list<std::string>                m_capabilities;
+    CapabilitySet                         m_capabilities;
     Glib::RefPtr<Gio::TlsCertificate>     m_certificate;
     std::string                           m_certificate_fingerprint;
     bool                                  m_pair_in_progress; // set to true if pair request was sent
     bool                                  m_pair_requested; // set to true if the client sent a pair request
     sigc::connection                      m_pair_timeout_connection;
     std::unique_ptr<CommunicationChannel> m_channel;
+    std::string                           m_identity_string;
+    std::string                           m_unique_identity_string;
+    // Monotonic time at which the current connection has been opened
+    int64_t                               m_connect_time;
+    bool                                  m_warmed_up; // set to true once the initial requests have been sent
+    std::set<std::string>                 m_pending_responses; // response types of the initial requests
+    sigc::connection                      m_warm_up_timeout_connection;
+    int64_t                               m_sync_duration;
 
     std::map<std::string, std::shared_ptr<AbstractPacketHandler>> m_handlers;
 };
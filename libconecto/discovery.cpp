@@ -34,6 +34,7 @@ constexpr guint16 SOCKET_PORT = 1716;
 } // namespace
 
 Discovery::Discovery ()
+    : m_reader (NetworkPacket::create_reader ())
 {
 }
 
@@ -68,9 +69,10 @@ Discovery::on_packet (Glib::IOCondition condition)
     char                                 buffer[4096];
     Glib::RefPtr<Gio::SocketAddress>     socket_addr;
     Glib::RefPtr<Gio::InetSocketAddress> inet_socket_addr;
+    gssize                               read = 0;
 
     try {
-        gssize read = m_socket->receive_from (socket_addr, buffer, 4096);
+        read = m_socket->receive_from (socket_addr, buffer, 4096);
         inet_socket_addr = Glib::RefPtr<Gio::InetSocketAddress>::cast_dynamic (socket_addr);
         g_debug ("Received %zd bytes from %s:%u", read, inet_socket_addr->get_address ()->to_string ().c_str (),
                  inet_socket_addr->get_port ());
@@ -79,7 +81,8 @@ Discovery::on_packet (Glib::IOCondition condition)
         return true;
     }
 
-    parse_packet (std::string (buffer), inet_socket_addr->get_address ());
+    // The datagram is not null-terminated
+    parse_packet (std::string (buffer, static_cast<size_t> (read)), inet_socket_addr->get_address ());
 
     return true;
 }
@@ -88,7 +91,7 @@ void
 Discovery::parse_packet (std::string&& data, const Glib::RefPtr<Gio::InetAddress>& host)
 {
     try {
-        NetworkPacket packet (data);
+        NetworkPacket packet (data, *m_reader);
 
         // Expecting an identity packet
         if (packet.get_type () != PacketTypes::TYPE_IDENTITY) {
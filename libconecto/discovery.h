@@ -65,7 +65,8 @@ class Discovery {
 
     type_signal_device_found m_signal_device_found;
 
-    Glib::RefPtr<Gio::Socket> m_socket;
+    Glib::RefPtr<Gio::Socket>         m_socket;
+    std::unique_ptr<Json::CharReader> m_reader;
 };
 
 } // namespace Conecto
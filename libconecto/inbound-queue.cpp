@@ -0,0 +1,219 @@
+/* inbound-queue.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "inbound-queue.h"
+#include <glibmm/main.h>
+
+using namespace Conecto;
+
+namespace {
+
+constexpr size_t DEFAULT_DROP_THRESHOLD = 64;
+
+bool
+is_motion (const Json::Value& body)
+{
+    return body["dx"].isNumeric () && body["dy"].isNumeric ();
+}
+
+/**
+ * Check if two motion packets only differ in their dx/dy members
+ */
+bool
+can_sum (const Json::Value& a, const Json::Value& b)
+{
+    if (!is_motion (a) || !is_motion (b) || a.size () != b.size ()) return false;
+    for (const auto& name : a.getMemberNames ()) {
+        if (name == "dx" || name == "dy") continue;
+        if (!b.isMember (name) || a[name] != b[name]) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+// Deliver synchronously once this many packets are pending, so that idle callbacks can't be starved by I/O forever
+constexpr size_t InboundQueue::MAX_PENDING;
+// Types are chosen by the peer, so their number needs to be limited
+constexpr size_t InboundQueue::MAX_COUNTED_TYPES;
+constexpr char   InboundQueue::OTHER_TYPES[];
+
+InboundQueue::InboundQueue ()
+    : m_drop_threshold (DEFAULT_DROP_THRESHOLD)
+    , m_alive (std::make_shared<bool> (true))
+{
+    // Only the latest state matters for these types
+    m_policies["kdeconnect.battery"] = Policy::COALESCE_LATEST;
+    m_policies["kdeconnect.mousepad.request"] = Policy::SUM_DELTAS;
+}
+
+InboundQueue::~InboundQueue ()
+{
+    m_dispatch_connection.disconnect ();
+}
+
+void
+InboundQueue::set_policy (const std::string& type, Policy policy) noexcept
+{
+    m_policies[type] = policy;
+}
+
+InboundQueue::Policy
+InboundQueue::get_policy (const std::string& type) const noexcept
+{
+    auto it = m_policies.find (type);
+    return it == m_policies.end () ? Policy::DELIVER_ALL : it->second;
+}
+
+void
+InboundQueue::set_drop_threshold (size_t threshold) noexcept
+{
+    m_drop_threshold = threshold;
+}
+
+size_t
+InboundQueue::size () const noexcept
+{
+    return m_queue.size ();
+}
+
+const std::map<std::string, InboundQueue::Counters>&
+InboundQueue::get_counters () const noexcept
+{
+    return m_counters;
+}
+
+InboundQueue::Counters&
+InboundQueue::get_counters (const std::string& type)
+{
+    auto it = m_counters.find (type);
+    if (it != m_counters.end ()) return it->second;
+    return m_counters[m_counters.size () < MAX_COUNTED_TYPES ? type : OTHER_TYPES];
+}
+
+void
+InboundQueue::push (std::unique_ptr<NetworkPacket> packet)
+{
+    Counters& counters = get_counters (packet->get_type ());
+    counters.received++;
+
+    switch (get_policy (packet->get_type ())) {
+    case Policy::COALESCE_LATEST:
+        if (try_coalesce (packet, counters)) return;
+        break;
+    case Policy::SUM_DELTAS:
+        if (try_sum_deltas (packet, counters)) return;
+        break;
+    case Policy::DROP_WHEN_BUSY:
+        if (m_queue.size () >= m_drop_threshold) {
+            counters.dropped++;
+            g_debug ("Dropping %s packet, %zu packets pending", packet->get_type ().c_str (), m_queue.size ());
+            return;
+        }
+        // fall through
+    case Policy::DELIVER_ALL: {
+        // Nothing to merge with, only wait for the packets received before
+        std::weak_ptr<bool> alive = m_alive;
+        flush ();
+        if (alive.expired ()) return;
+        counters.delivered++;
+        deliver (*packet);
+        return;
+    }
+    }
+
+    m_queue.push_back (std::move (packet));
+
+    if (m_queue.size () >= MAX_PENDING)
+        flush ();
+    else if (!m_dispatch_connection.connected ())
+        m_dispatch_connection = Glib::signal_idle ().connect (sigc::mem_fun (*this, &InboundQueue::on_dispatch));
+}
+
+bool
+InboundQueue::try_coalesce (std::unique_ptr<NetworkPacket>& packet, Counters& counters) noexcept
+{
+    for (auto& pending : m_queue) {
+        if (pending->get_type () == packet->get_type ()) {
+            // Latest value wins, but keep the older packet's position in the queue
+            pending = std::move (packet);
+            counters.coalesced++;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+InboundQueue::try_sum_deltas (std::unique_ptr<NetworkPacket>& packet, Counters& counters)
+{
+    // Only merge with the last packet, otherwise the deltas would be reordered with e.g. clicks
+    if (m_queue.empty ()) return false;
+    auto& last = m_queue.back ();
+    if (last->get_type () != packet->get_type () || last->get_payload () || packet->get_payload ()) return false;
+    if (!can_sum (last->get_body (), packet->get_body ())) return false;
+
+    Json::Value body = last->get_body ();
+    body["dx"] = body["dx"].asDouble () + packet->get_body ()["dx"].asDouble ();
+    body["dy"] = body["dy"].asDouble () + packet->get_body ()["dy"].asDouble ();
+    last.reset (new NetworkPacket (last->get_type (), body, last->get_id ()));
+    counters.coalesced++;
+    return true;
+}
+
+void
+InboundQueue::flush ()
+{
+    m_dispatch_connection.disconnect ();
+
+    std::deque<std::unique_ptr<NetworkPacket>> pending;
+    pending.swap (m_queue);
+
+    for (const auto& packet : pending) {
+        get_counters (packet->get_type ()).delivered++;
+        if (!deliver (*packet)) return;
+    }
+}
+
+void
+InboundQueue::clear () noexcept
+{
+    m_dispatch_connection.disconnect ();
+    m_queue.clear ();
+}
+
+bool
+InboundQueue::deliver (const NetworkPacket& packet)
+{
+    // A handler may close the connection owning this queue
+    std::weak_ptr<bool> alive = m_alive;
+    m_signal_packet.emit (packet);
+    return !alive.expired ();
+}
+
+bool
+InboundQueue::on_dispatch ()
+{
+    m_dispatch_connection = sigc::connection ();
+    flush ();
+
+    // Remove idle source
+    return false;
+}
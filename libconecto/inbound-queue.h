@@ -0,0 +1,141 @@
+/* inbound-queue.h
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "network-packet.h"
+#include <deque>
+#include <map>
+#include <sigc++/sigc++.h>
+
+namespace Conecto {
+
+/**
+ * @brief Queue for received packets with per-type delivery policies
+ *
+ * Packets of types which can be merged (@p Policy::COALESCE_LATEST and @p Policy::SUM_DELTAS) are delivered from an
+ * idle callback, so those received while the main loop is busy are merged instead of being processed one by one. Other
+ * packets are delivered immediately, after the pending packets received before them.
+ */
+class InboundQueue {
+  public:
+    /**
+     * @brief What to do with a packet of a given type while older packets are still pending
+     */
+    enum class Policy {
+        /** Deliver every packet */
+        DELIVER_ALL,
+        /** Replace a pending packet of the same type with the new one */
+        COALESCE_LATEST,
+        /** Add the dx/dy members to the previous packet if it has the same type and otherwise equal members */
+        SUM_DELTAS,
+        /** Drop the packet if the queue is longer than the drop threshold */
+        DROP_WHEN_BUSY
+    };
+
+    /** @brief Pending packets are delivered synchronously once this many are queued */
+    static constexpr size_t MAX_PENDING = 256;
+    /** @brief Counters are kept for this many packet types, packets of further types are counted as @p OTHER_TYPES */
+    static constexpr size_t MAX_COUNTED_TYPES = 64;
+    static constexpr char   OTHER_TYPES[] = "other";
+
+    /**
+     * @brief Statistics for a single packet type
+     */
+    struct Counters {
+        uint64_t received = 0;
+        uint64_t delivered = 0;
+        uint64_t coalesced = 0;
+        uint64_t dropped = 0;
+    };
+
+    /**
+     * Create a new queue using the default policies for the built-in packet types
+     */
+    InboundQueue ();
+    ~InboundQueue ();
+
+    /**
+     * Set the policy for a packet type (the default is @p Policy::DELIVER_ALL)
+     *
+     * @param type The packet type, e.g. kdeconnect.battery
+     * @param policy The new policy
+     */
+    void set_policy (const std::string& type, Policy policy) noexcept;
+    /** @brief Get the policy for a packet type */
+    Policy get_policy (const std::string& type) const noexcept;
+    /** @brief Set the queue length above which @p Policy::DROP_WHEN_BUSY packets are dropped */
+    void set_drop_threshold (size_t threshold) noexcept;
+
+    /**
+     * Queue a received packet and schedule its delivery
+     *
+     * @param packet The packet
+     */
+    void push (std::unique_ptr<NetworkPacket> packet);
+    /**
+     * Deliver all pending packets immediately
+     */
+    void flush ();
+    /**
+     * Drop all pending packets (e.g. because the connection has been closed)
+     */
+    void clear () noexcept;
+    /** @brief The number of pending packets */
+    size_t size () const noexcept;
+    /** @brief Get the counters for each packet type seen so far (see @p MAX_COUNTED_TYPES) */
+    const std::map<std::string, Counters>& get_counters () const noexcept;
+
+    /**
+     * @param packet The packet to be delivered
+     */
+    using type_signal_packet = sigc::signal<void, const NetworkPacket& /* packet */>;
+    /**
+     * Emitted for every packet leaving the queue
+     */
+    type_signal_packet signal_packet () { return m_signal_packet; }
+
+    InboundQueue (const InboundQueue&) = delete;
+    InboundQueue& operator= (const InboundQueue&) = delete;
+
+  private:
+    bool try_coalesce (std::unique_ptr<NetworkPacket>& packet, Counters& counters) noexcept;
+    bool try_sum_deltas (std::unique_ptr<NetworkPacket>& packet, Counters& counters);
+    /**
+     * Emit @p packet
+     *
+     * @return false if a signal handler has destroyed the queue
+     */
+    bool deliver (const NetworkPacket& packet);
+    Counters& get_counters (const std::string& type);
+    bool      on_dispatch ();
+
+    type_signal_packet m_signal_packet;
+
+    std::deque<std::unique_ptr<NetworkPacket>> m_queue;
+    std::map<std::string, Policy>              m_policies;
+    std::map<std::string, Counters>            m_counters;
+    size_t                                     m_drop_threshold;
+    sigc::connection                           m_dispatch_connection;
+    // Used to detect if a signal handler destroyed the queue during delivery
+    std::shared_ptr<bool> m_alive;
+};
+
+} // namespace Conecto
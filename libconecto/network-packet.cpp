@@ -39,31 +39,35 @@ NetworkPacket::NetworkPacket (const std::string& type, const Json::Value& body,
 }
 
 NetworkPacket::NetworkPacket (const std::string& data)
+    : NetworkPacket (data, *create_reader ())
 {
-    Json::CharReaderBuilder           builder;
-    std::unique_ptr<Json::CharReader> reader (builder.newCharReader ());
+}
 
+NetworkPacket::NetworkPacket (const std::string& data, Json::CharReader& reader)
+{
     Json::Value val;
     std::string err;
-    if (!reader->parse (data.c_str (), data.c_str () + data.size (), &val, &err) || !val.isObject ())
+    if (!reader.parse (data.c_str (), data.c_str () + data.size (), &val, &err) || !val.isObject ())
         throw MalformedPacketException ("Invalid JSON");
 
     // Object needs to have these fields
-    if (!val["type"].isString ()) throw MalformedPacketException ("Missing 'type' member");
-    if (!val["id"].isInt64 ()) throw MalformedPacketException ("Missing 'id' member");
-    if (!val["body"].isObject ()) throw MalformedPacketException ("Missing 'body' member");
+    const Json::Value& doc = val;
+    if (!doc["type"].isString ()) throw MalformedPacketException ("Missing 'type' member");
+    if (!doc["id"].isInt64 ()) throw MalformedPacketException ("Missing 'id' member");
+    if (!doc["body"].isObject ()) throw MalformedPacketException ("Missing 'body' member");
 
-    m_type = val["type"].asString ();
-    m_id = val["id"].asInt64 ();
-    m_body = val["body"];
+    m_type = doc["type"].asString ();
+    m_id = doc["id"].asInt64 ();
+    // The parsed document is thrown away afterwards, so take the body instead of copying it
+    m_body.swap (val["body"]);
 
     // Ignore payload info for encrypted packets
     if (m_type == PacketTypes::TYPE_ENCRYPTED) return;
 
-    if (val["payloadSize"].isInt () && val["payloadTransferInfo"].isObject ()) {
-        int         size = val["payloadSize"].asInt ();
-        Json::Value transfer_info = val["payloadTransferInfo"];
-        int         port = 0;
+    if (doc["payloadSize"].isInt () && doc["payloadTransferInfo"].isObject ()) {
+        int                size = doc["payloadSize"].asInt ();
+        const Json::Value& transfer_info = doc["payloadTransferInfo"];
+        int                port = 0;
         if (!transfer_info["port"].asInt ())
             g_warning ("No payload transfer info");
         else
@@ -73,6 +77,13 @@ NetworkPacket::NetworkPacket (const std::string& data)
     }
 }
 
+std::unique_ptr<Json::CharReader>
+NetworkPacket::create_reader ()
+{
+    Json::CharReaderBuilder builder;
+    return std::unique_ptr<Json::CharReader> (builder.newCharReader ());
+}
+
 std::shared_ptr<NetworkPacket>
 NetworkPacket::create_pair (bool pair)
 {
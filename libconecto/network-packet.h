@@ -53,6 +53,17 @@ class NetworkPacket {
      * @throw MalformedPacketException
      */
     NetworkPacket (const std::string& data);
+    /**
+     * Create a new @p NetworkPacket from a stringified JSON value using an existing reader
+     *
+     * Creating a JSON reader is expensive, so callers decoding many packets (e.g. a @p CommunicationChannel) should
+     * create one using @p create_reader and reuse it for every packet.
+     *
+     * @param data The JSON data
+     * @param reader The reader used for parsing @p data
+     * @throw MalformedPacketException
+     */
+    NetworkPacket (const std::string& data, Json::CharReader& reader);
     /**
      * Create a new network packet with the type @p Constants::TYPE_PAIR
      */
@@ -66,6 +77,11 @@ class NetworkPacket {
                                                            const std::string&            device_type = "desktop");
     ~NetworkPacket () {}
 
+    /**
+     * Create a JSON reader which can be passed to the @p NetworkPacket constructor
+     */
+    static std::unique_ptr<Json::CharReader> create_reader ();
+
     /**
      * A wrapper structure for payload transfer information
      */
@@ -21,15 +21,133 @@
 #include "battery.h"
 #include "device.h"
 #include "network-packet.h"
+#include <glib.h>
 
 using namespace Conecto::Plugins;
 
 namespace {
 
 constexpr char PACKET_TYPE[] = "kdeconnect.battery";
+constexpr char PACKET_TYPE_REQUEST[] = "kdeconnect.battery.request";
+
+constexpr int64_t MINUTE = 60ll * 1000000;
+constexpr int64_t HOUR = 60 * MINUTE;
+// Resolution of each tier of the battery history
+constexpr int64_t TIER_RESOLUTIONS[BatteryHistory::TIER_COUNT] = { 0, 10 * MINUTE, HOUR };
+// Samples used for estimating the discharge rate
+constexpr int64_t RATE_WINDOW = 3 * HOUR;
+constexpr int64_t MIN_RATE_SPAN = 15 * MINUTE;
 
 } // namespace
 
+constexpr size_t BatteryHistory::TIER_CAPACITY;
+constexpr size_t BatteryHistory::TIER_COUNT;
+
+BatteryHistory::BatteryHistory ()
+{
+    for (size_t i = 0; i < TIER_COUNT; i++) {
+        m_tiers[i].resolution = TIER_RESOLUTIONS[i];
+        m_tiers[i].first = 0;
+        m_tiers[i].size = 0;
+    }
+}
+
+void
+BatteryHistory::add (int64_t time, int level, bool charging)
+{
+    // Devices resend their level when reconnecting
+    if (!empty () && get_last ().level == level && get_last ().charging == charging) return;
+    push (0, { time, static_cast<float> (level), charging, 1 });
+}
+
+void
+BatteryHistory::push (size_t index, const Sample& sample)
+{
+    Tier& tier = m_tiers[index];
+    if (tier.resolution > 0 && tier.size > 0) {
+        // Merge with the newest sample if it belongs to the same interval
+        Sample& last = tier.at (tier.size - 1);
+        if (last.time / tier.resolution == sample.time / tier.resolution && last.charging == sample.charging) {
+            last.level = (last.level * last.count + sample.level * sample.count) / (last.count + sample.count);
+            last.count += sample.count;
+            last.time = sample.time;
+            return;
+        }
+    }
+
+    if (tier.size == TIER_CAPACITY) {
+        Sample evicted = tier.at (0);
+        tier.first = (tier.first + 1) % TIER_CAPACITY;
+        tier.size--;
+        if (index + 1 < TIER_COUNT) push (index + 1, evicted);
+    }
+    tier.at (tier.size++) = sample;
+}
+
+const BatteryHistory::Sample&
+BatteryHistory::get_last () const
+{
+    g_assert (!empty ());
+    return m_tiers[0].at (m_tiers[0].size - 1);
+}
+
+std::vector<BatteryHistory::Sample>
+BatteryHistory::get_samples () const
+{
+    std::vector<Sample> res;
+    for (size_t index = TIER_COUNT; index-- > 0;) {
+        for (size_t i = 0; i < m_tiers[index].size; i++) res.push_back (m_tiers[index].at (i));
+    }
+    return res;
+}
+
+bool
+BatteryHistory::get_discharge_rate (double& rate) const
+{
+    if (empty () || get_last ().charging) return false;
+
+    // Least squares fit of the samples since the device has stopped charging, newest first
+    int64_t newest = get_last ().time;
+    int64_t oldest = newest;
+    double  sum_t = 0, sum_l = 0, sum_tt = 0, sum_tl = 0;
+    int     n = 0;
+    bool    done = false;
+    for (size_t index = 0; index < TIER_COUNT && !done; index++) {
+        const Tier& tier = m_tiers[index];
+        for (size_t i = tier.size; i-- > 0;) {
+            const Sample& sample = tier.at (i);
+            if (sample.charging || newest - sample.time > RATE_WINDOW) {
+                done = true;
+                break;
+            }
+            // Hours relative to the newest sample, keeps the sums small
+            double t = static_cast<double> (sample.time - newest) / HOUR;
+            sum_t += t;
+            sum_l += sample.level;
+            sum_tt += t * t;
+            sum_tl += t * sample.level;
+            oldest = sample.time;
+            n++;
+        }
+    }
+    if (n < 2 || newest - oldest < MIN_RATE_SPAN) return false;
+
+    double denominator = n * sum_tt - sum_t * sum_t;
+    if (denominator <= 0) return false;
+    rate = -(n * sum_tl - sum_t * sum_l) / denominator;
+    return true;
+}
+
+bool
+BatteryHistory::get_time_to_empty (int64_t& time) const
+{
+    double rate;
+    if (!get_discharge_rate (rate) || rate <= 0) return false;
+
+    time = static_cast<int64_t> (get_last ().level / rate * HOUR);
+    return true;
+}
+
 Battery::Battery ()
     : AbstractPacketHandler ()
 {
@@ -57,6 +175,16 @@ Battery::unregister_device_virt (const std::shared_ptr<Device>& device) noexcept
     }
 }
 
+void
+Battery::add_initial_requests_virt (const std::shared_ptr<Device>& device,
+                                    std::vector<InitialRequest>&  requests) noexcept
+{
+    // The device answers with its current level
+    Json::Value body (Json::objectValue);
+    body["request"] = true;
+    requests.push_back ({ std::make_unique<NetworkPacket> (PACKET_TYPE_REQUEST, body), PACKET_TYPE });
+}
+
 void
 Battery::on_message (const NetworkPacket& message, const std::shared_ptr<Device>& device)
 {
@@ -64,13 +192,21 @@ Battery::on_message (const NetworkPacket& message, const std::shared_ptr<Device>
 
     int  level = std::min (std::max (message.get_body ()["currentCharge"].asInt (), 0), 100);
     bool charging = message.get_body ()["isCharging"].asBool ();
-    m_values[device->to_unique_string ()] = std::make_tuple (level, charging);
+    m_histories[device].add (g_get_monotonic_time (), level, charging);
     m_signal_battery.emit (device, level, charging);
 }
 
 std::tuple<int, bool>
 Battery::get_last_value (const std::shared_ptr<Device>& device) const
 {
-    if (m_values.find (device->to_unique_string ()) == m_values.end ()) return std::make_tuple (0, false);
-    return m_values.at (device->to_unique_string ());
+    const BatteryHistory* history = get_history (device);
+    if (!history) return std::make_tuple (0, false);
+    return std::make_tuple (static_cast<int> (history->get_last ().level), history->get_last ().charging);
+}
+
+const BatteryHistory*
+Battery::get_history (const std::shared_ptr<Device>& device) const
+{
+    auto it = m_histories.find (device);
+    return it == m_histories.end () ? nullptr : &it->second;
 }
\ No newline at end of file
@@ -21,7 +21,9 @@
 #pragma once
 
 #include "abstract-packet-handler.h"
+#include <array>
 #include <map>
+#include <vector>
 #include <sigc++/sigc++.h>
 
 namespace Conecto {
@@ -30,8 +32,82 @@ class NetworkPacket;
 
 namespace Plugins {
 
+/**
+ * @brief Battery levels of a device over time, using a fixed amount of memory
+ *
+ * Samples are stored in tiers of ring buffers: The newest samples are kept as received, samples dropped from a tier
+ * are averaged into the next tier, which has a coarser resolution (10 minutes, then 1 hour). Samples dropped from the
+ * last tier are discarded.
+ */
+class BatteryHistory {
+  public:
+    struct Sample {
+        /** @brief Monotonic time in microseconds (of the newest sample for aggregated samples) */
+        int64_t time;
+        /** @brief Battery level [0..100] (the average for aggregated samples) */
+        float   level;
+        bool    charging;
+        /** @brief Number of received samples aggregated into this one */
+        int     count;
+    };
+
+    /** @brief Number of samples per tier */
+    static constexpr size_t TIER_CAPACITY = 48;
+    static constexpr size_t TIER_COUNT = 3;
+
+    BatteryHistory ();
+    ~BatteryHistory () {}
+
+    /**
+     * Add a sample received at @p time (monotonic time in microseconds, not older than the previous sample)
+     *
+     * Samples which don't differ from the previous one are ignored.
+     */
+    void add (int64_t time, int level, bool charging);
+
+    /** @brief true if no samples have been added */
+    bool empty () const noexcept { return m_tiers[0].size == 0; }
+    /** @brief The newest sample (the history must not be empty) */
+    const Sample& get_last () const;
+    /** @brief All stored samples, oldest first */
+    std::vector<Sample> get_samples () const;
+
+    /**
+     * Estimate the discharge rate from the samples received since the device has stopped charging (up to 3 hours)
+     *
+     * @param rate Set to the rate in percent per hour (positive while discharging)
+     * @return false if there aren't enough samples
+     */
+    bool get_discharge_rate (double& rate) const;
+    /**
+     * Estimate the time until the battery is empty, counted from the newest sample
+     *
+     * @param time Set to the time in microseconds
+     * @return false if the device is charging or the battery isn't discharging
+     */
+    bool get_time_to_empty (int64_t& time) const;
+
+  private:
+    struct Tier {
+        /** @brief Samples within the same interval are aggregated (0 for received samples) */
+        int64_t                           resolution;
+        std::array<Sample, TIER_CAPACITY> samples;
+        size_t                            first;
+        size_t                            size;
+
+        Sample&       at (size_t i) { return samples[(first + i) % TIER_CAPACITY]; }
+        const Sample& at (size_t i) const { return samples[(first + i) % TIER_CAPACITY]; }
+    };
+
+    void push (size_t tier, const Sample& sample);
+
+    std::array<Tier, TIER_COUNT> m_tiers;
+};
+
 /**
  * @brief Battery level plugin
+ *
+ * Keeps a @p BatteryHistory for every device.
  */
 class Battery : public AbstractPacketHandler {
   public:
@@ -45,6 +121,12 @@ class Battery : public AbstractPacketHandler {
      * Get the last battery level and charging flag for a device
      */
     std::tuple<int, bool> get_last_value (const std::shared_ptr<Device>& device) const;
+    /**
+     * Get the battery history of a device
+     *
+     * @return nullptr if the device hasn't sent its battery level yet
+     */
+    const BatteryHistory* get_history (const std::shared_ptr<Device>& device) const;
 
     /**
      * @param device The device which sent the battery level update
@@ -69,10 +151,13 @@ class Battery : public AbstractPacketHandler {
     std::string get_packet_type_virt () const noexcept override;
     void        register_device_virt (const std::shared_ptr<Device>& device) noexcept override;
     void        unregister_device_virt (const std::shared_ptr<Device>& device) noexcept override;
+    void        add_initial_requests_virt (const std::shared_ptr<Device>& device,
+                                           std::vector<InitialRequest>&  requests) noexcept override;
 
   private:
     std::map<std::shared_ptr<Device>, sigc::connection> m_devices;
-    std::map<std::string, std::tuple<int, bool>>        m_values;
+    // Kept after a device has been unregistered (devices aren't destroyed by the backend, so the pointers are stable)
+    std::map<std::shared_ptr<Device>, BatteryHistory>   m_histories;
 
     type_signal_battery m_signal_battery;
 };
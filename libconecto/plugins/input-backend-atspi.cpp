@@ -0,0 +1,127 @@
+/* input-backend-atspi.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "input-backend-atspi.h"
+#include <atspi/atspi.h>
+#include <gdkmm/monitor.h>
+
+using namespace Conecto::Plugins;
+
+namespace {
+
+void
+generate_mouse_event (long x, long y, const std::string& name)
+{
+    GError* err = nullptr;
+    atspi_generate_mouse_event (x, y, name.c_str (), &err);
+    if (err) {
+        g_warning ("Failed to generate mouse event %s: %s", name.c_str (), err->message);
+        g_error_free (err);
+    }
+}
+
+void
+generate_keyboard_event (long keyval, const gchar* str, AtspiKeySynthType type)
+{
+    GError* err = nullptr;
+    atspi_generate_keyboard_event (keyval, str, type, &err);
+    if (err) {
+        g_warning ("Failed to generate keyboard event: %s", err->message);
+        g_error_free (err);
+    }
+}
+
+} // namespace
+
+AtspiInputBackend::AtspiInputBackend (const Glib::RefPtr<Gdk::Display>& display)
+    : InputBackend ()
+    , m_display (display)
+    , m_scale_factor (1)
+{
+    // Initialize atspi
+    if (atspi_init () > 0) g_warning ("Couldn't initialize atspi2");
+
+    if (m_display) {
+        update_scale_factor ();
+        m_connections.push_back (m_display->signal_monitor_added ().connect (
+                sigc::hide (sigc::mem_fun (*this, &AtspiInputBackend::update_scale_factor))));
+        m_connections.push_back (m_display->signal_monitor_removed ().connect (
+                sigc::hide (sigc::mem_fun (*this, &AtspiInputBackend::update_scale_factor))));
+    }
+}
+
+AtspiInputBackend::~AtspiInputBackend ()
+{
+    for (auto& conn : m_connections) conn.disconnect ();
+    atspi_exit ();
+}
+
+std::string
+AtspiInputBackend::get_name_virt () const noexcept
+{
+    return "atspi";
+}
+
+bool
+AtspiInputBackend::get_can_send_text_virt () const noexcept
+{
+    return true;
+}
+
+void
+AtspiInputBackend::update_scale_factor ()
+{
+    // TODO: Use scale factor from correct monitor
+    auto monitor = m_display->get_primary_monitor ();
+    if (!monitor && m_display->get_n_monitors () > 0) monitor = m_display->get_monitor (0);
+    m_scale_factor = monitor ? monitor->get_scale_factor () : 1;
+}
+
+void
+AtspiInputBackend::send_virt (const std::vector<InputEvent>& events)
+{
+    for (const auto& event : events) {
+        switch (event.type) {
+        case InputEvent::MOTION:
+            generate_mouse_event (event.dx, event.dy, "rel");
+            break;
+        case InputEvent::CLICK: {
+            if (!m_display) {
+                g_warning ("Display not initialized");
+                break;
+            }
+            // AT-SPI button events need absolute coordinates
+            gint       x, y;
+            GdkSeat*   seat = gdk_display_get_default_seat (m_display->gobj ());
+            GdkDevice* device = gdk_seat_get_pointer (seat);
+            gdk_device_get_position (device, nullptr, &x, &y);
+            generate_mouse_event (x * m_scale_factor, y * m_scale_factor, "b" + std::to_string (event.button) + "c");
+            break;
+        }
+        case InputEvent::KEYSYM:
+            generate_keyboard_event (event.keyval, nullptr,
+                                     static_cast<AtspiKeySynthType> (ATSPI_KEY_PRESSRELEASE | ATSPI_KEY_SYM));
+            break;
+        case InputEvent::TEXT:
+            generate_keyboard_event (0, event.str.c_str (), ATSPI_KEY_STRING);
+            break;
+        }
+    }
+}
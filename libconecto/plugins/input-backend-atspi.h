@@ -0,0 +1,54 @@
+/* input-backend-atspi.h
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "input-backend.h"
+#include <list>
+
+namespace Conecto {
+namespace Plugins {
+
+/**
+ * @brief Input backend using AT-SPI (every event is a D-Bus round trip)
+ *
+ * This works on X11 and some Wayland compositors, but is the slowest backend.
+ */
+class AtspiInputBackend : public InputBackend {
+  public:
+    AtspiInputBackend (const Glib::RefPtr<Gdk::Display>& display);
+    ~AtspiInputBackend ();
+
+  protected:
+    std::string get_name_virt () const noexcept override;
+    bool        get_can_send_text_virt () const noexcept override;
+    void        send_virt (const std::vector<InputEvent>& events) override;
+
+  private:
+    void update_scale_factor ();
+
+    Glib::RefPtr<Gdk::Display>  m_display;
+    std::list<sigc::connection> m_connections;
+    // Cached so that clicks don't have to query the monitor configuration every time
+    int m_scale_factor;
+};
+
+} // namespace Plugins
+} // namespace Conecto
@@ -0,0 +1,62 @@
+/* input-backend-recording.h
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "input-backend.h"
+
+namespace Conecto {
+namespace Plugins {
+
+/**
+ * @brief Input backend which only records events in memory (used for tests and benchmarks)
+ */
+class RecordingInputBackend : public InputBackend {
+  public:
+    RecordingInputBackend () {}
+    ~RecordingInputBackend () {}
+
+    /** @brief All events sent so far */
+    const std::vector<InputEvent>& get_events () const noexcept { return m_events; }
+    /** @brief The number of calls to @p send (i.e. the number of bursts) */
+    size_t get_n_bursts () const noexcept { return m_n_bursts; }
+    /** @brief Forget all recorded events */
+    void clear () noexcept
+    {
+        m_events.clear ();
+        m_n_bursts = 0;
+    }
+
+  protected:
+    std::string get_name_virt () const noexcept override { return "recording"; }
+    bool        get_can_send_text_virt () const noexcept override { return true; }
+    void        send_virt (const std::vector<InputEvent>& events) override
+    {
+        m_events.insert (m_events.end (), events.begin (), events.end ());
+        m_n_bursts++;
+    }
+
+  private:
+    std::vector<InputEvent> m_events;
+    size_t                  m_n_bursts = 0;
+};
+
+} // namespace Plugins
+} // namespace Conecto
@@ -0,0 +1,173 @@
+/* input-backend-uinput.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "input-backend-uinput.h"
+#include <gdk/gdkkeysyms.h>
+#include <linux/uinput.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+using namespace Conecto::Plugins;
+
+namespace {
+
+constexpr char UINPUT_PATH[] = "/dev/uinput";
+constexpr char DEVICE_NAME[] = "Conecto virtual input";
+
+constexpr int BUTTON_CODES[] = { 0, BTN_LEFT, BTN_MIDDLE, BTN_RIGHT };
+constexpr int KEY_CODES[] = { KEY_ENTER, KEY_BACKSPACE };
+
+void
+append_event (std::vector<input_event>& events, uint16_t type, uint16_t code, int32_t value)
+{
+    input_event event;
+    memset (&event, 0, sizeof (event));
+    event.type = type;
+    event.code = code;
+    event.value = value;
+    events.push_back (event);
+}
+
+void
+append_key (std::vector<input_event>& events, int code)
+{
+    append_event (events, EV_KEY, code, 1);
+    append_event (events, EV_SYN, SYN_REPORT, 0);
+    append_event (events, EV_KEY, code, 0);
+    append_event (events, EV_SYN, SYN_REPORT, 0);
+}
+
+int
+keyval_to_code (uint keyval)
+{
+    switch (keyval) {
+    case GDK_KEY_Return:
+        return KEY_ENTER;
+    case GDK_KEY_BackSpace:
+        return KEY_BACKSPACE;
+    default:
+        return 0;
+    }
+}
+
+} // namespace
+
+UInputBackend::UInputBackend (int fd)
+    : InputBackend ()
+    , m_fd (fd)
+{
+}
+
+UInputBackend::~UInputBackend ()
+{
+    ioctl (m_fd, UI_DEV_DESTROY);
+    close (m_fd);
+}
+
+std::unique_ptr<UInputBackend>
+UInputBackend::create ()
+{
+    int fd = open (UINPUT_PATH, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        g_debug ("Can't open %s: %s", UINPUT_PATH, strerror (errno));
+        return std::unique_ptr<UInputBackend> ();
+    }
+
+    bool success = ioctl (fd, UI_SET_EVBIT, EV_KEY) >= 0 && ioctl (fd, UI_SET_EVBIT, EV_REL) >= 0 &&
+                   ioctl (fd, UI_SET_EVBIT, EV_SYN) >= 0 && ioctl (fd, UI_SET_RELBIT, REL_X) >= 0 &&
+                   ioctl (fd, UI_SET_RELBIT, REL_Y) >= 0 && ioctl (fd, UI_SET_RELBIT, REL_WHEEL) >= 0;
+    for (int code : BUTTON_CODES)
+        if (code != 0) success = success && ioctl (fd, UI_SET_KEYBIT, code) >= 0;
+    for (int code : KEY_CODES) success = success && ioctl (fd, UI_SET_KEYBIT, code) >= 0;
+
+    uinput_setup setup;
+    memset (&setup, 0, sizeof (setup));
+    setup.id.bustype = BUS_VIRTUAL;
+    strncpy (setup.name, DEVICE_NAME, UINPUT_MAX_NAME_SIZE - 1);
+    success = success && ioctl (fd, UI_DEV_SETUP, &setup) >= 0 && ioctl (fd, UI_DEV_CREATE) >= 0;
+
+    if (!success) {
+        g_warning ("Failed to set up uinput device: %s", strerror (errno));
+        close (fd);
+        return std::unique_ptr<UInputBackend> ();
+    }
+
+    return std::unique_ptr<UInputBackend> (new UInputBackend (fd));
+}
+
+std::string
+UInputBackend::get_name_virt () const noexcept
+{
+    return "uinput";
+}
+
+bool
+UInputBackend::get_can_send_text_virt () const noexcept
+{
+    // Typing arbitrary text would require knowing the active keyboard layout
+    return false;
+}
+
+void
+UInputBackend::send_virt (const std::vector<InputEvent>& events)
+{
+    std::vector<input_event> raw;
+    raw.reserve (events.size () * 4);
+
+    for (const auto& event : events) {
+        switch (event.type) {
+        case InputEvent::MOTION:
+            if (event.dx != 0) append_event (raw, EV_REL, REL_X, event.dx);
+            if (event.dy != 0) append_event (raw, EV_REL, REL_Y, event.dy);
+            append_event (raw, EV_SYN, SYN_REPORT, 0);
+            break;
+        case InputEvent::CLICK:
+            if (event.button == 4 || event.button == 5) {
+                append_event (raw, EV_REL, REL_WHEEL, event.button == 4 ? 1 : -1);
+                append_event (raw, EV_SYN, SYN_REPORT, 0);
+            } else if (event.button >= 1 && event.button <= 3) {
+                append_key (raw, BUTTON_CODES[event.button]);
+            }
+            break;
+        case InputEvent::KEYSYM: {
+            int code = keyval_to_code (event.keyval);
+            if (code != 0)
+                append_key (raw, code);
+            else
+                g_warning ("Keyval %x can't be sent using uinput", event.keyval);
+            break;
+        }
+        case InputEvent::TEXT:
+            g_warning ("Text input is not supported by the uinput backend");
+            break;
+        }
+    }
+
+    if (raw.empty ()) return;
+
+    // Submit the whole burst at once
+    size_t  size = raw.size () * sizeof (input_event);
+    ssize_t written = write (m_fd, raw.data (), size);
+    if (written < 0 || static_cast<size_t> (written) != size)
+        g_warning ("Failed to write input events: %s", written < 0 ? strerror (errno) : "short write");
+}
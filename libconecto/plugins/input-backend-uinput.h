@@ -0,0 +1,56 @@
+/* input-backend-uinput.h
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "input-backend.h"
+
+namespace Conecto {
+namespace Plugins {
+
+/**
+ * @brief Input backend using a virtual /dev/uinput device
+ *
+ * Works independently of the display server, but requires write access to /dev/uinput. A whole list of events is
+ * submitted to the kernel with a single write.
+ */
+class UInputBackend : public InputBackend {
+  public:
+    /**
+     * Create a virtual input device
+     *
+     * @return The backend, or nullptr if /dev/uinput is not accessible
+     */
+    static std::unique_ptr<UInputBackend> create ();
+    ~UInputBackend ();
+
+  protected:
+    std::string get_name_virt () const noexcept override;
+    bool        get_can_send_text_virt () const noexcept override;
+    void        send_virt (const std::vector<InputEvent>& events) override;
+
+  private:
+    UInputBackend (int fd);
+
+    int m_fd;
+};
+
+} // namespace Plugins
+} // namespace Conecto
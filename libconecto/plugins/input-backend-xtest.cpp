@@ -0,0 +1,97 @@
+/* input-backend-xtest.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "constants.h"
+#ifdef HAVE_XTEST
+#include "input-backend-xtest.h"
+#include <gdk/gdkx.h>
+#include <X11/extensions/XTest.h>
+
+using namespace Conecto::Plugins;
+
+XTestInputBackend::XTestInputBackend (const Glib::RefPtr<Gdk::Display>& display, Display* xdisplay)
+    : InputBackend ()
+    , m_display (display)
+    , m_xdisplay (xdisplay)
+{
+}
+
+std::unique_ptr<XTestInputBackend>
+XTestInputBackend::create (const Glib::RefPtr<Gdk::Display>& display)
+{
+    if (!display || !GDK_IS_X11_DISPLAY (display->gobj ())) return std::unique_ptr<XTestInputBackend> ();
+
+    Display* xdisplay = gdk_x11_display_get_xdisplay (display->gobj ());
+    int      event_base, error_base, major, minor;
+    if (!XTestQueryExtension (xdisplay, &event_base, &error_base, &major, &minor)) {
+        g_debug ("XTest extension not available");
+        return std::unique_ptr<XTestInputBackend> ();
+    }
+
+    return std::unique_ptr<XTestInputBackend> (new XTestInputBackend (display, xdisplay));
+}
+
+std::string
+XTestInputBackend::get_name_virt () const noexcept
+{
+    return "xtest";
+}
+
+bool
+XTestInputBackend::get_can_send_text_virt () const noexcept
+{
+    // Characters not present in the current keymap can't be typed
+    return false;
+}
+
+void
+XTestInputBackend::send_virt (const std::vector<InputEvent>& events)
+{
+    for (const auto& event : events) {
+        switch (event.type) {
+        case InputEvent::MOTION:
+            XTestFakeRelativeMotionEvent (m_xdisplay, event.dx, event.dy, CurrentTime);
+            break;
+        case InputEvent::CLICK:
+            // Buttons are pressed at the current pointer position
+            XTestFakeButtonEvent (m_xdisplay, event.button, True, CurrentTime);
+            XTestFakeButtonEvent (m_xdisplay, event.button, False, CurrentTime);
+            break;
+        case InputEvent::KEYSYM: {
+            KeyCode code = XKeysymToKeycode (m_xdisplay, event.keyval);
+            if (code == 0) {
+                g_warning ("Keyval %x is not part of the keymap", event.keyval);
+                break;
+            }
+            XTestFakeKeyEvent (m_xdisplay, code, True, CurrentTime);
+            XTestFakeKeyEvent (m_xdisplay, code, False, CurrentTime);
+            break;
+        }
+        case InputEvent::TEXT:
+            g_warning ("Text input is not supported by the XTest backend");
+            break;
+        }
+    }
+
+    // Send the whole batch to the server at once
+    XFlush (m_xdisplay);
+}
+
+#endif
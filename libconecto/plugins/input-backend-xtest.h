@@ -0,0 +1,59 @@
+/* input-backend-xtest.h
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "input-backend.h"
+
+// forward declarations
+typedef struct _XDisplay Display;
+
+namespace Conecto {
+namespace Plugins {
+
+/**
+ * @brief Input backend using the XTest extension (X11 sessions only)
+ *
+ * Events are buffered by Xlib and flushed once per call to @p send.
+ */
+class XTestInputBackend : public InputBackend {
+  public:
+    /**
+     * Create a backend for an X11 display
+     *
+     * @return The backend, or nullptr if @p display is not an X11 display or doesn't support XTest
+     */
+    static std::unique_ptr<XTestInputBackend> create (const Glib::RefPtr<Gdk::Display>& display);
+    ~XTestInputBackend () {}
+
+  protected:
+    std::string get_name_virt () const noexcept override;
+    bool        get_can_send_text_virt () const noexcept override;
+    void        send_virt (const std::vector<InputEvent>& events) override;
+
+  private:
+    XTestInputBackend (const Glib::RefPtr<Gdk::Display>& display, Display* xdisplay);
+
+    Glib::RefPtr<Gdk::Display> m_display; // keeps m_xdisplay alive
+    Display*                   m_xdisplay;
+};
+
+} // namespace Plugins
+} // namespace Conecto
@@ -0,0 +1,75 @@
+/* input-backend.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "input-backend.h"
+#include "constants.h"
+#include "input-backend-atspi.h"
+#include "input-backend-uinput.h"
+#ifdef HAVE_XTEST
+#include "input-backend-xtest.h"
+#endif
+#include <glibmm/miscutils.h>
+
+using namespace Conecto::Plugins;
+
+InputEvent
+InputEvent::motion (int dx, int dy)
+{
+    return InputEvent { MOTION, dx, dy, 0, 0, std::string () };
+}
+
+InputEvent
+InputEvent::click (int button)
+{
+    return InputEvent { CLICK, 0, 0, button, 0, std::string () };
+}
+
+InputEvent
+InputEvent::keysym (uint keyval)
+{
+    return InputEvent { KEYSYM, 0, 0, 0, keyval, std::string () };
+}
+
+InputEvent
+InputEvent::text (const std::string& text)
+{
+    return InputEvent { TEXT, 0, 0, 0, 0, text };
+}
+
+std::unique_ptr<InputBackend>
+InputBackend::create_default (const Glib::RefPtr<Gdk::Display>& display)
+{
+    std::string forced = Glib::getenv ("CONECTO_INPUT_BACKEND");
+
+    if (forced == std::string () || forced == "uinput") {
+        auto backend = UInputBackend::create ();
+        if (backend) return backend;
+    }
+#ifdef HAVE_XTEST
+    if (forced == std::string () || forced == "xtest") {
+        auto backend = XTestInputBackend::create (display);
+        if (backend) return backend;
+    }
+#endif
+    if (forced != std::string () && forced != "atspi")
+        g_warning ("Input backend %s is not available, falling back to atspi", forced.c_str ());
+
+    return std::make_unique<AtspiInputBackend> (display);
+}
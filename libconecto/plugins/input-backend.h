@@ -0,0 +1,95 @@
+/* input-backend.h
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <gdkmm/display.h>
+
+namespace Conecto {
+namespace Plugins {
+
+/**
+ * @brief A single synthesized input event
+ */
+struct InputEvent {
+    enum Type { MOTION, CLICK, KEYSYM, TEXT };
+
+    /** @brief Relative pointer motion in pixels */
+    static InputEvent motion (int dx, int dy);
+    /** @brief Press and release a button (1: left, 2: middle, 3: right, 4/5: scroll up/down) */
+    static InputEvent click (int button);
+    /** @brief Press and release a key identified by a GDK keyval */
+    static InputEvent keysym (uint keyval);
+    /** @brief Type a string */
+    static InputEvent text (const std::string& text);
+
+    Type        type;
+    int         dx;
+    int         dy;
+    int         button;
+    uint        keyval;
+    std::string str;
+};
+
+/**
+ * @brief Abstract base class for ways of injecting input events into the desktop session
+ */
+class InputBackend {
+  public:
+    InputBackend () {}
+    virtual ~InputBackend () {}
+
+    /**
+     * Create the best backend available in the current session
+     *
+     * Tries uinput, XTest and AT-SPI, in that order. The CONECTO_INPUT_BACKEND environment variable can be set to
+     * "uinput", "xtest" or "atspi" to force a specific backend.
+     *
+     * @param display The default display
+     */
+    static std::unique_ptr<InputBackend> create_default (const Glib::RefPtr<Gdk::Display>& display);
+
+    /** @brief A short name for logging, e.g. "atspi" */
+    std::string get_name () const noexcept { return get_name_virt (); }
+    /** @brief true if @p InputEvent::TEXT events are supported */
+    bool get_can_send_text () const noexcept { return get_can_send_text_virt (); }
+    /**
+     * Inject a list of events, in order
+     *
+     * Backends may submit the whole list at once, so callers should batch events that belong together.
+     */
+    void send (const std::vector<InputEvent>& events) { send_virt (events); }
+    /** @brief Inject a single event */
+    void send (const InputEvent& event) { send_virt (std::vector<InputEvent> ({ event })); }
+
+    InputBackend (const InputBackend&) = delete;
+    InputBackend& operator= (const InputBackend&) = delete;
+
+  protected:
+    virtual std::string get_name_virt () const noexcept = 0;
+    virtual bool        get_can_send_text_virt () const noexcept = 0;
+    virtual void        send_virt (const std::vector<InputEvent>& events) = 0;
+};
+
+} // namespace Plugins
+} // namespace Conecto
@@ -21,8 +21,10 @@
 #include "mouse.h"
 #include "device.h"
 #include "network-packet.h"
-#include <atspi/atspi.h>
+#include "input-backend-atspi.h"
 #include <gdkmm/monitor.h>
+#include <glibmm/main.h>
+#include <cmath>
 
 using namespace Conecto::Plugins;
 
@@ -30,67 +32,108 @@ namespace {
 
 constexpr char REQUEST[] = "kdeconnect.mousepad.request";
 constexpr char PACKET_TYPE[] = "kdeconnect.mousepad";
+// Used if the refresh rate of the primary monitor is unknown
+constexpr uint DEFAULT_FLUSH_INTERVAL = 16;
+// Scrolling with variable speed: A wheel click is sent while the accumulated scroll delta exceeds SCROLL_THRESHOLD,
+// each click divides it by SCROLL_DIVISOR (so fast swipes aren't scrolled linearly), the remainder carries over
+constexpr double SCROLL_THRESHOLD = 3.0;
+constexpr double SCROLL_DIVISOR = 4.0;
 
-void
-move_cursor_relative (double dx, double dy)
+uint
+special_key_to_keyval (uint key)
 {
-    GError* err = nullptr;
-    atspi_generate_mouse_event (static_cast<long> (dx), static_cast<long> (dy), "rel", &err);
-    if (err) {
-        g_warning ("Failed to generate mouse move event: %s", err->message);
-        g_error_free (err);
-    }
+    if (key == 12)
+        return gdk_keyval_from_name ("Return");
+    else if (key == 1)
+        return gdk_keyval_from_name ("BackSpace");
+    return 0;
 }
 
-void
-send_key (const std::string& key)
+} // namespace
+
+Mouse::Mouse ()
+    : Mouse (std::unique_ptr<InputBackend> ())
 {
-    GError* err = nullptr;
-    atspi_generate_keyboard_event (0, key.c_str (), ATSPI_KEY_STRING, &err);
-    if (err) {
-        g_warning ("Failed to generate keyboard event: %s", err->message);
-        g_error_free (err);
-    }
 }
 
-void
-send_keysym (uint key)
+Mouse::Mouse (std::unique_ptr<InputBackend> backend)
+    : AbstractPacketHandler ()
+    , m_backend (std::move (backend))
+    , m_motion_pacing (true)
+    , m_flush_interval (0)
+    , m_pending_dx (0.0)
+    , m_pending_dy (0.0)
+    , m_pending_scroll (0.0)
+    , m_pending_since (0)
 {
-    uint keyval = 0;
-    if (key == 12)
-        keyval = gdk_keyval_from_name ("Return");
-    else if (key == 1)
-        keyval = gdk_keyval_from_name ("BackSpace");
+    m_display = Gdk::Display::get_default ();
+    if (!m_display) g_warning ("Failed to get default display");
 
-    if (keyval == 0) {
-        g_warning ("could not identify key %u", key);
-        return;
-    }
+    if (!m_backend) m_backend = InputBackend::create_default (m_display);
+    g_info ("Using %s input backend", m_backend->get_name ().c_str ());
+}
+
+Mouse::~Mouse ()
+{
+    m_flush_connection.disconnect ();
+}
+
+InputBackend&
+Mouse::get_keyboard_backend ()
+{
+    if (m_backend->get_can_send_text ()) return *m_backend;
+
+    // Fall back to AT-SPI for typing text
+    if (!m_keyboard_backend) m_keyboard_backend = std::make_unique<AtspiInputBackend> (m_display);
+    return *m_keyboard_backend;
+}
 
-    g_debug ("Keyval %x", keyval);
-    GError* err = nullptr;
-    atspi_generate_keyboard_event (keyval, nullptr,
-                                   static_cast<AtspiKeySynthType> (ATSPI_KEY_PRESSRELEASE | ATSPI_KEY_SYM), &err);
-    if (err) {
-        g_warning ("Failed to generate keyboard event: %s", err->message);
-        g_error_free (err);
+void
+Mouse::LatencyHistogram::add (int64_t latency) noexcept
+{
+    size_t bucket = 0;
+    while (bucket + 1 < BUCKETS && latency >= (int64_t (1) << (bucket + 1))) bucket++;
+    buckets[bucket]++;
+    count++;
+    max = std::max (max, latency);
+}
+
+int64_t
+Mouse::LatencyHistogram::get_percentile (double p) const noexcept
+{
+    if (count == 0) return 0;
+    uint64_t target = static_cast<uint64_t> (std::ceil (p * count));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= target && seen > 0) return std::min (int64_t (1) << (i + 1), max);
     }
+    return max;
 }
 
-} // namespace
+void
+Mouse::set_motion_pacing (bool enabled) noexcept
+{
+    if (!enabled) flush_motion ();
+    m_motion_pacing = enabled;
+}
 
-Mouse::Mouse ()
-    : AbstractPacketHandler ()
+void
+Mouse::set_flush_interval (uint interval) noexcept
 {
-    // Initialize atspi
-    if (atspi_init () > 0) g_warning ("Couldn't initialize atspi2");
-    m_display = Gdk::Display::get_default ();
-    if (!m_display) g_warning ("Failed to get default display");
+    m_flush_interval = interval;
 }
 
-Mouse::~Mouse ()
+uint
+Mouse::get_effective_flush_interval () const
 {
-    atspi_exit ();
+    if (m_flush_interval != 0) return m_flush_interval;
+
+    auto monitor = m_display ? m_display->get_primary_monitor () : Glib::RefPtr<Gdk::Monitor> ();
+    // The refresh rate is in milli-Hertz
+    int refresh_rate = monitor ? monitor->get_refresh_rate () : 0;
+    if (refresh_rate <= 0) return DEFAULT_FLUSH_INTERVAL;
+    return std::max (1u, static_cast<uint> (1000 * 1000 / refresh_rate));
 }
 
 std::string
@@ -113,6 +156,21 @@ Mouse::unregister_device_virt (const std::shared_ptr<Device>& device) noexcept
         m_devices.at (device).disconnect ();
         m_devices.erase (device);
     }
+
+    if (m_devices.empty ()) log_latencies ();
+}
+
+void
+Mouse::log_latencies () const
+{
+    if (m_motion_latency.count > 0)
+        g_info ("Motion injection latency: %" G_GINT64_FORMAT " us (median), %" G_GINT64_FORMAT " us (99th "
+                "percentile), %" G_GINT64_FORMAT " us (max)",
+                m_motion_latency.get_percentile (0.5), m_motion_latency.get_percentile (0.99), m_motion_latency.max);
+    if (m_button_latency.count > 0)
+        g_info ("Button injection latency: %" G_GINT64_FORMAT " us (median), %" G_GINT64_FORMAT " us (99th "
+                "percentile), %" G_GINT64_FORMAT " us (max)",
+                m_button_latency.get_percentile (0.5), m_button_latency.get_percentile (0.99), m_button_latency.max);
 }
 
 void
@@ -122,82 +180,103 @@ Mouse::on_message (const NetworkPacket& message, const std::shared_ptr<Device>&
 
     g_debug ("Mouse packet");
 
-    if (!m_display) {
-        g_warning ("Display not initialized");
-        return;
-    }
+    int64_t received = g_get_monotonic_time ();
+    bool    is_motion = message.get_body ().isMember ("dx") && message.get_body ().isMember ("dy");
+    // Keep ordering: pending motion needs to be injected before any other event
+    if (!is_motion) flush_motion ();
 
     if (message.get_body ().isMember ("singleclick")) {
         // Single click
         g_debug ("Single click");
-        send_click (1);
+        m_backend->send (InputEvent::click (1));
     } else if (message.get_body ().isMember ("doubleclick")) {
-        send_click (1, true);
+        m_backend->send ({ InputEvent::click (1), InputEvent::click (1) });
     } else if (message.get_body ().isMember ("rightclick")) {
-        send_click (3);
+        m_backend->send (InputEvent::click (3));
     } else if (message.get_body ().isMember ("middleclick")) {
-        send_click (2);
+        m_backend->send (InputEvent::click (2));
     } else if (message.get_body ().isMember ("dx") && message.get_body ().isMember ("dy")) {
         // Motion/position or scrolling
         double dx = message.get_body ()["dx"].asDouble ();
         double dy = message.get_body ()["dy"].asDouble ();
+        bool   scroll = message.get_body ().isMember ("scroll") && message.get_body ()["scroll"].asBool ();
 
-        if (message.get_body ().isMember ("scroll") && message.get_body ()["scroll"].asBool ()) {
-            // Scroll with variable speed
-            while (dy > 3.0) {
-                // Scroll down
-                send_click (5);
-                dy /= 4.0;
-                g_debug ("Scroll down");
-            }
-            while (dy < -3.0) {
-                // Scroll up
-                send_click (4);
-                dy /= 4.0;
-                g_debug ("Scroll up");
-            }
-        } else {
-            g_debug ("Position: %f x %f", dx, dy);
-
-            move_cursor_relative (dx, dy);
-        }
+        queue_motion (dx, dy, scroll);
+        if (!m_motion_pacing) flush_motion ();
+        return;
     } else if (message.get_body ().isMember ("key")) {
         std::string key = message.get_body ()["key"].asString ();
         g_debug ("Got key: %s", key.c_str ());
-        send_key (key);
+        get_keyboard_backend ().send (InputEvent::text (key));
     } else if (message.get_body ().isMember ("specialKey")) {
         int keynum = message.get_body ()["specialKey"].asInt ();
         g_debug ("Got special key: %d", keynum);
-        send_keysym (static_cast<uint> (keynum));
+        uint keyval = special_key_to_keyval (static_cast<uint> (keynum));
+        if (keyval == 0)
+            g_warning ("could not identify key %d", keynum);
+        else
+            get_keyboard_backend ().send (InputEvent::keysym (keyval));
+    }
+
+    m_button_latency.add (g_get_monotonic_time () - received);
+}
+
+void
+Mouse::queue_motion (double dx, double dy, bool scroll)
+{
+    if (scroll)
+        m_pending_scroll += dy;
+    else {
+        m_pending_dx += dx;
+        m_pending_dy += dy;
     }
+    if (m_pending_since == 0) m_pending_since = g_get_monotonic_time ();
+
+    if (m_motion_pacing && !m_flush_connection.connected ())
+        m_flush_connection = Glib::signal_timeout ().connect (sigc::mem_fun (*this, &Mouse::on_flush_timeout),
+                                                              get_effective_flush_interval ());
+}
+
+bool
+Mouse::on_flush_timeout ()
+{
+    m_flush_connection = sigc::connection ();
+    flush_motion ();
+
+    // Remove timeout source, the next motion event starts a new one
+    return false;
 }
 
 void
-Mouse::send_click (int button, bool double_click)
-{
-    std::string etype = "b" + std::to_string (button) + "c";
-    gint        x, y;
-    GdkSeat*    seat = gdk_display_get_default_seat (m_display->gobj ());
-    GdkDevice*  device = gdk_seat_get_pointer (seat);
-    gdk_device_get_position (device, nullptr, &x, &y);
-    // TODO: Use scale factor from correct monitor
-    x *= m_display->get_primary_monitor ()->get_scale_factor ();
-    y *= m_display->get_primary_monitor ()->get_scale_factor ();
-
-    GError* err = nullptr;
-    atspi_generate_mouse_event (x, y, etype.c_str (), &err);
-    if (err) {
-        g_warning ("Failed to generate mouse click event: %s", err->message);
-        g_error_free (err);
-        return;
+Mouse::flush_motion ()
+{
+    if (m_pending_since == 0) return;
+
+    // Only whole pixels can be injected, keep the fractional part for the next flush
+    std::vector<InputEvent> events;
+    double                  dx = std::trunc (m_pending_dx);
+    double                  dy = std::trunc (m_pending_dy);
+    if (dx != 0.0 || dy != 0.0) {
+        g_debug ("Position: %f x %f", dx, dy);
+        events.push_back (InputEvent::motion (static_cast<int> (dx), static_cast<int> (dy)));
+        m_pending_dx -= dx;
+        m_pending_dy -= dy;
     }
 
-    if (double_click) {
-        atspi_generate_mouse_event (x, y, etype.c_str (), &err);
-        if (err) {
-            g_warning ("Failed to generate mouse click event: %s", err->message);
-            g_error_free (err);
-            return;
-        }
+    while (m_pending_scroll > SCROLL_THRESHOLD) {
+        g_debug ("Scroll down");
+        events.push_back (InputEvent::click (5));
+        m_pending_scroll /= SCROLL_DIVISOR;
     }
-}
\ No newline at end of file
+    while (m_pending_scroll < -SCROLL_THRESHOLD) {
+        g_debug ("Scroll up");
+        events.push_back (InputEvent::click (4));
+        m_pending_scroll /= SCROLL_DIVISOR;
+    }
+
+    if (!events.empty ()) m_backend->send (events);
+
+    // Remainders smaller than a pixel or the scroll threshold are kept for the next motion event
+    m_motion_latency.add (g_get_monotonic_time () - m_pending_since);
+    m_pending_since = 0;
+}
@@ -21,6 +21,8 @@
 #pragma once
 
 #include "abstract-packet-handler.h"
+#include "input-backend.h"
+#include <array>
 #include <map>
 #include <sigc++/sigc++.h>
 #include <gdkmm/display.h>
@@ -37,11 +39,51 @@ namespace Plugins {
 class Mouse : public AbstractPacketHandler {
   public:
     /**
-     * Create a new instance of this plugin
+     * Create a new instance of this plugin using the best input backend available
      */
     Mouse ();
+    /**
+     * Create a new instance of this plugin using a specific input backend (e.g. for testing)
+     *
+     * @param backend The backend used for injecting events
+     */
+    Mouse (std::unique_ptr<InputBackend> backend);
     ~Mouse ();
 
+    /**
+     * @brief Histogram of injection latencies with power-of-two buckets
+     *
+     * Bucket i counts samples in [2^i, 2^(i+1)) microseconds, the last bucket also counts everything above.
+     */
+    struct LatencyHistogram {
+        static constexpr size_t BUCKETS = 21;
+
+        std::array<uint64_t, BUCKETS> buckets = {};
+        uint64_t                      count = 0;
+        int64_t                       max = 0;
+
+        /** @brief Add a sample (in microseconds) */
+        void add (int64_t latency) noexcept;
+        /** @brief Get an upper bound for the percentile @p p in [0..1] (in microseconds) */
+        int64_t get_percentile (double p) const noexcept;
+    };
+
+    /**
+     * Enable or disable motion pacing. If enabled (the default), relative motion and scroll deltas are accumulated
+     * and injected once per flush interval instead of once per packet.
+     */
+    void set_motion_pacing (bool enabled) noexcept;
+    /**
+     * Set the interval used for flushing accumulated motion
+     *
+     * @param interval The interval in milliseconds, 0 to use the primary monitor's refresh rate
+     */
+    void set_flush_interval (uint interval) noexcept;
+    /** @brief Latencies between receiving motion and injecting it */
+    const LatencyHistogram& get_motion_latency () const noexcept { return m_motion_latency; }
+    /** @brief Latencies between receiving a click or key and injecting it */
+    const LatencyHistogram& get_button_latency () const noexcept { return m_button_latency; }
+
     Mouse (const Mouse&) = delete;
     Mouse& operator= (const Mouse&) = delete;
 
@@ -57,8 +99,32 @@ class Mouse : public AbstractPacketHandler {
   private:
     std::map<std::shared_ptr<Device>, sigc::connection> m_devices;
     Glib::RefPtr<Gdk::Display>                          m_display;
+    std::unique_ptr<InputBackend>                       m_backend;
+    std::unique_ptr<InputBackend>                       m_keyboard_backend; // only if m_backend can't send text
 
-    void send_click (int button, bool doubleclick = false);
+    // Motion pacing
+    bool             m_motion_pacing;
+    uint             m_flush_interval;
+    double           m_pending_dx;
+    double           m_pending_dy;
+    double           m_pending_scroll;
+    int64_t          m_pending_since; // monotonic time of the oldest unflushed delta, 0 if nothing is pending
+    sigc::connection m_flush_connection;
+    LatencyHistogram m_motion_latency;
+    LatencyHistogram m_button_latency;
+
+    /**
+     * @brief The backend used for text and special keys
+     *
+     * Both are sent through the same backend, so they are injected in the order they have been received.
+     */
+    InputBackend& get_keyboard_backend ();
+    void queue_motion (double dx, double dy, bool scroll);
+    void flush_motion ();
+    bool on_flush_timeout ();
+    uint get_effective_flush_interval () const;
+    /** @brief Log a summary of the injection latencies */
+    void log_latencies () const;
 };
 
 } // namespace Plugins
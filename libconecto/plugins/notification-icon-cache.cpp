@@ -0,0 +1,295 @@
+/* notification-icon-cache.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "notification-icon-cache.h"
+#include "backend.h"
+#include "device.h"
+#include <algorithm>
+#include <glibmm/bytes.h>
+#include <glibmm/checksum.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+#include <giomm/inetsocketaddress.h>
+#include <giomm/socketclient.h>
+#include <giomm/tlsconnection.h>
+
+using namespace Conecto::Plugins;
+
+namespace {
+
+// Larger payloads are not downloaded (icons are usually a few kilobytes)
+constexpr uint64_t MAX_ICON_SIZE = 1024 * 1024;
+constexpr gsize    READ_CHUNK_SIZE = 64 * 1024;
+// Time until a download without any progress is cancelled (in seconds)
+constexpr guint DOWNLOAD_TIMEOUT = 10;
+
+/**
+ * Hashes are used as file names, so hashes announced by a device must not contain anything else
+ */
+bool
+is_valid_hash (const std::string& hash)
+{
+    return hash.size () == 32 && std::all_of (hash.begin (), hash.end (), [] (char c) {
+               return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+           });
+}
+
+} // namespace
+
+/**
+ * @brief Transfer of a payload from a device
+ *
+ * The device listens on the payload's port, we connect to it and act as the TLS client. The download keeps itself
+ * alive until it has finished.
+ */
+class NotificationIconCache::Download : public std::enable_shared_from_this<Download> {
+  public:
+    using Callback = std::function<void (const std::string& /* data */, bool /* success */)>;
+
+    Download (const std::shared_ptr<Device>& device, const NetworkPacket::Payload& payload)
+        : m_address (Gio::InetSocketAddress::create (device->get_host (), payload.port))
+        , m_size (payload.size)
+        , m_expected_peer (device->get_certificate ())
+    {
+    }
+
+    void
+    start (const Callback& cb)
+    {
+        m_callback = cb;
+        m_data.reserve (m_size);
+
+        auto self = shared_from_this ();
+        auto client = Gio::SocketClient::create ();
+        client->set_timeout (DOWNLOAD_TIMEOUT);
+        client->connect_async (m_address, [self, client] (Glib::RefPtr<Gio::AsyncResult>& res) {
+            try {
+                self->m_socket_conn = client->connect_finish (res);
+            } catch (Glib::Error& err) {
+                g_warning ("Failed to connect for downloading an icon: %s", err.what ().c_str ());
+                self->finish (false);
+                return;
+            }
+            self->secure ();
+        });
+    }
+
+  private:
+    void
+    secure ()
+    {
+        GError* err = nullptr;
+        auto    stream = g_tls_client_connection_new (G_IO_STREAM (m_socket_conn->gobj ()), nullptr, &err);
+        if (!stream) {
+            g_warning ("Failed to create TLS connection: %s", err->message);
+            g_error_free (err);
+            finish (false);
+            return;
+        }
+        m_tls_conn = Glib::wrap (G_TLS_CONNECTION (stream));
+        m_tls_conn->set_certificate (Backend::get_instance ().get_certificate ());
+
+        // Only the device which has sent the notification is accepted
+        auto expected_peer = m_expected_peer;
+        m_tls_conn->signal_accept_certificate ().connect (
+                [expected_peer] (const Glib::RefPtr<const Gio::TlsCertificate>& peer_cert,
+                                 Gio::TlsCertificateFlags                       errors) {
+                    return expected_peer && expected_peer->is_same (peer_cert);
+                });
+
+        auto self = shared_from_this ();
+        m_tls_conn->handshake_async ([self] (Glib::RefPtr<Gio::AsyncResult>& res) {
+            try {
+                if (!self->m_tls_conn->handshake_finish (res)) {
+                    self->finish (false);
+                    return;
+                }
+            } catch (Glib::Error& err) {
+                g_warning ("TLS handshake for downloading an icon failed: %s", err.what ().c_str ());
+                self->finish (false);
+                return;
+            }
+            self->read ();
+        });
+    }
+
+    void
+    read ()
+    {
+        auto self = shared_from_this ();
+        auto input = m_tls_conn->get_input_stream ();
+        input->read_bytes_async (std::min (static_cast<gsize> (m_size - m_data.size ()), READ_CHUNK_SIZE),
+                                 [self, input] (Glib::RefPtr<Gio::AsyncResult>& res) {
+                                     Glib::RefPtr<Glib::Bytes> bytes;
+                                     try {
+                                         bytes = input->read_bytes_finish (res);
+                                     } catch (Glib::Error& err) {
+                                         g_warning ("Failed to download an icon: %s", err.what ().c_str ());
+                                         self->finish (false);
+                                         return;
+                                     }
+
+                                     gsize size = 0;
+                                     auto  data = static_cast<const char*> (bytes->get_data (size));
+                                     if (size == 0) {
+                                         g_warning ("Connection closed while downloading an icon");
+                                         self->finish (false);
+                                         return;
+                                     }
+                                     self->m_data.append (data, size);
+
+                                     if (self->m_data.size () < self->m_size)
+                                         self->read ();
+                                     else
+                                         self->finish (true);
+                                 });
+    }
+
+    void
+    finish (bool success)
+    {
+        if (m_tls_conn) m_tls_conn->close_async ([] (Glib::RefPtr<Gio::AsyncResult>&) {});
+
+        Callback cb;
+        std::swap (cb, m_callback);
+        if (cb) cb (m_data, success);
+    }
+
+    Glib::RefPtr<Gio::InetSocketAddress> m_address;
+    uint64_t                             m_size;
+    Glib::RefPtr<Gio::TlsCertificate>    m_expected_peer;
+    Glib::RefPtr<Gio::SocketConnection>  m_socket_conn;
+    Glib::RefPtr<Gio::TlsConnection>     m_tls_conn;
+    std::string                          m_data;
+    Callback                             m_callback;
+};
+
+NotificationIconCache::NotificationIconCache (const std::string& directory, size_t memory_capacity)
+    : m_directory (directory)
+    , m_memory_capacity (memory_capacity)
+    , m_alive (std::make_shared<bool> (true))
+{
+    g_mkdir_with_parents (m_directory.c_str (), 0700);
+    try {
+        Glib::Dir dir (m_directory);
+        for (const auto& name : dir) {
+            if (is_valid_hash (name)) m_stored.insert (name);
+        }
+    } catch (Glib::FileError& err) {
+        g_warning ("Failed to read the icon cache: %s", err.what ().c_str ());
+    }
+}
+
+std::string
+NotificationIconCache::get_path (const std::string& hash) const
+{
+    return Glib::build_filename (m_directory, hash);
+}
+
+bool
+NotificationIconCache::contains (const std::string& hash) const
+{
+    return m_stored.find (hash) != m_stored.end ();
+}
+
+std::string
+NotificationIconCache::add (const std::string& data)
+{
+    std::string hash = Glib::Checksum::compute_checksum (Glib::Checksum::CHECKSUM_MD5, data);
+    if (contains (hash)) return hash;
+
+    try {
+        Glib::file_set_contents (get_path (hash), data);
+    } catch (Glib::FileError& err) {
+        g_warning ("Failed to store an icon: %s", err.what ().c_str ());
+        return std::string ();
+    }
+    m_stored.insert (hash);
+    return hash;
+}
+
+Glib::RefPtr<Gdk::Pixbuf>
+NotificationIconCache::get_pixbuf (const std::string& hash)
+{
+    auto cached = m_pixbuf_index.find (hash);
+    if (cached != m_pixbuf_index.end ()) {
+        m_pixbufs.splice (m_pixbufs.begin (), m_pixbufs, cached->second);
+        return cached->second->second;
+    }
+    if (!contains (hash)) return Glib::RefPtr<Gdk::Pixbuf> ();
+
+    // Icons which can't be decoded are remembered as well, so they aren't decoded again
+    Glib::RefPtr<Gdk::Pixbuf> pixbuf;
+    try {
+        pixbuf = Gdk::Pixbuf::create_from_file (get_path (hash));
+    } catch (Glib::Error& err) {
+        g_warning ("Failed to decode icon %s: %s", hash.c_str (), err.what ().c_str ());
+    }
+
+    m_pixbufs.push_front ({ hash, pixbuf });
+    m_pixbuf_index[hash] = m_pixbufs.begin ();
+    if (m_pixbufs.size () > m_memory_capacity) {
+        m_pixbuf_index.erase (m_pixbufs.back ().first);
+        m_pixbufs.pop_back ();
+    }
+    return pixbuf;
+}
+
+void
+NotificationIconCache::fetch (const std::shared_ptr<Device>& device, const std::string& hash,
+                              const std::shared_ptr<const NetworkPacket::Payload>& payload, const FetchCallback& done)
+{
+    std::string announced = is_valid_hash (hash) ? hash : std::string ();
+    if (!announced.empty ()) {
+        if (contains (announced)) {
+            done (announced);
+            return;
+        }
+        auto pending = m_pending.find (announced);
+        if (pending != m_pending.end ()) {
+            pending->second.push_back (done);
+            return;
+        }
+    }
+
+    if (!payload || payload->size > MAX_ICON_SIZE) {
+        done (std::string ());
+        return;
+    }
+
+    if (!announced.empty ()) m_pending[announced].push_back (done);
+    std::weak_ptr<bool> alive = m_alive;
+    std::make_shared<Download> (device, *payload)
+            ->start ([this, alive, announced, done] (const std::string& data, bool success) {
+                if (alive.expired ()) return;
+
+                std::string hash = success ? add (data) : std::string ();
+                if (!hash.empty () && !announced.empty () && hash != announced)
+                    g_debug ("Icon hash mismatch, expected %s, got %s", announced.c_str (), hash.c_str ());
+
+                if (announced.empty ()) {
+                    done (hash);
+                    return;
+                }
+                auto callbacks = std::move (m_pending[announced]);
+                m_pending.erase (announced);
+                for (const auto& callback : callbacks) callback (hash);
+            });
+}
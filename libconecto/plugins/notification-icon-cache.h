@@ -0,0 +1,111 @@
+/* notification-icon-cache.h
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "network-packet.h"
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <gdkmm/pixbuf.h>
+
+namespace Conecto {
+
+class Device;
+
+namespace Plugins {
+
+/**
+ * @brief Icons of notifications, addressed by the MD5 hash of their contents
+ *
+ * Icons are stored as files named after their hash, so an icon shared by many notifications (usually the app's icon)
+ * is only stored once. Devices send the hash along with the payload, which allows skipping the transfer of icons
+ * which are already stored or are currently being downloaded.
+ *
+ * Decoded icons are kept in memory, the least recently used ones are dropped once @p memory_capacity icons are
+ * decoded.
+ */
+class NotificationIconCache {
+  public:
+    /**
+     * Create a cache storing its files in @p directory (created if it doesn't exist yet)
+     */
+    NotificationIconCache (const std::string& directory, size_t memory_capacity);
+    ~NotificationIconCache () {}
+
+    /**
+     * @param hash The icon's hash, empty if the download has failed
+     */
+    using FetchCallback = std::function<void (const std::string& /* hash */)>;
+
+    /**
+     * Download an icon from @p device, @p done is called once it has been stored
+     *
+     * If @p hash (the hash announced by the device, may be empty) is already stored, @p done is called immediately.
+     * If it is being downloaded already, @p done is called with the running download instead of starting another
+     * one.
+     */
+    void fetch (const std::shared_ptr<Device>& device, const std::string& hash,
+                const std::shared_ptr<const NetworkPacket::Payload>& payload, const FetchCallback& done);
+    /**
+     * Store an icon (nothing is written if the same contents have been stored before)
+     *
+     * @return The icon's hash, empty if it couldn't be written
+     */
+    std::string add (const std::string& data);
+    /** @brief Check if an icon is stored */
+    bool contains (const std::string& hash) const;
+    /**
+     * Get a decoded icon, decoding it if it isn't in memory
+     *
+     * @return An empty pointer if the icon isn't stored or couldn't be decoded
+     */
+    Glib::RefPtr<Gdk::Pixbuf> get_pixbuf (const std::string& hash);
+
+    NotificationIconCache (const NotificationIconCache&) = delete;
+    NotificationIconCache& operator= (const NotificationIconCache&) = delete;
+
+  private:
+    class Download;
+
+    std::string get_path (const std::string& hash) const;
+
+    std::string m_directory;
+    size_t      m_memory_capacity;
+    // Hashes of all stored icons
+    std::unordered_set<std::string> m_stored;
+
+    // Decoded icons, most recently used first
+    using PixbufList = std::list<std::pair<std::string /* hash */, Glib::RefPtr<Gdk::Pixbuf>>>;
+    PixbufList                                            m_pixbufs;
+    std::unordered_map<std::string, PixbufList::iterator> m_pixbuf_index;
+
+    // Running downloads with an announced hash and the callbacks waiting for them
+    std::map<std::string /* hash */, std::vector<FetchCallback>> m_pending;
+    std::shared_ptr<bool>                                        m_alive;
+};
+
+} // namespace Plugins
+} // namespace Conecto
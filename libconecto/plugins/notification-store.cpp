@@ -0,0 +1,181 @@
+/* notification-store.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "notification-store.h"
+
+using namespace Conecto::Plugins;
+
+namespace {
+
+bool
+is_same (const NotificationInfo& a, const NotificationInfo& b)
+{
+    return a.app_name == b.app_name && a.title == b.title && a.body == b.body && a.time.compare (b.time) == 0 &&
+           a.icon == b.icon;
+}
+
+} // namespace
+
+NotificationStore::NotificationStore (size_t capacity)
+    : m_capacity (capacity)
+{
+}
+
+NotificationStore::InsertResult
+NotificationStore::insert (const std::string& device_id, const NotificationInfo& notification)
+{
+    DeviceEntries& device = m_devices[device_id];
+
+    auto existing = device.index.find (notification.id);
+    if (existing != device.index.end ()) {
+        auto it = existing->second;
+        // Resent notifications count as received again
+        device.entries.splice (device.entries.begin (), device.entries, it);
+        if (is_same (it->notification, notification)) return InsertResult::UNCHANGED;
+
+        it->notification = notification;
+        device.signal_updated.emit (notification.id);
+        return InsertResult::UPDATED;
+    }
+
+    if (m_capacity > 0 && device.entries.size () >= m_capacity) {
+        std::string evicted = device.entries.back ().notification.id;
+        erase_entry (device, std::prev (device.entries.end ()));
+        device.signal_removed.emit (evicted);
+    }
+
+    device.entries.push_front ({ notification, nullptr });
+    device.index.insert ({ notification.id, device.entries.begin () });
+    device.signal_added.emit (notification.id);
+    return InsertResult::ADDED;
+}
+
+bool
+NotificationStore::remove (const std::string& device_id, const std::string& id)
+{
+    auto device = m_devices.find (device_id);
+    if (device == m_devices.end ()) return false;
+    auto it = device->second.index.find (id);
+    if (it == device->second.index.end ()) return false;
+
+    erase_entry (device->second, it->second);
+    device->second.signal_removed.emit (id);
+    return true;
+}
+
+bool
+NotificationStore::set_icon (const std::string& device_id, const std::string& id, const std::string& icon)
+{
+    Entry* entry = find_entry (device_id, id);
+    if (!entry || entry->notification.icon == icon) return false;
+
+    entry->notification.icon = icon;
+    m_devices[device_id].signal_updated.emit (id);
+    return true;
+}
+
+void
+NotificationStore::erase_entry (DeviceEntries& device, std::list<Entry>::iterator it)
+{
+    if (it->popup) m_popups.erase (it->popup.get ());
+    device.index.erase (it->notification.id);
+    device.entries.erase (it);
+}
+
+NotificationStore::Entry*
+NotificationStore::find_entry (const std::string& device_id, const std::string& id)
+{
+    auto device = m_devices.find (device_id);
+    if (device == m_devices.end ()) return nullptr;
+    auto it = device->second.index.find (id);
+    return it == device->second.index.end () ? nullptr : &*it->second;
+}
+
+const NotificationStore::Entry*
+NotificationStore::find_entry (const std::string& device_id, const std::string& id) const
+{
+    return const_cast<NotificationStore*> (this)->find_entry (device_id, id);
+}
+
+const NotificationInfo*
+NotificationStore::find (const std::string& device_id, const std::string& id) const
+{
+    const Entry* entry = find_entry (device_id, id);
+    return entry ? &entry->notification : nullptr;
+}
+
+std::vector<const NotificationInfo*>
+NotificationStore::get_notifications (const std::string& device_id) const
+{
+    std::vector<const NotificationInfo*> res;
+    auto                                 device = m_devices.find (device_id);
+    if (device == m_devices.end ()) return res;
+
+    res.reserve (device->second.entries.size ());
+    for (auto it = device->second.entries.rbegin (); it != device->second.entries.rend (); ++it)
+        res.push_back (&it->notification);
+    return res;
+}
+
+size_t
+NotificationStore::get_count (const std::string& device_id) const
+{
+    auto device = m_devices.find (device_id);
+    return device == m_devices.end () ? 0 : device->second.entries.size ();
+}
+
+void
+NotificationStore::set_popup (const std::string& device_id, const std::string& id,
+                              const std::shared_ptr<NotifyNotification>& popup)
+{
+    Entry* entry = find_entry (device_id, id);
+    if (!entry) return;
+
+    if (entry->popup) m_popups.erase (entry->popup.get ());
+    entry->popup = popup;
+    if (popup) m_popups[popup.get ()] = { device_id, id };
+}
+
+std::shared_ptr<NotifyNotification>
+NotificationStore::get_popup (const std::string& device_id, const std::string& id) const
+{
+    const Entry* entry = find_entry (device_id, id);
+    return entry ? entry->popup : nullptr;
+}
+
+bool
+NotificationStore::find_popup (NotifyNotification* popup, std::string& device_id, std::string& id) const
+{
+    auto it = m_popups.find (popup);
+    if (it == m_popups.end ()) return false;
+
+    device_id = it->second.first;
+    id = it->second.second;
+    return true;
+}
+
+std::vector<NotifyNotification*>
+NotificationStore::get_popups () const
+{
+    std::vector<NotifyNotification*> res;
+    res.reserve (m_popups.size ());
+    for (const auto& item : m_popups) res.push_back (item.first);
+    return res;
+}
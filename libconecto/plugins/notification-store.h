@@ -0,0 +1,179 @@
+/* notification-store.h
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sigc++/sigc++.h>
+#include <glibmm/datetime.h>
+#include <libnotify/notification.h>
+
+namespace Conecto {
+namespace Plugins {
+
+/**
+ * @brief A notification sent by a device
+ */
+struct NotificationInfo {
+    std::string    id;
+    std::string    app_name;
+    std::string    title;
+    std::string    body;
+    Glib::DateTime time;
+    /** @brief true if the phone has resent a notification it has already shown (e.g. after reconnecting) */
+    bool           silent;
+    /** @brief Hash of the icon in the @p NotificationIconCache, empty if there is none (yet) */
+    std::string    icon;
+};
+
+/**
+ * @brief The notifications of all devices, indexed by device and notification id
+ *
+ * Notifications resent by a device (e.g. when it reconnects) replace the stored notification instead of being added
+ * again. Every device keeps at most @p capacity notifications, the one which has been received least recently is
+ * evicted once a device is full.
+ *
+ * The desktop popup showing a notification is stored with it and can be looked up by its handle.
+ *
+ * Changes are reported through per-device signals, so a subscriber isn't invoked for notifications of other devices.
+ */
+class NotificationStore {
+  public:
+    /**
+     * Create an empty store keeping up to @p capacity notifications per device
+     */
+    explicit NotificationStore (size_t capacity);
+    ~NotificationStore () {}
+
+    enum class InsertResult {
+        /** @brief The notification is new */
+        ADDED,
+        /** @brief The notification has been stored before and its contents have changed */
+        UPDATED,
+        /** @brief The same notification has been stored before */
+        UNCHANGED
+    };
+
+    /**
+     * Add or replace a notification of @p device_id
+     */
+    InsertResult insert (const std::string& device_id, const NotificationInfo& notification);
+    /**
+     * Remove a notification
+     *
+     * @return false if the notification doesn't exist
+     */
+    bool remove (const std::string& device_id, const std::string& id);
+    /**
+     * Set the icon of a notification once it has been downloaded
+     *
+     * @return false if the notification doesn't exist or already has this icon
+     */
+    bool set_icon (const std::string& device_id, const std::string& id, const std::string& icon);
+
+    /**
+     * Get a notification
+     *
+     * @return nullptr if the notification doesn't exist, the pointer is only valid until the store is modified
+     */
+    const NotificationInfo* find (const std::string& device_id, const std::string& id) const;
+    /**
+     * Get the notifications of a device, least recently received first
+     */
+    std::vector<const NotificationInfo*> get_notifications (const std::string& device_id) const;
+    /** @brief Get the number of stored notifications of a device */
+    size_t get_count (const std::string& device_id) const;
+
+    /**
+     * Set the popup showing a notification (nullptr once it has been closed)
+     */
+    void set_popup (const std::string& device_id, const std::string& id,
+                    const std::shared_ptr<NotifyNotification>& popup);
+    /** @brief Get the popup showing a notification (nullptr if it isn't shown) */
+    std::shared_ptr<NotifyNotification> get_popup (const std::string& device_id, const std::string& id) const;
+    /**
+     * Find the notification shown by @p popup
+     *
+     * @return false if @p popup doesn't belong to a stored notification
+     */
+    bool find_popup (NotifyNotification* popup, std::string& device_id, std::string& id) const;
+    /** @brief Get all popups which are currently set */
+    std::vector<NotifyNotification*> get_popups () const;
+
+    /**
+     * @param id The notification's id
+     */
+    using type_signal_notification = sigc::signal<void, const std::string& /* id */>;
+    /**
+     * Emitted after a notification of @p device_id has been added
+     */
+    type_signal_notification signal_added (const std::string& device_id) { return m_devices[device_id].signal_added; }
+    /**
+     * Emitted after the contents of a notification of @p device_id have changed
+     */
+    type_signal_notification signal_updated (const std::string& device_id)
+    {
+        return m_devices[device_id].signal_updated;
+    }
+    /**
+     * Emitted after a notification of @p device_id has been removed or evicted
+     */
+    type_signal_notification signal_removed (const std::string& device_id)
+    {
+        return m_devices[device_id].signal_removed;
+    }
+
+    NotificationStore (const NotificationStore&) = delete;
+    NotificationStore& operator= (const NotificationStore&) = delete;
+
+  private:
+    struct Entry {
+        NotificationInfo                    notification;
+        std::shared_ptr<NotifyNotification> popup;
+    };
+
+    struct DeviceEntries {
+        // Most recently received first
+        std::list<Entry>                                                     entries;
+        std::unordered_map<std::string /* id */, std::list<Entry>::iterator> index;
+
+        // Only subscribers of the device are invoked
+        type_signal_notification signal_added;
+        type_signal_notification signal_updated;
+        type_signal_notification signal_removed;
+    };
+
+    Entry*       find_entry (const std::string& device_id, const std::string& id);
+    const Entry* find_entry (const std::string& device_id, const std::string& id) const;
+    void         erase_entry (DeviceEntries& device, std::list<Entry>::iterator it);
+
+    size_t                                               m_capacity;
+    std::map<std::string /* device id */, DeviceEntries> m_devices;
+    // Maps a popup to the notification it shows
+    std::unordered_map<NotifyNotification*, std::pair<std::string /* device id */, std::string /* id */>> m_popups;
+};
+
+} // namespace Plugins
+} // namespace Conecto
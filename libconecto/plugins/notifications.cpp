@@ -21,22 +21,89 @@
 #include "notifications.h"
 #include "device.h"
 #include "network-packet.h"
+#include "backend.h"
+#include <glibmm/main.h>
+#include <glibmm/miscutils.h>
 
 using namespace Conecto::Plugins;
 
 namespace {
 
 constexpr char PACKET_TYPE[] = "kdeconnect.notification";
+constexpr char PACKET_TYPE_REQUEST[] = "kdeconnect.notification.request";
+
+// A device can show 5 popups in a row, then one every 2 seconds
+constexpr NotificationRateLimiter::Limits DEVICE_LIMITS = { 5, 2000000 };
+// An app can show 3 popups in a row, then one every 5 seconds
+constexpr NotificationRateLimiter::Limits APP_LIMITS = { 3, 5000000 };
+// Notifications kept per device, older ones are evicted
+constexpr size_t STORE_CAPACITY = 200;
+// Decoded icons kept in memory
+constexpr size_t ICON_MEMORY_CAPACITY = 32;
+// Minimum time between two updates of a summary popup (in milliseconds)
+constexpr unsigned int SUMMARY_UPDATE_INTERVAL = 1000;
+// Notifications are archived once this many have been received or the interval (in milliseconds) has passed
+constexpr size_t       ARCHIVE_BATCH_SIZE = 100;
+constexpr unsigned int ARCHIVE_FLUSH_INTERVAL = 2000;
 
 } // namespace
 
+NotificationRateLimiter::NotificationRateLimiter (const Limits& device_limits, const Limits& app_limits)
+    : m_device_limits (device_limits)
+    , m_app_limits (app_limits)
+{
+}
+
+void
+NotificationRateLimiter::refill (Bucket& bucket, const Limits& limits, int64_t now) noexcept
+{
+    if (now > bucket.updated) {
+        bucket.tokens = std::min (static_cast<double> (limits.burst),
+                                  bucket.tokens + static_cast<double> (now - bucket.updated) / limits.refill_interval);
+    }
+    bucket.updated = now;
+}
+
+bool
+NotificationRateLimiter::submit (const std::string& device_id, const std::string& app_name, int64_t now)
+{
+    // New buckets are full
+    auto& device_bucket =
+            m_device_buckets.insert ({ device_id, { static_cast<double> (m_device_limits.burst), now } }).first->second;
+    auto& app_bucket =
+            m_app_buckets.insert ({ { device_id, app_name }, { static_cast<double> (m_app_limits.burst), now } })
+                    .first->second;
+    refill (device_bucket, m_device_limits, now);
+    refill (app_bucket, m_app_limits, now);
+
+    // Merged notifications don't take a token, so the popups resume as soon as one of them has been refilled
+    if (device_bucket.tokens < 1 || app_bucket.tokens < 1) return false;
+    device_bucket.tokens -= 1;
+    app_bucket.tokens -= 1;
+    return true;
+}
+
 Notifications::Notifications ()
     : AbstractPacketHandler ()
+    , m_store (STORE_CAPACITY)
+    , m_icon_cache (Glib::build_filename (Backend::get_cache_dir (), "notification-icons"), ICON_MEMORY_CAPACITY)
+    , m_rate_limiter (DEVICE_LIMITS, APP_LIMITS)
+    , m_archive_pending_count (0)
 {
     m_signal_new_notification.connect (sigc::mem_fun (*this, &Notifications::on_new_notification));
     m_signal_notification_dismissed.connect (sigc::mem_fun (*this, &Notifications::on_notification_dismissed));
 }
 
+Notifications::~Notifications ()
+{
+    m_flush_connection.disconnect ();
+    flush_archive ();
+    // Popups might outlive the plugin
+    for (NotifyNotification* popup : m_store.get_popups ()) g_signal_handlers_disconnect_by_data (popup, this);
+    for (const auto& item : m_summaries)
+        g_signal_handlers_disconnect_by_data (item.second.notification.get (), this);
+}
+
 std::string
 Notifications::get_packet_type_virt () const noexcept
 {
@@ -59,6 +126,16 @@ Notifications::unregister_device_virt (const std::shared_ptr<Device>& device) no
     }
 }
 
+void
+Notifications::add_initial_requests_virt (const std::shared_ptr<Device>& device,
+                                          std::vector<InitialRequest>&  requests) noexcept
+{
+    // The device sends all of its notifications (or nothing if there aren't any)
+    Json::Value body (Json::objectValue);
+    body["request"] = true;
+    requests.push_back ({ std::make_unique<NetworkPacket> (PACKET_TYPE_REQUEST, body), std::string () });
+}
+
 void
 Notifications::on_message (const NetworkPacket& message, const std::shared_ptr<Device>& device)
 {
@@ -85,53 +162,212 @@ Notifications::on_message (const NetworkPacket& message, const std::shared_ptr<D
 
     std::string body = json["text"].isString () ? json["text"].asString () : std::string ();
 
-    NotificationInfo notification = { .id = id,
+    NotificationInfo notification = { .id = std::move (id),
                                       .app_name = json["appName"].asString (),
                                       .title = json["ticker"].asString (),
-                                      .body = json["text"].asString (),
-                                      .time = time };
+                                      .body = std::move (body),
+                                      .time = time,
+                                      .silent = json["silent"].isBool () && json["silent"].asBool () };
+
+    // Most notifications share a few icons, their hash is sent along so they are only transferred once
+    std::string icon_hash = json["payloadHash"].isString () ? json["payloadHash"].asString () : std::string ();
+    if (m_icon_cache.contains (icon_hash)) notification.icon = icon_hash;
 
+    // Devices resend all notifications when reconnecting
+    auto result = m_store.insert (device->get_device_id (), notification);
+    if (notification.icon.empty () && message.get_payload ())
+        fetch_icon (device, notification.id, icon_hash, message.get_payload ());
+    if (result == NotificationStore::InsertResult::UNCHANGED) return;
+    archive_notification (device->get_device_id (), notification);
     m_signal_new_notification.emit (device, notification);
 }
 
+void
+Notifications::set_archive (const std::weak_ptr<NotificationArchive>& archive)
+{
+    flush_archive ();
+    m_archive = archive;
+}
+
+void
+Notifications::archive_notification (const std::string& device_id, const NotificationInfo& notification)
+{
+    if (m_archive.expired ()) return;
+
+    m_archive_pending[device_id].push_back (notification);
+    if (++m_archive_pending_count >= ARCHIVE_BATCH_SIZE) {
+        flush_archive ();
+    } else if (!m_archive_flush_connection.connected ()) {
+        m_archive_flush_connection = Glib::signal_timeout ().connect (
+                [this] () {
+                    flush_archive ();
+                    return false;
+                },
+                ARCHIVE_FLUSH_INTERVAL);
+    }
+}
+
+void
+Notifications::flush_archive ()
+{
+    m_archive_flush_connection.disconnect ();
+    auto archive = m_archive.lock ();
+    if (archive) {
+        for (auto& item : m_archive_pending) archive->store_notifications (item.first, std::move (item.second));
+    }
+    m_archive_pending.clear ();
+    m_archive_pending_count = 0;
+}
+
+void
+Notifications::fetch_icon (const std::shared_ptr<Device>& device, const std::string& id, const std::string& hash,
+                           const std::shared_ptr<const NetworkPacket::Payload>& payload)
+{
+    std::string device_id = device->get_device_id ();
+    m_icon_cache.fetch (device, hash, payload, [this, device_id, id] (const std::string& icon) {
+        // The notification might have been dismissed in the meantime
+        if (icon.empty () || !m_store.set_icon (device_id, id, icon)) return;
+
+        auto popup = m_store.get_popup (device_id, id);
+        if (popup) {
+            set_popup_icon (popup.get (), icon);
+            // Showing the popup again updates it in place
+            notify_notification_show (popup.get (), nullptr);
+        }
+    });
+}
+
+void
+Notifications::set_popup_icon (NotifyNotification* popup, const std::string& hash)
+{
+    auto pixbuf = m_icon_cache.get_pixbuf (hash);
+    if (pixbuf) notify_notification_set_image_from_pixbuf (popup, pixbuf->gobj ());
+}
+
 void
 Notifications::on_new_notification (const std::shared_ptr<Device>& device, const NotificationInfo& notification)
 {
-    if (m_desktop_notifications.find (notification.id) != m_desktop_notifications.end ()) return;
+    // Changed notifications which are still shown are not shown again
+    if (m_store.get_popup (device->get_device_id (), notification.id)) return;
+
+    if (notification.silent) {
+        // Resent while reconnecting, the user has already seen it
+        m_statistics.suppressed++;
+        return;
+    }
+    if (!m_rate_limiter.submit (device->get_device_id (), notification.app_name, g_get_monotonic_time ())) {
+        merge_notification (device, notification);
+        return;
+    }
 
     std::shared_ptr<NotifyNotification> desktop_notification (notify_notification_new (notification.app_name.c_str (),
                                                                                        notification.title.c_str (),
                                                                                        "phone"),
                                                               g_object_unref);
 
+    if (!notification.icon.empty ()) set_popup_icon (desktop_notification.get (), notification.icon);
+
     g_signal_connect (desktop_notification.get (), "closed", G_CALLBACK (on_notification_closed), this);
     GError* err = nullptr;
     notify_notification_show (desktop_notification.get (), &err);
-    if (err)
+    if (err) {
+        g_warning ("Unable to show notification: %s", err->message);
         g_error_free (err);
-    else
-        m_desktop_notifications.insert ({ notification.id, desktop_notification });
+    } else {
+        m_store.set_popup (device->get_device_id (), notification.id, desktop_notification);
+        m_statistics.shown++;
+    }
 }
 
 void
-Notifications::on_notification_dismissed (const std::shared_ptr<Device>& device, const std::string& id)
+Notifications::merge_notification (const std::shared_ptr<Device>& device, const NotificationInfo& notification)
 {
-    if (m_desktop_notifications.find (id) == m_desktop_notifications.end ()) return;
+    SummaryKey key (device->get_device_id (), notification.app_name);
+    auto       it = m_summaries.find (key);
+    if (it == m_summaries.end ()) {
+        std::shared_ptr<NotifyNotification> desktop_notification (
+                notify_notification_new (notification.app_name.c_str (), nullptr, "phone"), g_object_unref);
+        g_signal_connect (desktop_notification.get (), "closed", G_CALLBACK (on_summary_closed), this);
+        it = m_summaries.insert ({ key, { notification.app_name, desktop_notification, 0, std::string (), false } })
+                     .first;
+    }
 
-    GError* err = nullptr;
-    notify_notification_close (m_desktop_notifications.at (id).get (), &err);
-    if (err)
-        g_error_free (err);
-    else
-        m_desktop_notifications.erase (id);
+    it->second.count++;
+    it->second.last_title = notification.title;
+    it->second.dirty = true;
+    m_statistics.merged++;
+
+    // Summaries are updated together, so a storm only causes one update per interval
+    if (!m_flush_connection.connected ()) {
+        m_flush_connection = Glib::signal_timeout ().connect (sigc::mem_fun (*this, &Notifications::flush_summaries),
+                                                              SUMMARY_UPDATE_INTERVAL);
+    }
+}
+
+bool
+Notifications::flush_summaries ()
+{
+    bool updated = false;
+    for (auto& item : m_summaries) {
+        Summary& summary = item.second;
+        if (!summary.dirty) continue;
+        summary.dirty = false;
+        updated = true;
+
+        std::string body = std::to_string (summary.count) +
+                           (summary.count == 1 ? " more notification" : " more notifications") + "\n" +
+                           summary.last_title;
+        notify_notification_update (summary.notification.get (), summary.app_name.c_str (), body.c_str (), "phone");
+
+        GError* err = nullptr;
+        notify_notification_show (summary.notification.get (), &err);
+        if (err) {
+            g_warning ("Unable to show notification summary: %s", err->message);
+            g_error_free (err);
+        } else {
+            m_statistics.summary_updates++;
+        }
+    }
+
+    if (updated) {
+        g_debug ("Notifications: %lu shown, %lu merged, %lu suppressed, %lu summary updates",
+                 static_cast<unsigned long> (m_statistics.shown), static_cast<unsigned long> (m_statistics.merged),
+                 static_cast<unsigned long> (m_statistics.suppressed),
+                 static_cast<unsigned long> (m_statistics.summary_updates));
+    }
+
+    // Keep going while notifications are merged, the next update is then delayed by a full interval
+    return updated;
+}
+
+void
+Notifications::on_notification_dismissed (const std::shared_ptr<Device>& device, const std::string& id)
+{
+    auto popup = m_store.get_popup (device->get_device_id (), id);
+    if (popup) {
+        g_signal_handlers_disconnect_by_data (popup.get (), this);
+        GError* err = nullptr;
+        notify_notification_close (popup.get (), &err);
+        if (err) g_error_free (err);
+    }
+    m_store.remove (device->get_device_id (), id);
 }
 
 void
 Notifications::on_notification_closed (NotifyNotification* notification, Notifications* self)
 {
-    for (const auto& item : self->m_desktop_notifications) {
-        if (item.second.get () == notification) {
-            self->m_desktop_notifications.erase (item.first);
+    // The notification is kept until it is dismissed
+    std::string device_id, id;
+    if (self->m_store.find_popup (notification, device_id, id)) self->m_store.set_popup (device_id, id, nullptr);
+}
+
+void
+Notifications::on_summary_closed (NotifyNotification* notification, Notifications* self)
+{
+    // The next merged notification starts a new summary
+    for (auto it = self->m_summaries.begin (); it != self->m_summaries.end (); ++it) {
+        if (it->second.notification.get () == notification) {
+            self->m_summaries.erase (it);
             return;
         }
     }
@@ -142,7 +378,7 @@ Notifications::dismiss (const std::shared_ptr<Device>& device, const std::string
 {
     Json::Value body (Json::objectValue);
     body["cancel"] = id;
-    NetworkPacket packet ("kdeconnect.notification.request", body);
+    NetworkPacket packet (PACKET_TYPE_REQUEST, body);
     device->send (packet);
     m_signal_notification_dismissed.emit (device, id);
 }
\ No newline at end of file
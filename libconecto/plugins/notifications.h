@@ -21,10 +21,11 @@
 #pragma once
 
 #include "abstract-packet-handler.h"
+#include "notification-store.h"
+#include "notification-icon-cache.h"
 #include <map>
+#include <vector>
 #include <sigc++/sigc++.h>
-#include <glibmm/datetime.h>
-#include <libnotify/notification.h>
 
 namespace Conecto {
 
@@ -32,8 +33,85 @@ class NetworkPacket;
 
 namespace Plugins {
 
+/**
+ * @brief Decides which notifications are shown as separate popups
+ *
+ * Every device and every app of a device has a token bucket. Showing a popup takes a token from both buckets and
+ * tokens are refilled at a fixed rate, so short bursts are shown as usual while a storm (e.g. a busy group chat) is
+ * merged once one of the buckets is empty.
+ */
+class NotificationRateLimiter {
+  public:
+    struct Limits {
+        /** @brief Number of popups which can be shown in a row */
+        int     burst;
+        /** @brief Time until another popup can be shown (in microseconds) */
+        int64_t refill_interval;
+    };
+
+    NotificationRateLimiter (const Limits& device_limits, const Limits& app_limits);
+    ~NotificationRateLimiter () {}
+
+    /**
+     * Check if a notification from @p app_name on @p device_id should be shown as a popup at @p now (monotonic time
+     * in microseconds), takes a token from both buckets if it should
+     *
+     * @return false if the notification should be merged into a summary
+     */
+    bool submit (const std::string& device_id, const std::string& app_name, int64_t now);
+
+  private:
+    struct Bucket {
+        double  tokens;
+        int64_t updated;
+    };
+
+    static void refill (Bucket& bucket, const Limits& limits, int64_t now) noexcept;
+
+    Limits                                                          m_device_limits;
+    Limits                                                          m_app_limits;
+    std::map<std::string /* device id */, Bucket>                   m_device_buckets;
+    std::map<std::pair<std::string, std::string /* app */>, Bucket> m_app_buckets;
+};
+
+/**
+ * @brief Persistent storage for received notifications
+ *
+ * Notifications are handed over in batches, writing them is expected to happen asynchronously.
+ */
+class NotificationArchive {
+  public:
+    NotificationArchive () {}
+    virtual ~NotificationArchive () {}
+
+    /**
+     * Store notifications received from @p device_id (in a single transaction)
+     */
+    void store_notifications (const std::string& device_id, std::vector<NotificationInfo>&& notifications)
+    {
+        store_notifications_virt (device_id, std::move (notifications));
+    }
+
+    NotificationArchive (const NotificationArchive&) = delete;
+    NotificationArchive& operator= (const NotificationArchive&) = delete;
+
+  protected:
+    virtual void store_notifications_virt (const std::string&               device_id,
+                                           std::vector<NotificationInfo>&& notifications) = 0;
+};
+
 /**
  * @brief Notifications plugin
+ *
+ * Notifications are shown as desktop popups, rate-limited by a @p NotificationRateLimiter. Notifications above the
+ * limit are merged into one summary per device and app, which is updated in place (at most once per second).
+ *
+ * Received notifications are kept in a @p NotificationStore, resent notifications are only reported again if their
+ * contents have changed. New and changed notifications are also collected and passed to the @p NotificationArchive
+ * in batches.
+ *
+ * Icons sent along with notifications are downloaded in the background and stored in a @p NotificationIconCache, the
+ * notification is updated once its icon is available.
  */
 class Notifications : public AbstractPacketHandler {
   public:
@@ -41,14 +119,22 @@ class Notifications : public AbstractPacketHandler {
      * Create a new instance of this plugin
      */
     Notifications ();
-    ~Notifications () {}
-
-    struct NotificationInfo {
-        std::string    id;
-        std::string    app_name;
-        std::string    title;
-        std::string    body;
-        Glib::DateTime time;
+    ~Notifications ();
+
+    using NotificationInfo = Plugins::NotificationInfo;
+
+    /**
+     * @brief Counters of the shown desktop popups
+     */
+    struct Statistics {
+        /** @brief Notifications shown as a separate popup */
+        uint64_t shown = 0;
+        /** @brief Notifications merged into a summary */
+        uint64_t merged = 0;
+        /** @brief Notifications not shown at all, because they are silent */
+        uint64_t suppressed = 0;
+        /** @brief Times a summary popup has been shown or updated */
+        uint64_t summary_updates = 0;
     };
 
     /**
@@ -64,7 +150,7 @@ class Notifications : public AbstractPacketHandler {
     using type_signal_notification_dismissed =
             sigc::signal<void, const std::shared_ptr<Device>& /* device */, const std::string& /* id */>;
     /**
-     * Emitted after receiving a new notification from a device
+     * Emitted after receiving a new notification from a device (or a changed notification with a known id)
      */
     type_signal_new_notification signal_new_notification () { return m_signal_new_notification; }
     /**
@@ -75,6 +161,15 @@ class Notifications : public AbstractPacketHandler {
     /** @brief Dismiss a notification, this will immediately emit a @p signal_notification_dismissed */
     void dismiss (const std::shared_ptr<Device>& device, const std::string& id);
 
+    /** @brief Counters of the shown desktop popups */
+    const Statistics& get_statistics () const noexcept { return m_statistics; }
+    /** @brief The notifications received from all devices */
+    NotificationStore& get_store () noexcept { return m_store; }
+    /** @brief The icons of received notifications (see @p NotificationInfo::icon) */
+    NotificationIconCache& get_icon_cache () noexcept { return m_icon_cache; }
+    /** @brief Set the archive for received notifications (pending notifications are written to the previous one) */
+    void set_archive (const std::weak_ptr<NotificationArchive>& archive);
+
     Notifications (const Notifications&) = delete;
     Notifications& operator= (const Notifications&) = delete;
 
@@ -86,6 +181,8 @@ class Notifications : public AbstractPacketHandler {
     std::string get_packet_type_virt () const noexcept override;
     void        register_device_virt (const std::shared_ptr<Device>& device) noexcept override;
     void        unregister_device_virt (const std::shared_ptr<Device>& device) noexcept override;
+    void        add_initial_requests_virt (const std::shared_ptr<Device>& device,
+                                           std::vector<InitialRequest>&  requests) noexcept override;
 
     // default signal handlers
     void on_new_notification (const std::shared_ptr<Device>& device, const NotificationInfo& notification);
@@ -97,9 +194,41 @@ class Notifications : public AbstractPacketHandler {
     type_signal_new_notification       m_signal_new_notification;
     type_signal_notification_dismissed m_signal_notification_dismissed;
 
-    static void on_notification_closed (NotifyNotification* notification, Notifications* self);
+    /**
+     * @brief Notifications from an app which have been merged, shown as a single popup
+     */
+    struct Summary {
+        std::string                         app_name;
+        std::shared_ptr<NotifyNotification> notification;
+        int                                 count;
+        std::string                         last_title;
+        // true if the popup doesn't show the latest count yet
+        bool                                dirty;
+    };
+    using SummaryKey = std::pair<std::string /* device id */, std::string /* app */>;
 
-    std::map<std::string /* id */, std::shared_ptr<NotifyNotification> /* notification */> m_desktop_notifications;
+    void merge_notification (const std::shared_ptr<Device>& device, const NotificationInfo& notification);
+    bool flush_summaries ();
+    void archive_notification (const std::string& device_id, const NotificationInfo& notification);
+    void flush_archive ();
+    void fetch_icon (const std::shared_ptr<Device>& device, const std::string& id, const std::string& hash,
+                     const std::shared_ptr<const NetworkPacket::Payload>& payload);
+    void set_popup_icon (NotifyNotification* popup, const std::string& hash);
+
+    static void on_notification_closed (NotifyNotification* notification, Notifications* self);
+    static void on_summary_closed (NotifyNotification* notification, Notifications* self);
+
+    NotificationStore             m_store;
+    NotificationIconCache         m_icon_cache;
+    NotificationRateLimiter       m_rate_limiter;
+    std::map<SummaryKey, Summary> m_summaries;
+    sigc::connection              m_flush_connection;
+    Statistics                    m_statistics;
+
+    std::weak_ptr<NotificationArchive>                                  m_archive;
+    std::map<std::string /* device id */, std::vector<NotificationInfo>> m_archive_pending;
+    size_t                                                              m_archive_pending_count;
+    sigc::connection                                                    m_archive_flush_connection;
 };
 
 } // namespace Plugins
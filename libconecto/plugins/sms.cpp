@@ -0,0 +1,386 @@
+/* sms.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "sms.h"
+#include "device.h"
+#include "network-packet.h"
+#include <algorithm>
+#include <cstdint>
+#include <set>
+#include <glib.h>
+#include <glibmm/main.h>
+
+using namespace Conecto::Plugins;
+
+namespace {
+
+constexpr char PACKET_TYPE[] = "kdeconnect.sms.messages";
+constexpr char PACKET_TYPE_REQUEST_CONVERSATIONS[] = "kdeconnect.sms.request_conversations";
+constexpr char PACKET_TYPE_REQUEST_CONVERSATION[] = "kdeconnect.sms.request_conversation";
+
+// Telephony.TextBasedSmsColumns.MESSAGE_TYPE_INBOX
+constexpr int MESSAGE_TYPE_INBOX = 1;
+// Time to wait for the reply to a request until the sync is aborted (in seconds)
+constexpr unsigned int REPLY_TIMEOUT = 30;
+
+std::vector<SMSMessage>
+parse_messages (const Conecto::NetworkPacket& packet)
+{
+    const Json::Value&      values = packet.get_body ()["messages"];
+    std::vector<SMSMessage> res;
+    if (!values.isArray ()) return res;
+
+    res.reserve (values.size ());
+    for (const auto& value : values) {
+        SMSMessage message;
+        if (SMSMessage::from_json (value, message))
+            res.push_back (std::move (message));
+        else
+            g_debug ("Ignoring invalid message in %s packet", PACKET_TYPE);
+    }
+    return res;
+}
+
+} // namespace
+
+bool
+SMSMessage::from_json (const Json::Value& value, SMSMessage& message)
+{
+    if (!value.isObject () || !value["date"].isIntegral () || !value["thread_id"].isIntegral () ||
+        !value["_id"].isIntegral () || !value["addresses"].isArray () || value["addresses"].empty ())
+        return false;
+
+    // Only the first address is used for group conversations
+    const Json::Value& address = value["addresses"][0]["address"];
+    if (!address.isString ()) return false;
+
+    message.body = value["body"].isString () ? value["body"].asString () : std::string ();
+    message.address = address.asString ();
+    message.date = value["date"].asInt64 ();
+    message.received = value["type"].isIntegral () && value["type"].asInt () == MESSAGE_TYPE_INBOX;
+    // Older versions of the Android app don't send the flag
+    message.read = value["read"].isIntegral () ? value["read"].asInt () != 0 : !message.received;
+    message.thread_id = value["thread_id"].asInt64 ();
+    message.message_id = value["_id"].asInt64 ();
+    return true;
+}
+
+SMSSync::SMSSync (const std::shared_ptr<Device>& device, const std::weak_ptr<SMSStore>& store, const SlotSend& send,
+                  int page_size)
+    : m_device (device)
+    , m_store (store)
+    , m_send (send)
+    , m_page_size (page_size)
+    , m_state (State::IDLE)
+    , m_alive (std::make_shared<bool> (true))
+{
+}
+
+SMSSync::~SMSSync ()
+{
+    m_reply_timeout_connection.disconnect ();
+}
+
+void
+SMSSync::start ()
+{
+    auto store = m_store.lock ();
+    if (!store || m_state != State::IDLE) return;
+
+    g_debug ("Syncing messages of %s", m_device->to_string ().c_str ());
+    m_state = State::LOADING_HIGH_WATER_MARKS;
+    std::weak_ptr<bool> alive = m_alive;
+    store->get_high_water_marks (*m_device, [this, alive] (bool success, SMSStore::HighWaterMarks marks) {
+        if (alive.expired ()) return;
+        if (!success) {
+            g_warning ("Failed to read the sync state of %s", m_device->to_string ().c_str ());
+            abort ();
+            return;
+        }
+        on_high_water_marks (std::move (marks));
+    });
+}
+
+void
+SMSSync::abort ()
+{
+    if (m_state == State::IDLE) return;
+
+    g_debug ("Aborting the sync of %s", m_device->to_string ().c_str ());
+    m_reply_timeout_connection.disconnect ();
+    m_state = State::IDLE;
+    m_pending.clear ();
+    m_high_water_marks.clear ();
+    // Callbacks of the store which are still pending belong to the aborted sync
+    m_alive = std::make_shared<bool> (true);
+}
+
+void
+SMSSync::handle_messages (const NetworkPacket& packet)
+{
+    std::vector<SMSMessage> messages = parse_messages (packet);
+
+    // Replies can't be told apart from pushed messages by their type, only by their contents
+    if (m_state == State::AWAITING_CONVERSATIONS && is_conversation_list (messages)) {
+        m_reply_timeout_connection.disconnect ();
+        on_conversations (std::move (messages));
+        return;
+    }
+
+    if (m_state == State::AWAITING_PAGE && is_page (messages)) {
+        m_reply_timeout_connection.disconnect ();
+        on_page (std::move (messages));
+        return;
+    }
+
+    // A message which has just been sent or received
+    if (!messages.empty ()) store (std::move (messages), std::function<void ()> ());
+}
+
+bool
+SMSSync::is_conversation_list (const std::vector<SMSMessage>& messages)
+{
+    // The list contains the newest message of every thread, a pushed burst usually belongs to a single thread
+    std::set<int64_t> thread_ids;
+    for (const auto& message : messages)
+        if (!thread_ids.insert (message.thread_id).second) return false;
+    return true;
+}
+
+bool
+SMSSync::is_page (const std::vector<SMSMessage>& messages) const
+{
+    // A message pushed to the requested thread is newer than the requested range
+    const PendingThread& thread = m_pending.front ();
+    return std::all_of (messages.begin (), messages.end (), [&thread] (const SMSMessage& message) {
+        return message.thread_id == thread.id && message.date <= thread.range_start;
+    });
+}
+
+void
+SMSSync::on_high_water_marks (SMSStore::HighWaterMarks marks)
+{
+    m_high_water_marks = std::move (marks);
+    m_state = State::AWAITING_CONVERSATIONS;
+    request (NetworkPacket (PACKET_TYPE_REQUEST_CONVERSATIONS, Json::Value (Json::objectValue)));
+}
+
+void
+SMSSync::request (const NetworkPacket& packet)
+{
+    m_reply_timeout_connection.disconnect ();
+    m_reply_timeout_connection =
+            Glib::signal_timeout ().connect_seconds (sigc::mem_fun (*this, &SMSSync::on_reply_timeout), REPLY_TIMEOUT);
+    m_send (packet);
+}
+
+bool
+SMSSync::on_reply_timeout ()
+{
+    g_warning ("%s didn't reply to a request for messages", m_device->to_string ().c_str ());
+    abort ();
+    return false;
+}
+
+void
+SMSSync::on_conversations (std::vector<SMSMessage>&& latest)
+{
+    // Only conversations with messages newer than their high-water mark need to be synced
+    std::vector<SMSMessage> changed;
+    m_pending.clear ();
+    for (auto& message : latest) {
+        auto    it = m_high_water_marks.find (message.thread_id);
+        int64_t high_water_mark = it == m_high_water_marks.end () ? INT64_MIN : it->second;
+        if (message.date <= high_water_mark) continue;
+
+        m_pending.push_back ({ message.thread_id, high_water_mark, message.date, message.date });
+        changed.push_back (std::move (message));
+    }
+    m_high_water_marks.clear ();
+
+    // Most recent conversations first
+    std::sort (m_pending.begin (), m_pending.end (),
+               [] (const PendingThread& a, const PendingThread& b) { return a.newest > b.newest; });
+    g_debug ("%zu of %zu conversations have new messages", m_pending.size (), latest.size ());
+
+    m_state = State::STORING_PAGE;
+    store (std::move (changed), [this] () {
+        if (m_pending.empty ()) {
+            m_state = State::IDLE;
+            m_signal_finished.emit ();
+        } else {
+            request_next_page ();
+        }
+    });
+}
+
+void
+SMSSync::on_page (std::vector<SMSMessage>&& messages)
+{
+    PendingThread& thread = m_pending.front ();
+
+    // The thread is complete once a page is not full or reaches messages which have already been synced
+    bool                    complete = messages.size () < static_cast<size_t> (m_page_size);
+    int64_t                 oldest = thread.range_start;
+    std::vector<SMSMessage> fresh;
+    fresh.reserve (messages.size ());
+    for (auto& message : messages) {
+        oldest = std::min (oldest, message.date);
+        if (message.date > thread.high_water_mark)
+            fresh.push_back (std::move (message));
+        else
+            complete = true;
+    }
+    // Don't request the same page again if the phone didn't return any older messages
+    if (oldest >= thread.range_start) complete = true;
+    thread.range_start = oldest;
+
+    m_state = State::STORING_PAGE;
+    store (std::move (fresh), [this, complete] () {
+        if (complete)
+            finish_thread ();
+        else
+            request_next_page ();
+    });
+}
+
+void
+SMSSync::request_next_page ()
+{
+    const PendingThread& thread = m_pending.front ();
+
+    Json::Value body (Json::objectValue);
+    body["threadID"] = Json::Int64 (thread.id);
+    body["rangeStartTimestamp"] = Json::Int64 (thread.range_start);
+    body["numberToRequest"] = m_page_size;
+    m_state = State::AWAITING_PAGE;
+    request (NetworkPacket (PACKET_TYPE_REQUEST_CONVERSATION, body));
+}
+
+void
+SMSSync::finish_thread ()
+{
+    const PendingThread& thread = m_pending.front ();
+    if (auto store = m_store.lock ()) store->set_high_water_mark (*m_device, thread.id, thread.newest);
+    m_pending.pop_front ();
+
+    if (m_pending.empty ()) {
+        g_debug ("Messages of %s are in sync", m_device->to_string ().c_str ());
+        m_state = State::IDLE;
+        m_signal_finished.emit ();
+    } else {
+        request_next_page ();
+    }
+}
+
+void
+SMSSync::store (std::vector<SMSMessage>&& messages, const std::function<void ()>& done)
+{
+    auto store = m_store.lock ();
+    if (!store) {
+        // Nothing to sync into anymore
+        m_state = State::IDLE;
+        m_pending.clear ();
+        return;
+    }
+
+    if (messages.empty ()) {
+        if (done) done ();
+        return;
+    }
+
+    std::weak_ptr<bool> alive = m_alive;
+    store->store_messages (*m_device, std::move (messages), [this, alive, done] (bool success) {
+        if (alive.expired () || !done) return;
+        if (!success) {
+            // Continuing would move high-water marks past the messages which haven't been written
+            g_warning ("Failed to store the messages of %s", m_device->to_string ().c_str ());
+            abort ();
+            return;
+        }
+        done ();
+    });
+}
+
+SMS::SMS (const std::weak_ptr<SMSStore>& store)
+    : AbstractPacketHandler ()
+    , m_store (store)
+{
+}
+
+std::string
+SMS::get_packet_type_virt () const noexcept
+{
+    return PACKET_TYPE;
+}
+
+void
+SMS::register_device_virt (const std::shared_ptr<Device>& device) noexcept
+{
+    std::weak_ptr<Device> weak_device = device;
+    DeviceEntry&          entry = m_devices[device];
+    entry.synced = false;
+    entry.sync = std::make_unique<SMSSync> (device, m_store,
+                                            [weak_device] (const NetworkPacket& packet) {
+                                                if (auto device = weak_device.lock ()) device->send (packet);
+                                            });
+    entry.connections.push_back (
+            device->signal_message ().connect (sigc::bind (sigc::mem_fun (*this, &SMS::on_message), device)));
+    entry.connections.push_back (entry.sync->signal_finished ().connect ([this, weak_device] () {
+        if (auto device = weak_device.lock ()) m_signal_sync_finished.emit (device);
+    }));
+    // Replies can't arrive anymore, sync again after the device has reconnected
+    entry.connections.push_back (device->signal_disconnected ().connect ([&entry] () {
+        entry.synced = false;
+        entry.sync->abort ();
+    }));
+}
+
+void
+SMS::unregister_device_virt (const std::shared_ptr<Device>& device) noexcept
+{
+    auto it = m_devices.find (device);
+    if (it == m_devices.end ()) return;
+
+    for (auto& connection : it->second.connections) connection.disconnect ();
+    m_devices.erase (it);
+}
+
+void
+SMS::sync (const std::shared_ptr<Device>& device)
+{
+    auto it = m_devices.find (device);
+    if (it == m_devices.end ()) return;
+
+    it->second.synced = true;
+    it->second.sync->start ();
+}
+
+void
+SMS::on_message (const NetworkPacket& message, const std::shared_ptr<Device>& device)
+{
+    auto it = m_devices.find (device);
+    if (it == m_devices.end ()) return;
+
+    // Receiving a packet means that the (secure) connection has been established
+    if (!it->second.synced && device->get_is_paired ()) sync (device);
+
+    if (message.get_type () == PACKET_TYPE) it->second.sync->handle_messages (message);
+}
@@ -0,0 +1,286 @@
+/* sms.h
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "abstract-packet-handler.h"
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <vector>
+#include <json/json.h>
+#include <sigc++/sigc++.h>
+
+namespace Conecto {
+
+class NetworkPacket;
+
+namespace Plugins {
+
+/**
+ * @brief A text message as sent by the phone
+ */
+struct SMSMessage {
+    std::string body;
+    /** @brief The other party's phone number */
+    std::string address;
+    /** @brief Milliseconds since the epoch */
+    int64_t     date;
+    /** @brief true if the message has been received, false if it has been sent from the phone */
+    bool        received;
+    /** @brief true if the message has been read on the phone */
+    bool        read;
+    /** @brief Ids assigned by the phone */
+    int64_t     thread_id;
+    int64_t     message_id;
+
+    /**
+     * Read a message from an entry of a kdeconnect.sms.messages packet
+     *
+     * @return false if @p value is not a valid message
+     */
+    static bool from_json (const Json::Value& value, SMSMessage& message);
+};
+
+/**
+ * @brief Local storage for messages synced by @p SMSSync
+ *
+ * All operations are asynchronous, the callbacks are expected to be called on the main context.
+ */
+class SMSStore {
+  public:
+    SMSStore () {}
+    virtual ~SMSStore () {}
+
+    /** @brief Maps a thread id to the date of the newest message which has been synced completely */
+    using HighWaterMarks = std::map<int64_t /* thread id */, int64_t /* date */>;
+    /**
+     * @param success false if the high-water marks couldn't be read
+     * @param marks The high-water marks (empty if @p success is false)
+     */
+    using SlotHighWaterMarks = std::function<void (bool /* success */, HighWaterMarks /* marks */)>;
+    /**
+     * @param success false if the messages couldn't be written
+     */
+    using SlotStored = std::function<void (bool /* success */)>;
+
+    /**
+     * Get the high-water marks of all conversations of @p device
+     */
+    void get_high_water_marks (const Device& device, const SlotHighWaterMarks& done)
+    {
+        get_high_water_marks_virt (device, done);
+    }
+    /**
+     * Remember that all messages of a thread up to @p date have been synced
+     */
+    void set_high_water_mark (const Device& device, int64_t thread_id, int64_t date)
+    {
+        set_high_water_mark_virt (device, thread_id, date);
+    }
+    /**
+     * Store a chunk of messages (in a single transaction), messages which have already been stored are skipped
+     *
+     * @param done Called once the messages have been written (may be empty)
+     */
+    void store_messages (const Device& device, std::vector<SMSMessage>&& messages, const SlotStored& done)
+    {
+        store_messages_virt (device, std::move (messages), done);
+    }
+
+    SMSStore (const SMSStore&) = delete;
+    SMSStore& operator= (const SMSStore&) = delete;
+
+  protected:
+    virtual void get_high_water_marks_virt (const Device& device, const SlotHighWaterMarks& done) = 0;
+    virtual void set_high_water_mark_virt (const Device& device, int64_t thread_id, int64_t date) = 0;
+    virtual void store_messages_virt (const Device& device, std::vector<SMSMessage>&& messages,
+                                      const SlotStored& done) = 0;
+};
+
+/**
+ * @brief Incremental synchronization of a device's conversations
+ *
+ * The phone is asked for the newest message of every conversation first. Conversations with messages newer than their
+ * high-water mark are then requested page by page (newest first) until the high-water mark is reached. Every page is
+ * handed to the store as soon as it arrives and the next page is only requested once it has been written, so a long
+ * history never needs to be held in memory.
+ *
+ * The class only talks to the phone through @p SlotSend and @p handle_messages, so it can be driven by a fake peer.
+ */
+class SMSSync {
+  public:
+    using SlotSend = std::function<void (const NetworkPacket&)>;
+
+    /**
+     * @param device The device whose messages are synced
+     * @param store The storage, the sync is aborted if it is destroyed
+     * @param send Used for sending requests to the device
+     * @param page_size The number of messages requested at once
+     */
+    SMSSync (const std::shared_ptr<Device>& device, const std::weak_ptr<SMSStore>& store, const SlotSend& send,
+             int page_size = 100);
+    ~SMSSync ();
+
+    /**
+     * Start a new sync (does nothing if a sync is already running)
+     */
+    void start ();
+    /**
+     * Stop the running sync (e.g. because the device has disconnected), a new one can be started afterwards
+     *
+     * Threads which haven't been synced completely are requested again by the next sync, replies to requests of the
+     * aborted sync are handled like new messages.
+     */
+    void abort ();
+    /**
+     * Handle a kdeconnect.sms.messages packet
+     *
+     * Packets which are not a response to a request (e.g. a message which has just been received) are stored directly.
+     * The list of conversations needs to contain at most one message per thread, and a page may only contain messages
+     * of the requested thread which aren't newer than the requested range. Anything else is taken as pushed messages.
+     */
+    void handle_messages (const NetworkPacket& packet);
+
+    /** @brief true if a sync is in progress */
+    bool get_is_running () const noexcept { return m_state != State::IDLE; }
+
+    using type_signal_finished = sigc::signal<void>;
+    /**
+     * Emitted once all conversations have been synced
+     */
+    type_signal_finished signal_finished () { return m_signal_finished; }
+
+    SMSSync (const SMSSync&) = delete;
+    SMSSync& operator= (const SMSSync&) = delete;
+
+  private:
+    enum class State {
+        IDLE,
+        LOADING_HIGH_WATER_MARKS,
+        AWAITING_CONVERSATIONS,
+        AWAITING_PAGE,
+        STORING_PAGE,
+    };
+
+    struct PendingThread {
+        int64_t id;
+        int64_t high_water_mark;
+        /** @brief Date of the thread's newest message, becomes the high-water mark once the thread has been synced */
+        int64_t newest;
+        /** @brief The next page contains messages older than this */
+        int64_t range_start;
+    };
+
+    /**
+     * @return true if @p messages can be the reply to a request for the list of conversations
+     */
+    static bool is_conversation_list (const std::vector<SMSMessage>& messages);
+    /**
+     * @return true if @p messages can be the reply to the request for the current page
+     */
+    bool is_page (const std::vector<SMSMessage>& messages) const;
+    void on_high_water_marks (SMSStore::HighWaterMarks marks);
+    /**
+     * Send a request, the sync is aborted if the device doesn't reply in time
+     */
+    void request (const NetworkPacket& packet);
+    bool on_reply_timeout ();
+    void on_conversations (std::vector<SMSMessage>&& latest);
+    void on_page (std::vector<SMSMessage>&& messages);
+    void request_next_page ();
+    void finish_thread ();
+    /**
+     * Store @p messages and call @p done once they have been written, the sync is aborted if writing fails
+     */
+    void store (std::vector<SMSMessage>&& messages, const std::function<void ()>& done);
+
+    std::shared_ptr<Device>   m_device;
+    std::weak_ptr<SMSStore>   m_store;
+    SlotSend                  m_send;
+    int                       m_page_size;
+    State                     m_state;
+    SMSStore::HighWaterMarks  m_high_water_marks;
+    std::deque<PendingThread> m_pending;
+    std::shared_ptr<bool>     m_alive;
+    sigc::connection          m_reply_timeout_connection;
+
+    type_signal_finished m_signal_finished;
+};
+
+/**
+ * @brief SMS plugin, keeps the local message history in sync with the phone
+ *
+ * A sync is started once the first packet arrives over a paired connection. It isn't one of the device's initial
+ * requests, because it has to read the high-water marks from the store first.
+ */
+class SMS : public AbstractPacketHandler {
+  public:
+    /**
+     * Create a new instance of this plugin
+     *
+     * @param store The storage synced messages are written to
+     */
+    SMS (const std::weak_ptr<SMSStore>& store);
+    ~SMS () {}
+
+    /**
+     * Sync the conversations of @p device (this happens automatically once a packet has been received)
+     */
+    void sync (const std::shared_ptr<Device>& device);
+
+    /**
+     * @param device The device whose conversations have been synced
+     */
+    using type_signal_sync_finished = sigc::signal<void, const std::shared_ptr<Device>& /* device */>;
+    /**
+     * Emitted once all conversations of a device have been synced
+     */
+    type_signal_sync_finished signal_sync_finished () { return m_signal_sync_finished; }
+
+    SMS (const SMS&) = delete;
+    SMS& operator= (const SMS&) = delete;
+
+  protected:
+    // packet handler
+    void on_message (const NetworkPacket& message, const std::shared_ptr<Device>& device);
+
+    // overrides
+    std::string get_packet_type_virt () const noexcept override;
+    void        register_device_virt (const std::shared_ptr<Device>& device) noexcept override;
+    void        unregister_device_virt (const std::shared_ptr<Device>& device) noexcept override;
+
+  private:
+    struct DeviceEntry {
+        std::list<sigc::connection> connections;
+        std::unique_ptr<SMSSync>    sync;
+        /** @brief true if the device has been synced since it has connected */
+        bool synced;
+    };
+
+    std::weak_ptr<SMSStore>                        m_store;
+    std::map<std::shared_ptr<Device>, DeviceEntry> m_devices;
+
+    type_signal_sync_finished m_signal_sync_finished;
+};
+
+} // namespace Plugins
+} // namespace Conecto
@@ -23,6 +23,7 @@
 #include "models/connected-devices.h"
 #include "models/unavailable-devices.h"
 #include "models/sms-storage.h"
+#include "models/notification-history.h"
 #include "controllers/active-device-manager.h"
 #include "device-popover.h"
 #ifdef ENABLE_PLANK_SUPPORT
@@ -37,6 +38,7 @@ Application::Application ()
     , m_unavailable_devices (Models::UnavailableDevices::create ())
     , m_available_devices (Models::AvailableDevices::create ())
     , m_sms_storage (std::make_shared<Models::SMSStorage> ())
+    , m_notification_history (std::make_shared<Models::NotificationHistory> ())
 {
 }
 
@@ -53,6 +55,12 @@ Application::on_startup ()
 
     // Register non-interactive plugins
     Conecto::Backend::get_instance ().register_plugin (std::make_shared<Conecto::Plugins::Mouse> ());
+    Conecto::Backend::get_instance ().register_plugin (std::make_shared<Conecto::Plugins::SMS> (m_sms_storage));
+
+    // Received notifications are written to the history (the plugin is registered by the connected devices model)
+    auto notifications_plugin = std::dynamic_pointer_cast<Conecto::Plugins::Notifications> (
+            Conecto::Backend::get_instance ().get_plugin ("kdeconnect.notification"));
+    if (notifications_plugin) notifications_plugin->set_archive (m_notification_history);
 
     Conecto::Backend::get_instance ().load_from_cache ();
     Conecto::Backend::get_instance ().listen ();
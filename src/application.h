@@ -33,6 +33,7 @@ class ConnectedDevices;
 class UnavailableDevices;
 class AvailableDevices;
 class SMSStorage;
+class NotificationHistory;
 } // namespace Models
 
 /**
@@ -60,12 +61,13 @@ class Application : public Gtk::Application {
     int  on_command_line (const Glib::RefPtr<Gio::ApplicationCommandLine>& command_line) override;
 
   private:
-    std::shared_ptr<Window>                  m_window;
-    Glib::RefPtr<Models::ConnectedDevices>   m_connected_devices;
-    Glib::RefPtr<Models::UnavailableDevices> m_unavailable_devices;
-    Glib::RefPtr<Models::AvailableDevices>   m_available_devices;
-    std::shared_ptr<Models::SMSStorage>      m_sms_storage;
-    Glib::ustring                            m_open_dev_id;
+    std::shared_ptr<Window>                      m_window;
+    Glib::RefPtr<Models::ConnectedDevices>       m_connected_devices;
+    Glib::RefPtr<Models::UnavailableDevices>     m_unavailable_devices;
+    Glib::RefPtr<Models::AvailableDevices>       m_available_devices;
+    std::shared_ptr<Models::SMSStorage>          m_sms_storage;
+    std::shared_ptr<Models::NotificationHistory> m_notification_history;
+    Glib::ustring                                m_open_dev_id;
 
     std::list<std::shared_ptr<Widgets::PopoverWindow>> m_popovers;
 };
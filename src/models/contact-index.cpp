@@ -0,0 +1,163 @@
+/* contact-index.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "contact-index.h"
+#include "../utils/phone-number.h"
+#include <algorithm>
+
+using namespace App::Models;
+
+ContactIndex::ContactIndex ()
+    : m_sorted_contacts_valid (false)
+{
+}
+
+bool
+ContactIndex::set (const std::string& id, const std::string& display_name, std::vector<std::string>&& phone_numbers)
+{
+    std::vector<std::string> normalized;
+    normalized.reserve (phone_numbers.size ());
+    for (const auto& phone_number : phone_numbers) {
+        std::string number = Utils::PhoneNumber::normalize (phone_number);
+        if (!number.empty () && std::find (normalized.begin (), normalized.end (), number) == normalized.end ())
+            normalized.push_back (std::move (number));
+    }
+    phone_numbers = std::move (normalized);
+
+    auto it = m_entries.find (id);
+    if (it != m_entries.end ()) {
+        if (it->second.contact.display_name == display_name && it->second.contact.phone_numbers == phone_numbers)
+            return false;
+        remove_keys (id, it->second);
+        m_entries.erase (it);
+    }
+
+    std::vector<std::string> keys;
+    keys.reserve (phone_numbers.size ());
+    for (const auto& phone_number : phone_numbers) {
+        std::string key = Utils::PhoneNumber::get_match_key (phone_number);
+        if (key.empty () || std::find (keys.begin (), keys.end (), key) != keys.end ()) continue;
+        m_phone_index.emplace (key, id);
+        keys.push_back (std::move (key));
+    }
+    m_entries.emplace (id, Entry { Contact (display_name, std::move (phone_numbers)), std::move (keys) });
+    m_sorted_contacts_valid = false;
+    return true;
+}
+
+bool
+ContactIndex::remove (const std::string& id)
+{
+    auto it = m_entries.find (id);
+    if (it == m_entries.end ()) return false;
+
+    remove_keys (id, it->second);
+    m_entries.erase (it);
+    m_sorted_contacts_valid = false;
+    return true;
+}
+
+void
+ContactIndex::clear ()
+{
+    m_entries.clear ();
+    m_phone_index.clear ();
+    m_sorted_contacts.clear ();
+    m_sorted_contacts_valid = false;
+}
+
+bool
+ContactIndex::retain (const std::unordered_set<std::string>& ids)
+{
+    bool changed = false;
+    for (auto it = m_entries.begin (); it != m_entries.end ();) {
+        if (ids.find (it->first) != ids.end ()) {
+            ++it;
+            continue;
+        }
+        remove_keys (it->first, it->second);
+        it = m_entries.erase (it);
+        changed = true;
+    }
+    if (changed) m_sorted_contacts_valid = false;
+    return changed;
+}
+
+void
+ContactIndex::load_from_cache (const Glib::KeyFile& cache)
+{
+    clear ();
+    for (const auto& group : cache.get_groups ()) {
+        try {
+            std::vector<Glib::ustring> phone_numbers = cache.get_string_list (group, "phone_numbers");
+            set (group, cache.get_string (group, "name"),
+                 std::vector<std::string> (phone_numbers.begin (), phone_numbers.end ()));
+        } catch (Glib::KeyFileError& err) {
+            g_debug ("Ignoring invalid cached contact %s: %s", group.c_str (), err.what ().c_str ());
+        }
+    }
+}
+
+void
+ContactIndex::to_cache (Glib::KeyFile& cache) const
+{
+    for (const auto& entry : m_entries) {
+        cache.set_string (entry.first, "name", entry.second.contact.display_name);
+        cache.set_string_list (entry.first, "phone_numbers", std::vector<Glib::ustring> (
+                                                                     entry.second.contact.phone_numbers.begin (),
+                                                                     entry.second.contact.phone_numbers.end ()));
+    }
+}
+
+void
+ContactIndex::remove_keys (const std::string& id, const Entry& entry)
+{
+    for (const auto& key : entry.keys) {
+        auto range = m_phone_index.equal_range (key);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == id) {
+                m_phone_index.erase (it);
+                break;
+            }
+        }
+    }
+}
+
+const ContactIndex::Contact*
+ContactIndex::find_by_phone_number (const std::string& phone_number) const
+{
+    auto it = m_phone_index.find (Utils::PhoneNumber::get_match_key (phone_number));
+    if (it == m_phone_index.end ()) return nullptr;
+    return &m_entries.at (it->second).contact;
+}
+
+const std::vector<ContactIndex::Contact>&
+ContactIndex::get_contacts () const
+{
+    if (!m_sorted_contacts_valid) {
+        m_sorted_contacts.clear ();
+        m_sorted_contacts.reserve (m_entries.size ());
+        for (const auto& entry : m_entries) m_sorted_contacts.push_back (entry.second.contact);
+        std::sort (m_sorted_contacts.begin (), m_sorted_contacts.end (),
+                   [] (const Contact& a, const Contact& b) { return a.display_name < b.display_name; });
+        m_sorted_contacts_valid = true;
+    }
+    return m_sorted_contacts;
+}
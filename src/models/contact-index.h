@@ -0,0 +1,109 @@
+/* contact-index.h
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glibmm/keyfile.h>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace App {
+namespace Models {
+
+/**
+ * @brief An index of contacts which can be looked up by phone number
+ *
+ * Phone numbers are stored in their normalized form (see @p Utils::PhoneNumber::normalize) and matched using
+ * @p Utils::PhoneNumber::get_match_key, so different notations of the same number find the same contact.
+ */
+class ContactIndex {
+  public:
+    struct Contact {
+        Contact (const std::string& display_name, std::vector<std::string>&& phone_numbers)
+            : display_name (display_name), phone_numbers (std::move (phone_numbers)) {}
+
+        std::string              display_name;
+        std::vector<std::string> phone_numbers;
+    };
+
+    ContactIndex ();
+    ~ContactIndex () {}
+
+    /**
+     * @brief Add a contact or replace the contact with the same @p id
+     *
+     * @return true if the index has changed
+     */
+    bool set (const std::string& id, const std::string& display_name, std::vector<std::string>&& phone_numbers);
+    /**
+     * @brief Remove the contact with the given @p id
+     *
+     * @return true if the index has changed
+     */
+    bool remove (const std::string& id);
+    void clear ();
+    /**
+     * @brief Remove all contacts whose ids are not contained in @p ids
+     *
+     * @return true if the index has changed
+     */
+    bool retain (const std::unordered_set<std::string>& ids);
+
+    /**
+     * @brief Replace the contents of the index with the contacts stored in @p cache
+     */
+    void load_from_cache (const Glib::KeyFile& cache);
+    /**
+     * @brief Store all contacts in @p cache (one group per contact)
+     */
+    void to_cache (Glib::KeyFile& cache) const;
+
+    /**
+     * @brief Find a contact with the phone number @p phone_number
+     *
+     * @return The contact or nullptr if not found (only valid until the index is changed)
+     */
+    const Contact* find_by_phone_number (const std::string& phone_number) const;
+    /**
+     * @brief Get all contacts, sorted by their display names
+     */
+    const std::vector<Contact>& get_contacts () const;
+    size_t                      size () const noexcept { return m_entries.size (); }
+
+  private:
+    struct Entry {
+        Contact                  contact;
+        std::vector<std::string> keys;
+    };
+
+    void remove_keys (const std::string& id, const Entry& entry);
+
+    std::unordered_map<std::string, Entry>            m_entries;
+    std::unordered_multimap<std::string, std::string> m_phone_index; // match key -> id
+
+    // Built on demand
+    mutable std::vector<Contact> m_sorted_contacts;
+    mutable bool                 m_sorted_contacts_valid;
+};
+
+} // namespace Models
+} // namespace App
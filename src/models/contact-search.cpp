@@ -0,0 +1,145 @@
+/* contact-search.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "contact-search.h"
+#include <glibmm/ustring.h>
+#include <algorithm>
+#include <iterator>
+
+using namespace App::Models;
+
+namespace {
+
+// Never part of a normalized query, so matches can't span multiple fields
+constexpr char KEY_SEPARATOR = '\n';
+
+uint32_t
+get_trigram (const std::string& text, size_t pos)
+{
+    return static_cast<uint32_t> (static_cast<unsigned char> (text[pos])) << 16 |
+           static_cast<uint32_t> (static_cast<unsigned char> (text[pos + 1])) << 8 |
+           static_cast<uint32_t> (static_cast<unsigned char> (text[pos + 2]));
+}
+
+std::string
+get_digits (const std::string& text)
+{
+    std::string res;
+    for (char c : text)
+        if (c >= '0' && c <= '9') res += c;
+    return res;
+}
+
+std::string
+fold (const std::string& text)
+{
+    return Glib::ustring (text).normalize (Glib::NORMALIZE_DEFAULT_COMPOSE).casefold ();
+}
+
+} // namespace
+
+void
+ContactSearch::set_contacts (const std::vector<Contact>& contacts)
+{
+    m_contacts = contacts;
+    m_keys.clear ();
+    m_keys.reserve (m_contacts.size ());
+    m_trigrams.clear ();
+    m_query.clear ();
+    m_results.clear ();
+
+    for (size_t i = 0; i < m_contacts.size (); i++) {
+        std::string key = fold (m_contacts[i].display_name);
+        for (const auto& phone_number : m_contacts[i].phone_numbers) key += KEY_SEPARATOR + get_digits (phone_number);
+
+        for (size_t pos = 0; pos + 3 <= key.size (); pos++) {
+            auto& postings = m_trigrams[get_trigram (key, pos)];
+            // Keys are added in order, so the postings stay sorted and free of duplicates
+            if (postings.empty () || postings.back () != i) postings.push_back (i);
+        }
+        m_keys.push_back (std::move (key));
+    }
+}
+
+const std::vector<size_t>&
+ContactSearch::search (const std::string& text)
+{
+    std::string query = normalize_query (text);
+    if (query.empty ()) {
+        m_results.resize (m_contacts.size ());
+        for (size_t i = 0; i < m_results.size (); i++) m_results[i] = i;
+        m_query.clear ();
+        return m_results;
+    }
+
+    std::vector<size_t> candidates;
+    if (!m_query.empty () && query.find (m_query) != std::string::npos) {
+        // Every match of the new query also matches the previous one
+        candidates = std::move (m_results);
+    } else if (query.size () >= 3) {
+        // Intersect the postings of all trigrams, starting with the shortest list
+        std::vector<const std::vector<size_t>*> lists;
+        for (size_t pos = 0; pos + 3 <= query.size (); pos++) {
+            auto it = m_trigrams.find (get_trigram (query, pos));
+            if (it == m_trigrams.end ()) {
+                lists.clear ();
+                break;
+            }
+            lists.push_back (&it->second);
+        }
+        std::sort (lists.begin (), lists.end (),
+                   [] (const std::vector<size_t>* a, const std::vector<size_t>* b) { return a->size () < b->size (); });
+        if (!lists.empty ()) candidates = *lists.front ();
+        for (size_t i = 1; i < lists.size () && !candidates.empty (); i++) {
+            std::vector<size_t> intersection;
+            std::set_intersection (candidates.begin (), candidates.end (), lists[i]->begin (), lists[i]->end (),
+                                   std::back_inserter (intersection));
+            candidates = std::move (intersection);
+        }
+    } else {
+        candidates.resize (m_contacts.size ());
+        for (size_t i = 0; i < candidates.size (); i++) candidates[i] = i;
+    }
+
+    // Trigrams don't have to be adjacent, so every candidate is verified
+    m_results.clear ();
+    for (size_t i : candidates)
+        if (m_keys[i].find (query) != std::string::npos) m_results.push_back (i);
+    m_query = std::move (query);
+    return m_results;
+}
+
+std::string
+ContactSearch::normalize_query (const std::string& text)
+{
+    bool has_digits = false;
+    bool is_number = true;
+    for (char c : text) {
+        if (c >= '0' && c <= '9')
+            has_digits = true;
+        else if (c != '+' && c != ' ' && c != '-' && c != '/' && c != '(' && c != ')' && c != '.')
+            is_number = false;
+    }
+    if (has_digits && is_number) return get_digits (text);
+
+    std::string res = fold (text);
+    res.erase (std::remove (res.begin (), res.end (), KEY_SEPARATOR), res.end ());
+    return res;
+}
@@ -0,0 +1,75 @@
+/* contact-search.h
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "contact-index.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace App {
+namespace Models {
+
+/**
+ * @brief A type-ahead search over a list of contacts
+ *
+ * Contacts are matched if their (case-folded) display name or one of their phone numbers contains the search text.
+ * Queries which look like a phone number are compared digit by digit, so "170 123" finds "+491701234567".
+ *
+ * Candidates are looked up in a trigram index. If the search text extends the previous one, only the previous results
+ * are filtered, so typing another character is cheap even for large contact lists.
+ */
+class ContactSearch {
+  public:
+    using Contact = ContactIndex::Contact;
+
+    ContactSearch () {}
+    ~ContactSearch () {}
+
+    /**
+     * @brief Replace the searched contacts and rebuild the index
+     */
+    void set_contacts (const std::vector<Contact>& contacts);
+    const std::vector<Contact>& get_contacts () const noexcept { return m_contacts; }
+
+    /**
+     * @brief Find the contacts matching @p text
+     *
+     * @return Indices into @p get_contacts in ascending order (only valid until the next search)
+     */
+    const std::vector<size_t>& search (const std::string& text);
+
+  private:
+    static std::string normalize_query (const std::string& text);
+
+    std::vector<Contact>     m_contacts;
+    /** @brief Text matched for every contact: Folded name and the numbers' digits, separated by '\n' */
+    std::vector<std::string> m_keys;
+    /** @brief Maps a trigram (three bytes) to the indices of all keys containing it */
+    std::unordered_map<uint32_t, std::vector<size_t>> m_trigrams;
+
+    std::string         m_query;
+    std::vector<size_t> m_results;
+};
+
+} // namespace Models
+} // namespace App
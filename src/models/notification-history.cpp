@@ -0,0 +1,262 @@
+/* notification-history.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "notification-history.h"
+
+using namespace App::Models;
+
+namespace {
+
+// Schema migrations, MIGRATIONS[i] upgrades the database from version i to version i + 1 (stored as user_version)
+const char* const MIGRATIONS[] = {
+    // Version 1: A row per received notification. The time is the one reported by the device, so a resent
+    // notification is skipped while an updated one (with a new time) is added.
+    "CREATE TABLE notification("
+    "    id               INTEGER  PRIMARY KEY,"
+    "    device_id        TEXT     NOT NULL,"
+    "    notification_id  TEXT     NOT NULL,"
+    "    app_name         TEXT     NOT NULL,"
+    "    title            TEXT     NOT NULL,"
+    "    body             TEXT     NOT NULL,"
+    "    time             INTEGER  NOT NULL"
+    ");"
+    "CREATE INDEX notification_device_time ON notification(device_id, time);"
+    "CREATE UNIQUE INDEX notification_unique ON notification(device_id, notification_id, time);",
+};
+
+constexpr int SCHEMA_VERSION = sizeof (MIGRATIONS) / sizeof (MIGRATIONS[0]);
+
+// auto_vacuum only takes effect if it is set before the first table is created
+constexpr char CONNECTION_SETUP[] = "PRAGMA auto_vacuum = INCREMENTAL;"
+                                    "PRAGMA journal_mode = WAL;"
+                                    "PRAGMA synchronous = NORMAL;"
+                                    "PRAGMA temp_store = MEMORY;";
+
+constexpr char INSERT_NOTIFICATION[] = "INSERT OR IGNORE INTO notification "
+                                       "(device_id, notification_id, app_name, title, body, time) "
+                                       "VALUES (?1, ?2, ?3, ?4, ?5, ?6);";
+// Keyset pagination: (time, id) is unique and covered by notification_device_time (which includes the rowid)
+constexpr char SELECT_PAGE[] = "SELECT id, notification_id, app_name, title, body, time FROM notification "
+                               "WHERE device_id = ?1 AND (time, id) < (?2, ?3) "
+                               "ORDER BY time DESC, id DESC LIMIT ?4;";
+
+constexpr int64_t MS_PER_DAY = 24ll * 60 * 60 * 1000;
+// Interval of the compaction job (in seconds)
+constexpr unsigned int COMPACTION_INTERVAL = 60 * 60;
+// Number of rows removed per device and transaction
+constexpr int     COMPACTION_CHUNK_SIZE = 1000;
+constexpr char SELECT_DEVICES[] = "SELECT DISTINCT device_id FROM notification;";
+constexpr char DELETE_EXPIRED[] = "DELETE FROM notification WHERE id IN ("
+                                  "    SELECT id FROM notification WHERE device_id = ?1 AND time < ?2 LIMIT ?3"
+                                  ");";
+constexpr char DELETE_EXCESS[] = "DELETE FROM notification WHERE id IN ("
+                                 "    SELECT id FROM notification WHERE device_id = ?1"
+                                 "    ORDER BY time DESC, id DESC LIMIT ?3 OFFSET ?2"
+                                 ");";
+
+int64_t
+to_epoch_ms (const Glib::DateTime& date_time)
+{
+    return date_time.to_unix () * 1000 + date_time.get_microsecond () / 1000;
+}
+
+void
+migrate (App::Utils::SqliteConnection& conn)
+{
+    int version = 0;
+    {
+        App::Utils::SqliteStatement stmt (conn.get_handle (), "PRAGMA user_version;");
+        if (stmt.step ()) version = stmt.get_int (0);
+    }
+    if (version > SCHEMA_VERSION) throw "The notification history database was created by a newer version";
+
+    for (; version < SCHEMA_VERSION; version++) {
+        g_info ("Upgrading notification history database to version %d", version + 1);
+        std::string query = std::string ("BEGIN;") + MIGRATIONS[version] +
+                            "PRAGMA user_version = " + std::to_string (version + 1) + ";COMMIT;";
+        if (!conn.exec (query)) {
+            conn.exec ("ROLLBACK;");
+            throw "An error occured while trying to set up the notification history database";
+        }
+    }
+}
+
+/**
+ * Remove a chunk of notifications which are older than @p expiry or exceed @p max_per_device for their device
+ *
+ * @return true if there are more notifications to be removed
+ */
+bool
+compact (App::Utils::SqliteConnection& conn, int64_t expiry, int max_per_device)
+{
+    std::vector<std::string> devices;
+    auto&                    select = conn.get_statement (SELECT_DEVICES);
+    while (select.step ()) devices.push_back (select.get_string (0));
+    select.reset ();
+
+    if (!conn.get_statement ("BEGIN;").execute ()) return false;
+
+    bool success = true;
+    bool more = false;
+    int  removed = 0;
+    for (const auto& device_id : devices) {
+        success = success && conn.get_statement (DELETE_EXPIRED)
+                                     .bind (1, device_id)
+                                     .bind (2, expiry)
+                                     .bind (3, COMPACTION_CHUNK_SIZE)
+                                     .execute ();
+        int changes = sqlite3_changes (conn.get_handle ());
+        success = success && conn.get_statement (DELETE_EXCESS)
+                                     .bind (1, device_id)
+                                     .bind (2, max_per_device)
+                                     .bind (3, COMPACTION_CHUNK_SIZE)
+                                     .execute ();
+        changes += sqlite3_changes (conn.get_handle ());
+        removed += changes;
+        more = more || changes >= COMPACTION_CHUNK_SIZE;
+    }
+
+    if (!success || !conn.get_statement ("COMMIT;").execute ()) {
+        conn.get_statement ("ROLLBACK;").execute ();
+        return false;
+    }
+    if (removed > 0) g_debug ("Removed %d notifications from the history", removed);
+
+    // Return the freed pages to the file system once everything has been removed
+    if (!more && removed > 0) conn.exec ("PRAGMA incremental_vacuum;");
+    return more;
+}
+
+} // namespace
+
+NotificationHistory::NotificationHistory ()
+    : NotificationHistory (
+              Glib::build_filename (Conecto::Backend::get_instance ().get_config_dir (), "notification-history.db"))
+{
+}
+
+NotificationHistory::NotificationHistory (const std::string& path, int max_age_days, int max_per_device)
+    : m_compacting (false)
+    , m_max_age (max_age_days * MS_PER_DAY)
+    , m_max_per_device (max_per_device)
+{
+    std::vector<std::unique_ptr<Utils::SqliteConnection>> writers;
+    writers.push_back (std::make_unique<Utils::SqliteConnection> (path));
+    if (!writers.front ()->exec (CONNECTION_SETUP)) g_warning ("Failed to configure the notification history database");
+    // The schema needs to be up to date before the reader is opened
+    migrate (*writers.front ());
+
+    std::vector<std::unique_ptr<Utils::SqliteConnection>> readers;
+    readers.push_back (std::make_unique<Utils::SqliteConnection> (path, SQLITE_OPEN_READONLY));
+
+    m_writer = std::make_unique<Utils::SqliteWorker> (std::move (writers));
+    m_reader = std::make_unique<Utils::SqliteWorker> (std::move (readers));
+
+    schedule_compaction ();
+    m_compaction_connection = Glib::signal_timeout ().connect_seconds (
+            [this] () {
+                schedule_compaction ();
+                return true;
+            },
+            COMPACTION_INTERVAL);
+}
+
+NotificationHistory::~NotificationHistory ()
+{
+    m_compaction_connection.disconnect ();
+    // Finish pending writes
+    m_reader.reset ();
+    m_writer.reset ();
+}
+
+void
+NotificationHistory::schedule_compaction ()
+{
+    if (m_compacting) return;
+    m_compacting = true;
+
+    int64_t expiry = g_get_real_time () / 1000 - m_max_age;
+    int     max_per_device = m_max_per_device;
+    m_writer->submit ([expiry, max_per_device] (Utils::SqliteConnection& conn) {
+                          return compact (conn, expiry, max_per_device);
+                      },
+                      [this] (bool more) {
+                          m_compacting = false;
+                          if (more) schedule_compaction ();
+                      },
+                      // Try again with the next interval
+                      [this] (const std::string&) { m_compacting = false; });
+}
+
+void
+NotificationHistory::store_notifications_virt (const std::string&                                  device_id,
+                                               std::vector<Conecto::Plugins::NotificationInfo>&& notifications)
+{
+    if (notifications.empty ()) return;
+
+    auto batch = std::make_shared<std::vector<Conecto::Plugins::NotificationInfo>> (std::move (notifications));
+    m_writer->submit (
+            [device_id, batch] (Utils::SqliteConnection& conn) {
+                if (!conn.get_statement ("BEGIN;").execute ()) return false;
+                for (const auto& notification : *batch) {
+                    conn.get_statement (INSERT_NOTIFICATION)
+                            .bind (1, device_id)
+                            .bind (2, notification.id)
+                            .bind (3, notification.app_name)
+                            .bind (4, notification.title)
+                            .bind (5, notification.body)
+                            .bind (6, to_epoch_ms (notification.time))
+                            .execute ();
+                }
+                if (!conn.get_statement ("COMMIT;").execute ()) {
+                    conn.get_statement ("ROLLBACK;").execute ();
+                    return false;
+                }
+                return true;
+            },
+            [this, device_id] (bool success) {
+                if (success)
+                    m_signal_notifications_added.emit (device_id);
+                else
+                    g_warning ("Failed to write notifications to the history");
+            });
+}
+
+void
+NotificationHistory::read_page (const Conecto::Device& device, const PageKey& before, size_t page_size,
+                                const std::function<void (std::vector<Entry>)>& done)
+{
+    std::string device_id = device.get_device_id ();
+    m_reader->submit (
+            [device_id, before, page_size] (Utils::SqliteConnection& conn) {
+                std::vector<Entry> res;
+                auto&              stmt = conn.get_statement (SELECT_PAGE)
+                                     .bind (1, device_id)
+                                     .bind (2, before.time)
+                                     .bind (3, before.id)
+                                     .bind (4, static_cast<int64_t> (page_size));
+                while (stmt.step ()) {
+                    res.push_back ({ stmt.get_int64 (0), stmt.get_string (1), stmt.get_string (2),
+                                     stmt.get_string (3), stmt.get_string (4), stmt.get_int64 (5) });
+                }
+                return res;
+            },
+            done);
+}
@@ -0,0 +1,136 @@
+/* notification-history.h
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gtkmm.h>
+#include <sqlite3.h>
+#include <conecto.h>
+#include "../utils/sqlite-worker.h"
+
+namespace App {
+namespace Models {
+
+/**
+ * @brief The history of received notifications, stored using sqlite
+ *
+ * Notifications are written in batches by @p Conecto::Plugins::Notifications (through the
+ * @p Conecto::Plugins::NotificationArchive interface). Notifications older than a maximum age (30 days by default) and
+ * everything beyond the newest notifications of a device (5000 by default) are removed by a compaction job, which runs
+ * in the background once per hour.
+ *
+ * Like @p SMSStorage, writes are queued on a single writer connection and reads happen on a read-only connection.
+ */
+class NotificationHistory : public Conecto::Plugins::NotificationArchive {
+  public:
+    /**
+     * @brief Open the notification history
+     */
+    NotificationHistory ();
+    static constexpr int DEFAULT_MAX_AGE_DAYS = 30;
+    static constexpr int DEFAULT_MAX_PER_DEVICE = 5000;
+
+    /**
+     * @brief Open the notification history stored at @p path
+     *
+     * @param max_age_days Notifications older than this are removed
+     * @param max_per_device Number of notifications kept per device (the newest ones)
+     */
+    NotificationHistory (const std::string& path, int max_age_days = DEFAULT_MAX_AGE_DAYS,
+                         int max_per_device = DEFAULT_MAX_PER_DEVICE);
+    ~NotificationHistory ();
+
+    /**
+     * @brief Position in the history of a device, ordered by time
+     */
+    struct PageKey {
+        /** @brief Time of the notification in milliseconds since the epoch */
+        int64_t time;
+        /** @brief The notification's row id (distinguishes notifications with the same time) */
+        int64_t id;
+
+        /** @brief A key after the newest notification (start reading from here) */
+        static PageKey newest () { return { INT64_MAX, INT64_MAX }; }
+    };
+
+    /**
+     * @brief A notification read by @p read_page
+     */
+    struct Entry {
+        int64_t     id;
+        /** @brief The id assigned by the device */
+        std::string notification_id;
+        std::string app_name;
+        std::string title;
+        std::string body;
+        /** @brief Milliseconds since the epoch */
+        int64_t     time;
+
+        /** @brief The key for continuing after this notification */
+        PageKey get_key () const { return { time, id }; }
+    };
+
+    /**
+     * @brief Read up to @p page_size notifications of @p device received before @p before, newest first
+     *
+     * Pass the key of the last returned entry to read the next page.
+     *
+     * @note Not shown in the UI yet: @p Views::NotificationsView only lists the notifications which are currently
+     *       active on a device, browsing the history needs a separate view.
+     */
+    void read_page (const Conecto::Device& device, const PageKey& before, size_t page_size,
+                    const std::function<void (std::vector<Entry>)>& done);
+
+    /**
+     * @param device_id The device
+     */
+    using type_signal_notifications_added = sigc::signal<void, const std::string& /* device_id */>;
+    /**
+     * Emitted after a batch of notifications from a device has been written
+     */
+    type_signal_notifications_added signal_notifications_added () { return m_signal_notifications_added; }
+
+    NotificationHistory (const NotificationHistory&) = delete;
+    NotificationHistory& operator= (const NotificationHistory&) = delete;
+
+  protected:
+    // NotificationArchive overrides
+    void store_notifications_virt (const std::string&                                  device_id,
+                                   std::vector<Conecto::Plugins::NotificationInfo>&& notifications) override;
+
+  private:
+    /**
+     * @brief Queue the next compaction step (one chunk of rows per job, so other writes don't have to wait)
+     */
+    void schedule_compaction ();
+
+    std::unique_ptr<Utils::SqliteWorker> m_writer;
+    std::unique_ptr<Utils::SqliteWorker> m_reader;
+    sigc::connection                     m_compaction_connection;
+    bool                                 m_compacting;
+    // Retention limits (the maximum age in milliseconds)
+    int64_t m_max_age;
+    int     m_max_per_device;
+
+    type_signal_notifications_added m_signal_notifications_added;
+};
+
+} // namespace Models
+} // namespace App
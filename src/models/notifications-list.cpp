@@ -28,18 +28,21 @@ NotificationsList::NotificationsList (const std::shared_ptr<Conecto::Device>& de
     , m_plugin (std::dynamic_pointer_cast<Conecto::Plugins::Notifications> (
               Conecto::Backend::get_instance ().get_plugin ("kdeconnect.notification")))
 {
-    m_columns.add (column_app_name);
     m_columns.add (column_id);
-    m_columns.add (column_title);
-    m_columns.add (column_body);
-    m_columns.add (column_time);
     set_column_types (m_columns);
 
-    // Connect to signals
-    m_connections.push_back (m_plugin->signal_new_notification ().connect (
-            sigc::mem_fun (*this, &NotificationsList::on_new_notification)));
-    m_connections.push_back (m_plugin->signal_notification_dismissed ().connect (
-            sigc::mem_fun (*this, &NotificationsList::on_notification_dismissed)));
+    // Notifications received before the model has been created
+    auto&              store = m_plugin->get_store ();
+    const std::string& device_id = m_device->get_device_id ();
+    for (const auto* notification : store.get_notifications (device_id)) on_notification_added (notification->id);
+
+    // Connect to signals (only emitted for this device)
+    m_connections.push_back (store.signal_added (device_id).connect (
+            sigc::mem_fun (*this, &NotificationsList::on_notification_added)));
+    m_connections.push_back (store.signal_updated (device_id).connect (
+            sigc::mem_fun (*this, &NotificationsList::on_notification_updated)));
+    m_connections.push_back (store.signal_removed (device_id).connect (
+            sigc::mem_fun (*this, &NotificationsList::on_notification_removed)));
 }
 
 Glib::RefPtr<NotificationsList>
@@ -48,28 +51,45 @@ NotificationsList::create (const std::shared_ptr<Conecto::Device>& device)
     return Glib::RefPtr<NotificationsList> (new NotificationsList (device));
 }
 
+const Conecto::Plugins::NotificationInfo*
+NotificationsList::get_notification (const std::string& id) const
+{
+    return m_plugin->get_store ().find (m_device->get_device_id (), id);
+}
+
+Glib::RefPtr<Gdk::Pixbuf>
+NotificationsList::get_icon (const Conecto::Plugins::NotificationInfo& notification) const
+{
+    if (notification.icon.empty ()) return Glib::RefPtr<Gdk::Pixbuf> ();
+    return m_plugin->get_icon_cache ().get_pixbuf (notification.icon);
+}
+
 void
-NotificationsList::on_new_notification (const std::shared_ptr<Conecto::Device>&                  device,
-                                        const Conecto::Plugins::Notifications::NotificationInfo& notification)
+NotificationsList::on_notification_added (const std::string& id)
 {
-    if (device != m_device) return;
+    if (m_rows.count (id)) return;
 
     auto it = append ();
-    it->set_value (column_app_name, Glib::ustring (notification.app_name));
-    it->set_value (column_id, Glib::ustring (notification.id));
-    it->set_value (column_title, Glib::ustring (notification.title));
-    it->set_value (column_body, Glib::ustring (notification.body));
-    it->set_value (column_time, notification.time.format ("%X"));
+    m_rows.insert ({ id, it });
+    it->set_value (column_id, Glib::ustring (id));
 }
 
 void
-NotificationsList::on_notification_dismissed (const std::shared_ptr<Conecto::Device>& device, const std::string& id)
+NotificationsList::on_notification_updated (const std::string& id)
 {
-    if (device != m_device) return;
+    auto row = m_rows.find (id);
+    if (row == m_rows.end ()) return;
+    row_changed (get_path (row->second), row->second);
+}
 
-    for (auto& row : children ()) {
-        if (row.get_value (column_id) == id) { erase (row); }
-    }
+void
+NotificationsList::on_notification_removed (const std::string& id)
+{
+    auto row = m_rows.find (id);
+    if (row == m_rows.end ()) return;
+    Gtk::TreeIter it = row->second;
+    m_rows.erase (row);
+    erase (it);
 }
 
 void
@@ -77,4 +97,4 @@ NotificationsList::dismiss (const std::string& id)
 {
     // Send a dismiss request via the plugin
     m_plugin->dismiss (m_device, id);
-}
\ No newline at end of file
+}
@@ -22,12 +22,16 @@
 
 #include <gtkmm.h>
 #include <conecto.h>
+#include <unordered_map>
 
 namespace App {
 namespace Models {
 
 /**
  * @brief A model containing a list of notifications for a connected device
+ *
+ * Rows only contain the notification's id, the notification itself is read from the plugin's
+ * @p Conecto::Plugins::NotificationStore using @p get_notification.
  */
 class NotificationsList : public Gtk::ListStore {
   public:
@@ -40,16 +44,21 @@ class NotificationsList : public Gtk::ListStore {
         for (auto& conn : m_connections) conn.disconnect ();
     }
 
-    /** @brief The app's name */
-    Gtk::TreeModelColumn<Glib::ustring> column_app_name;
     /** @brief The notification's id */
     Gtk::TreeModelColumn<Glib::ustring> column_id;
-    /** @brief The title text */
-    Gtk::TreeModelColumn<Glib::ustring> column_title;
-    /** @brief The main text */
-    Gtk::TreeModelColumn<Glib::ustring> column_body;
-    /** @brief The time the notification was sent */
-    Gtk::TreeModelColumn<Glib::ustring> column_time;
+
+    /**
+     * @brief Get the notification with @p id
+     *
+     * @return nullptr if the notification has been removed
+     */
+    const Conecto::Plugins::NotificationInfo* get_notification (const std::string& id) const;
+    /**
+     * @brief Get the icon of a notification
+     *
+     * @return An empty pointer if the notification doesn't have an icon (yet)
+     */
+    Glib::RefPtr<Gdk::Pixbuf> get_icon (const Conecto::Plugins::NotificationInfo& notification) const;
 
     /** @brief Dismiss a notification, it will be immediately removed from this model */
     void dismiss (const std::string& id);
@@ -60,15 +69,17 @@ class NotificationsList : public Gtk::ListStore {
   private:
     NotificationsList (const std::shared_ptr<Conecto::Device>& device);
 
-    void on_new_notification (const std::shared_ptr<Conecto::Device>&                  device,
-                              const Conecto::Plugins::Notifications::NotificationInfo& notification);
-    void on_notification_dismissed (const std::shared_ptr<Conecto::Device>& device, const std::string& id);
+    void on_notification_added (const std::string& id);
+    void on_notification_updated (const std::string& id);
+    void on_notification_removed (const std::string& id);
 
     /** @brief The device used */
     std::shared_ptr<Conecto::Device>                 m_device;
     std::shared_ptr<Conecto::Plugins::Notifications> m_plugin;
     Gtk::TreeModel::ColumnRecord                     m_columns;
     std::list<sigc::connection>                      m_connections;
+    // Rows by notification id (iterators of list stores stay valid until the row is removed)
+    std::unordered_map<std::string, Gtk::TreeIter> m_rows;
 };
 
 } // namespace Models
@@ -20,189 +20,675 @@
 
 #include "sms-storage.h"
 #include <conecto.h>
+#include <algorithm>
 
 using namespace App::Models;
 
 namespace {
 
-struct QueryCbWrapper {
-    QueryCbWrapper (std::function<void(const std::vector<std::string>&, const std::vector<std::string>&)>&& cb)
-        : cb (std::move (cb)) {}
-    ~QueryCbWrapper () {}
-    std::function<void(const std::vector<std::string>&, const std::vector<std::string>&)> cb;
+enum MessageColumns : int { PHONE = 0, MESSAGE = 1, DATETIME = 2, SENDER = 3 };
+
+// Used by the conversation_insert trigger, true if the inserted message is the conversation's latest one
+#define NEW_IS_LATEST "(new.date_received, new.id) >= (last_timestamp, last_message_id)"
+
+// Schema migrations, MIGRATIONS[i] upgrades the database from version i to version i + 1 (stored as user_version)
+const char* const MIGRATIONS[] = {
+    // Version 1: Integer timestamps (milliseconds since the epoch) and an index matching the conversation queries.
+    // Databases created before versioning stored escaped strings and ISO 8601 timestamps.
+    "CREATE TABLE IF NOT EXISTS message("
+    "    id             INTEGER      PRIMARY KEY AUTOINCREMENT,"
+    "    phone_number   TEXT         NOT NULL,"
+    "    message        TEXT         NOT NULL,"
+    "    device_id      TEXT         NOT NULL,"
+    "    date_received  DATETIME     CURRENT_TIMESTAMP,"
+    "    sender         INTEGER      DEFAULT 1"
+    ");"
+    "CREATE TABLE message_v1("
+    "    id             INTEGER      PRIMARY KEY,"
+    "    phone_number   TEXT         NOT NULL,"
+    "    message        TEXT         NOT NULL,"
+    "    device_id      TEXT         NOT NULL,"
+    "    date_received  INTEGER      NOT NULL,"
+    "    sender         INTEGER      DEFAULT 1"
+    ");"
+    "INSERT INTO message_v1 (id, phone_number, message, device_id, date_received, sender)"
+    "    SELECT id, strcompress(phone_number), strcompress(message), strcompress(device_id),"
+    "           iso8601_to_ms(date_received), sender FROM message;"
+    "DROP TABLE message;"
+    "ALTER TABLE message_v1 RENAME TO message;"
+    "CREATE INDEX message_conversation ON message(device_id, phone_number, date_received);",
+    // Version 2: Message ids assigned by the phone, used for skipping duplicates when syncing the history
+    "ALTER TABLE message ADD COLUMN thread_id INTEGER;"
+    "ALTER TABLE message ADD COLUMN message_id INTEGER;"
+    "CREATE UNIQUE INDEX message_unique ON message(device_id, thread_id, message_id);",
+    // Version 3: Full-text index over the message texts, kept in sync by triggers. Messages which existed before are
+    // added to the index in the background (see fts_backfill).
+    "CREATE VIRTUAL TABLE message_fts USING fts5(message, content='message', content_rowid='id');"
+    "CREATE TRIGGER message_fts_insert AFTER INSERT ON message BEGIN"
+    "    INSERT INTO message_fts(rowid, message) VALUES (new.id, new.message);"
+    "END;"
+    "CREATE TRIGGER message_fts_delete AFTER DELETE ON message BEGIN"
+    "    INSERT INTO message_fts(message_fts, rowid, message) VALUES ('delete', old.id, old.message);"
+    "END;"
+    "CREATE TRIGGER message_fts_update AFTER UPDATE OF message ON message BEGIN"
+    "    INSERT INTO message_fts(message_fts, rowid, message) VALUES ('delete', old.id, old.message);"
+    "    INSERT INTO message_fts(rowid, message) VALUES (new.id, new.message);"
+    "END;"
+    "CREATE TABLE fts_backfill(next_id INTEGER NOT NULL, last_id INTEGER NOT NULL);"
+    "INSERT INTO fts_backfill SELECT 0, COALESCE(MAX(id), 0) FROM message WHERE EXISTS (SELECT 1 FROM message);",
+    // Version 4: Summary of every conversation, kept up to date by triggers. Existing messages are considered read.
+    "CREATE TABLE conversation("
+    "    device_id        TEXT     NOT NULL,"
+    "    phone_number     TEXT     NOT NULL,"
+    "    last_message     TEXT     NOT NULL,"
+    "    last_message_id  INTEGER  NOT NULL,"
+    "    last_timestamp   INTEGER  NOT NULL,"
+    "    unread_count     INTEGER  NOT NULL DEFAULT 0,"
+    "    message_count    INTEGER  NOT NULL DEFAULT 0,"
+    "    PRIMARY KEY (device_id, phone_number)"
+    ") WITHOUT ROWID;"
+    "CREATE INDEX conversation_recent ON conversation(device_id, last_timestamp);"
+    "INSERT INTO conversation (device_id, phone_number, last_message, last_message_id, last_timestamp, message_count)"
+    "    SELECT message.device_id, message.phone_number, message.message, message.id, message.date_received, c.n"
+    "    FROM ("
+    "        SELECT COUNT(*) AS n, ("
+    "            SELECT id FROM message AS latest"
+    "            WHERE latest.device_id = outer_message.device_id AND latest.phone_number = outer_message.phone_number"
+    "            ORDER BY date_received DESC, id DESC LIMIT 1"
+    "        ) AS last_id"
+    "        FROM message AS outer_message GROUP BY device_id, phone_number"
+    "    ) AS c JOIN message ON message.id = c.last_id;"
+    // UPSERT isn't available in sqlite < 3.24, so this is done using two statements
+    "CREATE TRIGGER conversation_insert AFTER INSERT ON message BEGIN"
+    "    INSERT OR IGNORE INTO conversation (device_id, phone_number, last_message, last_message_id, last_timestamp)"
+    "        VALUES (new.device_id, new.phone_number, new.message, new.id, new.date_received);"
+    "    UPDATE conversation SET"
+    "        message_count = message_count + 1,"
+    "        unread_count = unread_count + (new.sender = 1),"
+    "        last_message = CASE WHEN " NEW_IS_LATEST " THEN new.message ELSE last_message END,"
+    "        last_message_id = CASE WHEN " NEW_IS_LATEST " THEN new.id ELSE last_message_id END,"
+    "        last_timestamp = CASE WHEN " NEW_IS_LATEST " THEN new.date_received ELSE last_timestamp END"
+    "    WHERE device_id = new.device_id AND phone_number = new.phone_number;"
+    "END;"
+    "CREATE TRIGGER conversation_delete AFTER DELETE ON message BEGIN"
+    "    UPDATE conversation SET message_count = message_count - 1"
+    "        WHERE device_id = old.device_id AND phone_number = old.phone_number;"
+    "    DELETE FROM conversation"
+    "        WHERE device_id = old.device_id AND phone_number = old.phone_number AND message_count <= 0;"
+    "    UPDATE conversation SET (last_message, last_message_id, last_timestamp) = ("
+    "        SELECT message, id, date_received FROM message"
+    "        WHERE device_id = old.device_id AND phone_number = old.phone_number"
+    "        ORDER BY date_received DESC, id DESC LIMIT 1"
+    "    ) WHERE device_id = old.device_id AND phone_number = old.phone_number AND last_message_id = old.id;"
+    "END;",
+
+    // v5: Per-thread high-water marks for syncing with the phone
+    "CREATE TABLE sync_state ("
+    "    device_id TEXT NOT NULL,"
+    "    thread_id INTEGER NOT NULL,"
+    "    high_water_mark INTEGER NOT NULL,"
+    "    PRIMARY KEY (device_id, thread_id)"
+    ") WITHOUT ROWID;",
+
+    // v6: Only messages which haven't been read on the phone are counted as unread, so a synced history doesn't
+    // show up as unread. Existing counts included the synced history, they are reset.
+    "ALTER TABLE message ADD COLUMN unread INTEGER NOT NULL DEFAULT 0;"
+    "DROP TRIGGER conversation_insert;"
+    "CREATE TRIGGER conversation_insert AFTER INSERT ON message BEGIN"
+    "    INSERT OR IGNORE INTO conversation (device_id, phone_number, last_message, last_message_id, last_timestamp)"
+    "        VALUES (new.device_id, new.phone_number, new.message, new.id, new.date_received);"
+    "    UPDATE conversation SET"
+    "        message_count = message_count + 1,"
+    "        unread_count = unread_count + new.unread,"
+    "        last_message = CASE WHEN " NEW_IS_LATEST " THEN new.message ELSE last_message END,"
+    "        last_message_id = CASE WHEN " NEW_IS_LATEST " THEN new.id ELSE last_message_id END,"
+    "        last_timestamp = CASE WHEN " NEW_IS_LATEST " THEN new.date_received ELSE last_timestamp END"
+    "    WHERE device_id = new.device_id AND phone_number = new.phone_number;"
+    "END;"
+    "UPDATE conversation SET unread_count = 0;",
 };
 
-int static_query_cb (void* data, int n_columns, char** values, char** column_names) {
-    QueryCbWrapper* wrapper = static_cast<QueryCbWrapper*> (data);
+#undef NEW_IS_LATEST
 
-    std::vector<std::string> wrapper_values;
-    wrapper_values.reserve (n_columns);
-    std::vector<std::string> wrapper_column_names;
-    wrapper_column_names.reserve (n_columns);
+constexpr int SCHEMA_VERSION = sizeof (MIGRATIONS) / sizeof (MIGRATIONS[0]);
 
-    for (int i = 0; i < n_columns; i++) {
-        wrapper_values.emplace_back (values[i]);
-        wrapper_column_names.emplace_back (column_names[i]);
-    }
-    wrapper->cb (wrapper_values, wrapper_column_names);
-    return 0;
+// Negative values are KiB, see https://sqlite.org/pragma.html#pragma_cache_size
+constexpr char CONNECTION_SETUP[] = "PRAGMA journal_mode = WAL;"
+                                    "PRAGMA synchronous = NORMAL;"
+                                    "PRAGMA cache_size = -8192;"
+                                    "PRAGMA temp_store = MEMORY;";
+constexpr char READER_SETUP[] = "PRAGMA cache_size = -8192;"
+                                "PRAGMA temp_store = MEMORY;";
+// Number of read-only connections (in WAL mode, readers don't block the writer and vice versa)
+constexpr size_t N_READERS = 2;
+
+// Rows without a thread/message id are never considered duplicates (NULL values are distinct)
+constexpr char INSERT_MESSAGE[] = "INSERT OR IGNORE INTO message "
+                                  "(phone_number, message, device_id, date_received, sender, thread_id, message_id, "
+                                  "unread) VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8);";
+// Number of messages written per transaction when ingesting a batch
+constexpr size_t INGEST_CHUNK_SIZE = 1000;
+// Conditions are ordered like the columns of the message_conversation index
+constexpr char SELECT_LATEST_MESSAGES[] = "SELECT * FROM ("
+                                          "    SELECT phone_number, message, date_received, sender FROM message"
+                                          "    WHERE device_id = ?2 AND phone_number = ?1"
+                                          "    ORDER BY date_received DESC LIMIT 20"
+                                          ") ORDER BY date_received ASC;";
+constexpr char SELECT_MESSAGES_BEFORE[] = "SELECT phone_number, message, date_received, sender FROM message "
+                                          "WHERE device_id = ?2 AND phone_number = ?1 AND date_received < ?3 "
+                                          "ORDER BY date_received DESC LIMIT 10;";
+// Matches are enclosed by \x02 and \x03 in snippets and converted to markup afterwards
+constexpr char SEARCH_MESSAGES[] = "SELECT message.id, message.device_id, message.phone_number, message.date_received,"
+                                   "       snippet(message_fts, 0, '\x02', '\x03', '\xe2\x80\xa6', 12)"
+                                   "    FROM message_fts JOIN message ON message.id = message_fts.rowid"
+                                   "    WHERE message_fts MATCH ?1 ORDER BY rank LIMIT ?2 OFFSET ?3;";
+// Number of existing messages added to the full-text index per transaction
+constexpr int64_t FTS_BACKFILL_CHUNK_SIZE = 5000;
+constexpr char SELECT_FTS_BACKFILL[] = "SELECT next_id, last_id FROM fts_backfill;";
+constexpr char INSERT_FTS_BACKFILL_CHUNK[] = "INSERT INTO message_fts(rowid, message)"
+                                             "    SELECT id, message FROM message WHERE id > ?1 AND id <= ?2;";
+constexpr char UPDATE_FTS_BACKFILL[] = "UPDATE fts_backfill SET next_id = ?1;";
+constexpr char DELETE_FTS_BACKFILL[] = "DELETE FROM fts_backfill;";
+
+// Keyset pagination: (date_received, id) is unique and covered by message_conversation (which includes the rowid)
+constexpr char SELECT_PAGE_OLDER[] = "SELECT id, date_received, sender, message FROM message "
+                                     "WHERE device_id = ?1 AND phone_number = ?2 AND (date_received, id) < (?3, ?4) "
+                                     "ORDER BY date_received DESC, id DESC LIMIT ?5;";
+constexpr char SELECT_PAGE_NEWER[] = "SELECT id, date_received, sender, message FROM message "
+                                     "WHERE device_id = ?1 AND phone_number = ?2 AND (date_received, id) > (?3, ?4) "
+                                     "ORDER BY date_received ASC, id ASC LIMIT ?5;";
+constexpr char SELECT_CONVERSATIONS[] = "SELECT phone_number, last_message, last_timestamp, unread_count, message_count "
+                                       "FROM conversation WHERE device_id = ?1 ORDER BY last_timestamp DESC;";
+constexpr char MARK_CONVERSATION_READ[] = "UPDATE conversation SET unread_count = 0 "
+                                          "WHERE device_id = ?1 AND phone_number = ?2;";
+constexpr char SELECT_HIGH_WATER_MARKS[] = "SELECT thread_id, high_water_mark FROM sync_state WHERE device_id = ?1;";
+constexpr char SET_HIGH_WATER_MARK[] = "INSERT OR REPLACE INTO sync_state (device_id, thread_id, high_water_mark) "
+                                       "VALUES (?1, ?2, ?3);";
+
+int64_t
+to_epoch_ms (const Glib::DateTime& date_time)
+{
+    return date_time.to_unix () * 1000 + date_time.get_microsecond () / 1000;
 }
 
-enum MessageColumns : size_t {
-    ID = 0,
-    PHONE = 1,
-    MESSAGE = 2,
-    DEVICE_ID = 3,
-    DATETIME = 4,
-    SENDER = 5
-};
+Glib::DateTime
+from_epoch_ms (int64_t ms)
+{
+    return Glib::DateTime::create_now_local (ms / 1000).add_seconds ((ms % 1000) / 1000.0);
+}
 
-} // namespace
+/**
+ * SQL function iso8601_to_ms(text) used for migrating old timestamps
+ */
+void
+iso8601_to_ms (sqlite3_context* ctx, int argc, sqlite3_value** argv)
+{
+    (void) argc;
+    const char* text = reinterpret_cast<const char*> (sqlite3_value_text (argv[0]));
+    GDateTime*  datetime = text ? g_date_time_new_from_iso8601 (text, nullptr) : nullptr;
+    if (!datetime) {
+        sqlite3_result_int64 (ctx, 0);
+        return;
+    }
+    sqlite3_result_int64 (ctx, to_epoch_ms (Glib::wrap (datetime)));
+}
 
-SMSStorage::SMSStorage ()
+/**
+ * SQL function strcompress(text) used for migrating strings that were stored using Glib::strescape
+ */
+void
+strcompress (sqlite3_context* ctx, int argc, sqlite3_value** argv)
+{
+    (void) argc;
+    const char* text = reinterpret_cast<const char*> (sqlite3_value_text (argv[0]));
+    if (!text) {
+        sqlite3_result_null (ctx);
+        return;
+    }
+    std::string res = Glib::strcompress (text);
+    sqlite3_result_text (ctx, res.data (), static_cast<int> (res.size ()), SQLITE_TRANSIENT);
+}
+
+void
+migrate (App::Utils::SqliteConnection& conn)
 {
+    int version = 0;
     {
-        std::string path = Glib::build_filename (Conecto::Backend::get_instance ().get_config_dir (), "sms-storage.db");
-        sqlite3* conn_raw = nullptr;
-        int err = sqlite3_open (path.c_str (), &conn_raw);
-        m_conn = std::shared_ptr<sqlite3> (conn_raw, sqlite3_close);
-        if (err != SQLITE_OK)
-            throw "Can't open SMS history database";
+        App::Utils::SqliteStatement stmt (conn.get_handle (), "PRAGMA user_version;");
+        if (stmt.step ()) version = stmt.get_int (0);
+    }
+    if (version > SCHEMA_VERSION) throw "The SMS history database was created by a newer version";
+    if (version == SCHEMA_VERSION) return;
+
+    sqlite3_create_function (conn.get_handle (), "iso8601_to_ms", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
+                             iso8601_to_ms, nullptr, nullptr);
+    sqlite3_create_function (conn.get_handle (), "strcompress", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
+                             strcompress, nullptr, nullptr);
+
+    for (; version < SCHEMA_VERSION; version++) {
+        g_info ("Upgrading SMS history database to version %d", version + 1);
+        std::string query = std::string ("BEGIN;") + MIGRATIONS[version] +
+                            "PRAGMA user_version = " + std::to_string (version + 1) + ";COMMIT;";
+        if (!conn.exec (query)) {
+            conn.exec ("ROLLBACK;");
+            throw "An error occured while trying to set up the database structure";
+        }
     }
-    // Initial setup
-    const static std::string query =
-            "CREATE TABLE IF NOT EXISTS message("
-            "    id             INTEGER      PRIMARY KEY AUTOINCREMENT,"
-            "    phone_number   TEXT         NOT NULL,"
-            "    message        TEXT         NOT NULL,"
-            "    device_id      TEXT         NOT NULL,"
-            "    date_received  DATETIME     CURRENT_TIMESTAMP,"
-            "    sender         INTEGER      DEFAULT 1"
-            ");";
-    if (!exec_query (query))
-        throw "An error occured while trying to set up the database structure";
-
-    // Fetch contacts
-    fetch_available_contacts ();
 }
 
-SMSStorage::~SMSStorage ()
+bool
+insert_message (App::Utils::SqliteConnection& conn, const std::string& device_id, const std::string& phone_number,
+                const std::string& message, int64_t date, SMSStorage::SMS::FromType from, int64_t thread_id,
+                int64_t message_id, bool unread)
 {
+    auto& stmt = conn.get_statement (INSERT_MESSAGE)
+                         .bind (1, phone_number)
+                         .bind (2, message)
+                         .bind (3, device_id)
+                         .bind (4, date)
+                         .bind (5, static_cast<int> (from))
+                         .bind (8, static_cast<int> (unread));
+    if (thread_id >= 0) stmt.bind (6, thread_id);
+    if (message_id >= 0) stmt.bind (7, message_id);
+    return stmt.execute () && sqlite3_changes (conn.get_handle ()) > 0;
 }
 
 bool
-SMSStorage::exec_query (const std::string& query, std::function<void(const std::vector<std::string>&, const std::vector<std::string>&)>&& cb)
+insert_sms (App::Utils::SqliteConnection& conn, const std::string& device_id, const SMSStorage::SMS& sms)
+{
+    return insert_message (conn, device_id, sms.phone_number, sms.message, to_epoch_ms (sms.date_time), sms.from,
+                           sms.thread_id, sms.message_id, sms.from == SMSStorage::SMS::FROM_CONTACT);
+}
+
+bool
+insert_sms (App::Utils::SqliteConnection& conn, const std::string& device_id,
+            const Conecto::Plugins::SMSMessage& sms)
+{
+    return insert_message (conn, device_id, sms.address, sms.body, sms.date,
+                           sms.received ? SMSStorage::SMS::FROM_CONTACT : SMSStorage::SMS::FROM_ME, sms.thread_id,
+                           sms.message_id, sms.received && !sms.read);
+}
+
+template <class Message>
+SMSStorage::IngestResult
+ingest (App::Utils::SqliteConnection& conn, const std::string& device_id, const std::vector<Message>& messages)
 {
-    auto data = std::make_unique<QueryCbWrapper> (std::move (cb));
-    int err = sqlite3_exec (m_conn.get (), query.c_str (), static_query_cb, data.get (), nullptr);
-    if (err != SQLITE_OK) {
-        g_warning ("Error while executing sqlite query: %s", query.c_str ());
+    SMSStorage::IngestResult res = { 0, 0, 0.0 };
+    int64_t                  start = g_get_monotonic_time ();
+
+    for (size_t chunk_start = 0; chunk_start < messages.size (); chunk_start += INGEST_CHUNK_SIZE) {
+        size_t chunk_end = std::min (chunk_start + INGEST_CHUNK_SIZE, messages.size ());
+        if (!conn.get_statement ("BEGIN;").execute ()) break;
+
+        size_t inserted = 0;
+        for (size_t i = chunk_start; i < chunk_end; i++)
+            if (insert_sms (conn, device_id, messages[i])) inserted++;
+
+        if (!conn.get_statement ("COMMIT;").execute ()) {
+            conn.get_statement ("ROLLBACK;").execute ();
+            break;
+        }
+        res.n_inserted += inserted;
+        res.n_skipped += (chunk_end - chunk_start) - inserted;
+    }
+
+    res.seconds = (g_get_monotonic_time () - start) / 1000000.0;
+    g_info ("Ingested %zu SMS messages (%zu skipped) in %.3fs (%.0f messages/s)", res.n_inserted, res.n_skipped,
+            res.seconds, res.seconds > 0 ? (res.n_inserted + res.n_skipped) / res.seconds : 0.0);
+    return res;
+}
+
+/**
+ * Turn user input into an FTS5 query matching all words (as prefixes), without interpreting any query syntax
+ */
+std::string
+to_fts_query (const std::string& text)
+{
+    std::string res;
+    std::string word;
+    auto        flush_word = [&res, &word] () {
+        if (word.empty ()) return;
+        if (!res.empty ()) res += ' ';
+        res += '"' + word + "\"*";
+        word.clear ();
+    };
+    for (char c : text) {
+        if (g_ascii_isspace (c))
+            flush_word ();
+        else if (c == '"')
+            word += "\"\"";
+        else
+            word += c;
+    }
+    flush_word ();
+    return res;
+}
+
+/**
+ * Convert a snippet returned by SEARCH_MESSAGES to Pango markup
+ */
+std::string
+snippet_to_markup (const std::string& snippet)
+{
+    std::string res;
+    size_t      start = 0;
+    while (start < snippet.size ()) {
+        size_t end = snippet.find_first_of ("\x02\x03", start);
+        res += Glib::Markup::escape_text (snippet.substr (start, end - start)).raw ();
+        if (end == std::string::npos) break;
+        res += snippet[end] == '\x02' ? "<b>" : "</b>";
+        start = end + 1;
+    }
+    return res;
+}
+
+/**
+ * Add a chunk of messages which existed before the full-text index was created to the index
+ *
+ * @return true if there are more messages to be indexed
+ */
+bool
+backfill_fts (App::Utils::SqliteConnection& conn)
+{
+    auto& select = conn.get_statement (SELECT_FTS_BACKFILL);
+    if (!select.step ()) return false;
+    int64_t next_id = select.get_int64 (0);
+    int64_t last_id = select.get_int64 (1);
+    select.reset ();
+
+    int64_t chunk_end = std::min (next_id + FTS_BACKFILL_CHUNK_SIZE, last_id);
+    if (!conn.get_statement ("BEGIN;").execute ()) return false;
+
+    bool success = conn.get_statement (INSERT_FTS_BACKFILL_CHUNK).bind (1, next_id).bind (2, chunk_end).execute ();
+    if (chunk_end < last_id)
+        success = success && conn.get_statement (UPDATE_FTS_BACKFILL).bind (1, chunk_end).execute ();
+    else
+        success = success && conn.get_statement (DELETE_FTS_BACKFILL).execute ();
+    if (!success || !conn.get_statement ("COMMIT;").execute ()) {
+        conn.get_statement ("ROLLBACK;").execute ();
         return false;
     }
-    return true;
+    g_debug ("Indexed SMS messages up to %" G_GINT64_FORMAT " of %" G_GINT64_FORMAT, chunk_end, last_id);
+    return chunk_end < last_id;
+}
+
+std::list<SMSStorage::SMS>
+read_messages (App::Utils::SqliteStatement& stmt)
+{
+    std::list<SMSStorage::SMS> res;
+    while (stmt.step ()) {
+        res.emplace_back (stmt.get_string (MessageColumns::MESSAGE), stmt.get_string (MessageColumns::PHONE),
+                          static_cast<SMSStorage::SMS::FromType> (stmt.get_int (MessageColumns::SENDER)),
+                          from_epoch_ms (stmt.get_int64 (MessageColumns::DATETIME)));
+    }
+    return res;
+}
+
+} // namespace
+
+SMSStorage::SMSStorage ()
+    : SMSStorage (Glib::build_filename (Conecto::Backend::get_instance ().get_config_dir (), "sms-storage.db"),
+                  Glib::build_filename (Conecto::Backend::get_cache_dir (), "contacts.cache"))
+{
+    // libfolks is prepared in the background
+    fetch_available_contacts ();
+}
+
+SMSStorage::SMSStorage (const std::string& path, const std::string& contacts_snapshot_path)
+    : m_contacts_snapshot_path (contacts_snapshot_path)
+    , m_reconciled (false)
+    , m_snapshot_dirty (false)
+{
+
+    std::vector<std::unique_ptr<Utils::SqliteConnection>> writers;
+    writers.push_back (std::make_unique<Utils::SqliteConnection> (path));
+    if (!writers.front ()->exec (CONNECTION_SETUP)) g_warning ("Failed to configure the SMS history database");
+    // The schema needs to be up to date before any reader is opened
+    migrate (*writers.front ());
+
+    std::vector<std::unique_ptr<Utils::SqliteConnection>> readers;
+    for (size_t i = 0; i < N_READERS; i++) {
+        readers.push_back (std::make_unique<Utils::SqliteConnection> (path, SQLITE_OPEN_READONLY));
+        readers.back ()->exec (READER_SETUP);
+    }
+
+    m_writer = std::make_unique<Utils::SqliteWorker> (std::move (writers));
+    m_readers = std::make_unique<Utils::SqliteWorker> (std::move (readers));
+
+    // Index messages which were stored before full-text search was available
+    schedule_fts_backfill ();
+
+    // Show the contacts known from the last run immediately
+    load_contacts_snapshot ();
+}
+
+SMSStorage::~SMSStorage ()
+{
+    // Finish pending writes before the contacts (used by completion callbacks) are destroyed
+    m_readers.reset ();
+    m_writer.reset ();
+
+    m_snapshot_save_connection.disconnect ();
+    if (m_snapshot_dirty) save_contacts_snapshot ();
+
+    if (m_aggregator) {
+        g_signal_handlers_disconnect_by_data (m_aggregator.get (), this);
+        GeeMap* individuals = folks_individual_aggregator_get_individuals (m_aggregator.get ());
+        std::shared_ptr<GeeCollection> values (gee_map_get_values (individuals), g_object_unref);
+        std::shared_ptr<GeeIterator> it (gee_iterable_iterator (GEE_ITERABLE (values.get ())), g_object_unref);
+        while (gee_iterator_next (it.get ())) {
+            std::shared_ptr<FolksIndividual> individual (
+                static_cast<FolksIndividual*> (gee_iterator_get (it.get ())), g_object_unref);
+            g_signal_handlers_disconnect_by_data (individual.get (), this);
+        }
+    }
+}
+
+void
+SMSStorage::schedule_fts_backfill ()
+{
+    // One chunk per job, so other writes don't have to wait for the whole index to be built
+    m_writer->submit ([] (Utils::SqliteConnection& conn) { return backfill_fts (conn); },
+                      [this] (bool more) {
+                          if (more) schedule_fts_backfill ();
+                      });
+}
+
+void
+SMSStorage::search_messages (const std::string& text, size_t offset, size_t limit,
+                             const std::function<void (std::vector<SearchHit>)>& done)
+{
+    std::string query = to_fts_query (text);
+    m_readers->submit (
+            [query, offset, limit] (Utils::SqliteConnection& conn) {
+                std::vector<SearchHit> res;
+                if (query.empty ()) return res;
+
+                auto& stmt = conn.get_statement (SEARCH_MESSAGES)
+                                     .bind (1, query)
+                                     .bind (2, static_cast<int64_t> (limit))
+                                     .bind (3, static_cast<int64_t> (offset));
+                res.reserve (limit);
+                while (stmt.step ())
+                    res.push_back ({ stmt.get_int64 (0), stmt.get_string (1), stmt.get_string (2),
+                                     from_epoch_ms (stmt.get_int64 (3)), snippet_to_markup (stmt.get_string (4)) });
+                return res;
+            },
+            done);
 }
 
 void
 SMSStorage::add_sms (const Conecto::Device& device, const SMS& sms)
 {
     g_debug ("Adding SMS in DB");
-    std::stringstream query_stream;
-    query_stream << "INSERT INTO message (phone_number, message, device_id, date_received, sender) "
-        << "VALUES ('" << Glib::strescape (sms.phone_number) << "', '" << Glib::strescape (sms.message)
-        << "', '" << Glib::strescape (device.get_device_id ()) << "', '" << sms.date_time.format ("%FT%H:%M:%S%z")
-        << "', '" << sms.from << "');";
-    exec_query (query_stream.str ());
+    std::string device_id = device.get_device_id ();
+    m_writer->submit ([device_id, sms] (Utils::SqliteConnection& conn) { insert_sms (conn, device_id, sms); });
 }
 
-std::list<SMSStorage::SMS>
-SMSStorage::get_latest_sms_messages (const Conecto::Device& device, const std::string& phone_number)
-{
-    std::list<SMS> res;
-    std::stringstream query_stream;
-    query_stream << "SELECT * FROM (SELECT * FROM message WHERE phone_number = '" << Glib::strescape (phone_number)
-        << "' AND device_id = '" + Glib::strescape (device.get_device_id ()) << "' ORDER BY date_received DESC LIMIT 20) "
-        << "ORDER BY date_received ASC;";
-    exec_query (query_stream.str (), [&res] (const std::vector<std::string>& vals, const std::vector<std::string>& cols) {
-        GDateTime* datetime = g_date_time_new_from_iso8601 (vals.at (MessageColumns::DATETIME).c_str (), nullptr);
-        res.emplace_back (vals.at (MessageColumns::MESSAGE), vals.at (MessageColumns::PHONE),
-                          static_cast<SMS::FromType> (atoi (vals.at (MessageColumns::SENDER).c_str ())),
-                          Glib::wrap (datetime));
-    });
-    return res;
+void
+SMSStorage::add_sms_messages (const Conecto::Device& device, std::vector<SMS>&& messages,
+                              const std::function<void (IngestResult)>& done)
+{
+    std::string device_id = device.get_device_id ();
+    auto        shared_messages = std::make_shared<std::vector<SMS>> (std::move (messages));
+    m_writer->submit (
+            [device_id, shared_messages] (Utils::SqliteConnection& conn) {
+                return ingest (conn, device_id, *shared_messages);
+            },
+            [done] (IngestResult res) {
+                if (done) done (res);
+            });
 }
 
-std::list<SMSStorage::SMS>
-SMSStorage::get_sms_messages_before (const Conecto::Device& device, const std::string& phone_number,
-                                     const Glib::DateTime& datetime)
-{
-    std::list<SMS> res;
-    std::stringstream query_stream;
-    query_stream << "SELECT * FROM message WHERE phone_number = '" << Glib::strescape (phone_number)
-        << "' AND device_id = '" + Glib::strescape (device.get_device_id ()) << "' AND date_received < '"
-        << datetime.format ("%FT%H:%M:%S%z") << "' ORDER BY date_received DESC LIMIT 10;";
-    exec_query (query_stream.str (), [&res] (const std::vector<std::string>& vals, const std::vector<std::string>& cols) {
-        GDateTime* datetime = g_date_time_new_from_iso8601 (vals.at (MessageColumns::DATETIME).c_str (), nullptr);
-        res.emplace_back (vals.at (MessageColumns::MESSAGE), vals.at (MessageColumns::PHONE),
-                          static_cast<SMS::FromType> (atoi (vals.at (MessageColumns::SENDER).c_str ())),
-                          Glib::wrap (datetime));
-    });
-    return res;
+void
+SMSStorage::get_latest_sms_messages (const Conecto::Device& device, const std::string& phone_number,
+                                     const SlotMessages& done)
+{
+    std::string device_id = device.get_device_id ();
+    m_readers->submit (
+            [device_id, phone_number] (Utils::SqliteConnection& conn) {
+                return read_messages (
+                        conn.get_statement (SELECT_LATEST_MESSAGES).bind (1, phone_number).bind (2, device_id));
+            },
+            done);
 }
 
-std::list<std::string>
-SMSStorage::get_phone_numbers (const Conecto::Device& device)
+void
+SMSStorage::get_sms_messages_before (const Conecto::Device& device, const std::string& phone_number,
+                                     const Glib::DateTime& datetime, const SlotMessages& done)
 {
-    std::list<std::string> res;
-    std::stringstream query_stream;
-    query_stream << "SELECT DISTINCT phone_number FROM message WHERE device_id = '"
-        << Glib::strescape (device.get_device_id ()) << "';";
-    exec_query (query_stream.str (), [&res] (const std::vector<std::string>& vals, const std::vector<std::string>& cols) {
-        res.emplace_back (vals.at (0));
-    });
-    return res;
+    std::string device_id = device.get_device_id ();
+    int64_t     before = to_epoch_ms (datetime);
+    m_readers->submit (
+            [device_id, phone_number, before] (Utils::SqliteConnection& conn) {
+                return read_messages (conn.get_statement (SELECT_MESSAGES_BEFORE)
+                                              .bind (1, phone_number)
+                                              .bind (2, device_id)
+                                              .bind (3, before));
+            },
+            done);
 }
 
 void
 SMSStorage::fetch_available_contacts ()
 {
-    m_available_contacts.clear ();
-    m_phone_numbers_map.clear ();
     m_aggregator.reset (folks_individual_aggregator_dup (), g_object_unref);
-    GeeMap* individuals = folks_individual_aggregator_get_individuals (m_aggregator.get ());
 
+    // The aggregator is shared, it only has individuals already if it has been prepared before
+    GeeMap* individuals = folks_individual_aggregator_get_individuals (m_aggregator.get ());
     std::shared_ptr<GeeCollection> values (gee_map_get_values (individuals), g_object_unref);
-    m_available_contacts.reserve (gee_collection_get_size (values.get ()));
     std::shared_ptr<GeeIterator> it (gee_iterable_iterator (GEE_ITERABLE (values.get ())), g_object_unref);
-    int i = 0;
+    bool changed = false;
     while (gee_iterator_next (it.get ())) {
         std::shared_ptr<FolksIndividual> individual (
             static_cast<FolksIndividual*> (gee_iterator_get (it.get ())), g_object_unref);
-        std::vector<std::string> phone_numbers;
-        GeeCollection* gee_phone_numbers = GEE_COLLECTION (
-            folks_phone_details_get_phone_numbers ((FolksPhoneDetails*) individual.get ()));
-        if (gee_collection_get_size (gee_phone_numbers) < 1) continue;
-        phone_numbers.reserve (gee_collection_get_size (gee_phone_numbers));
-        std::shared_ptr<GeeIterator> phone_number_it (gee_iterable_iterator (GEE_ITERABLE (gee_phone_numbers)),
-                                                      g_object_unref);
-        while (gee_iterator_next (phone_number_it.get ())) {
-            std::shared_ptr<FolksAbstractFieldDetails> phone_number_field (
-                static_cast<FolksAbstractFieldDetails*> (gee_iterator_get (phone_number_it.get ())), g_object_unref);
-            const gchar* phone_number = static_cast<const gchar*> (
-                folks_abstract_field_details_get_value (phone_number_field.get ()));
-            phone_numbers.emplace_back (phone_number);
-            m_phone_numbers_map.insert ({ phone_number, i });
-        }
-        i++;
-        m_available_contacts.emplace_back (folks_individual_get_display_name (individual.get ()),
-                                           std::move (phone_numbers));
+        changed = track_individual (individual.get ()) || changed;
     }
+    if (changed) on_contacts_changed ();
 
-    // Connect to changes
+    // Individuals are reported through individuals-changed while the aggregator is being prepared
     g_signal_connect (m_aggregator.get (), "individuals-changed-detailed", G_CALLBACK (on_individuals_changed), this);
+    g_signal_connect (m_aggregator.get (), "notify::is-quiescent", G_CALLBACK (on_aggregator_quiescent), this);
 
     folks_individual_aggregator_prepare (m_aggregator.get (), (GAsyncReadyCallback) on_prepare_cb, this);
 }
 
+void
+SMSStorage::load_contacts_snapshot ()
+{
+    Glib::KeyFile keyfile;
+    try {
+        keyfile.load_from_file (m_contacts_snapshot_path);
+        m_contacts.load_from_cache (keyfile);
+        g_debug ("Loaded %zu contacts from the snapshot", m_contacts.size ());
+    } catch (Glib::Error& err) {
+        g_debug ("Couldn't load contacts snapshot: %s", err.what ().c_str ());
+    }
+}
+
+void
+SMSStorage::save_contacts_snapshot ()
+{
+    Glib::KeyFile keyfile;
+    m_contacts.to_cache (keyfile);
+    try {
+        g_mkdir_with_parents (Glib::path_get_dirname (m_contacts_snapshot_path).c_str (), 0700);
+        Glib::file_set_contents (m_contacts_snapshot_path, keyfile.to_data ());
+        m_snapshot_dirty = false;
+    } catch (Glib::FileError& err) {
+        g_warning ("Failed to save contacts snapshot: %s", err.what ().c_str ());
+    }
+}
+
+void
+SMSStorage::on_contacts_changed ()
+{
+    m_snapshot_dirty = true;
+    // Changes often come in bursts, the snapshot is written once they have settled
+    if (m_reconciled && !m_snapshot_save_connection.connected ())
+        m_snapshot_save_connection = Glib::signal_timeout ().connect_seconds (
+                [this] () {
+                    save_contacts_snapshot ();
+                    return false;
+                },
+                5);
+    m_signal_available_contacts_changed.emit ();
+}
+
+void
+SMSStorage::finish_reconciliation ()
+{
+    if (m_reconciled) return;
+    m_reconciled = true;
+
+    // Contacts from the snapshot which libfolks didn't report don't exist anymore
+    bool changed = m_contacts.retain (m_seen_individuals);
+    m_seen_individuals.clear ();
+    if (changed) on_contacts_changed ();
+    if (m_snapshot_dirty) save_contacts_snapshot ();
+}
+
+bool
+SMSStorage::track_individual (FolksIndividual* individual)
+{
+    // Changes of a contact's details are only notified on the individual itself
+    g_signal_handlers_disconnect_by_data (individual, this);
+    g_signal_connect (individual, "notify::phone-numbers", G_CALLBACK (on_individual_notify), this);
+    g_signal_connect (individual, "notify::display-name", G_CALLBACK (on_individual_notify), this);
+    if (!m_reconciled) m_seen_individuals.insert (folks_individual_get_id (individual));
+    return update_individual (individual);
+}
+
+bool
+SMSStorage::untrack_individual (FolksIndividual* individual)
+{
+    g_signal_handlers_disconnect_by_data (individual, this);
+    if (!m_reconciled) m_seen_individuals.erase (folks_individual_get_id (individual));
+    return m_contacts.remove (folks_individual_get_id (individual));
+}
+
+bool
+SMSStorage::update_individual (FolksIndividual* individual)
+{
+    std::string              id = folks_individual_get_id (individual);
+    std::vector<std::string> phone_numbers;
+    GeeCollection*           gee_phone_numbers =
+            GEE_COLLECTION (folks_phone_details_get_phone_numbers ((FolksPhoneDetails*) individual));
+    // Contacts without phone numbers aren't relevant
+    if (gee_collection_get_size (gee_phone_numbers) < 1) return m_contacts.remove (id);
+
+    phone_numbers.reserve (gee_collection_get_size (gee_phone_numbers));
+    std::shared_ptr<GeeIterator> phone_number_it (gee_iterable_iterator (GEE_ITERABLE (gee_phone_numbers)),
+                                                  g_object_unref);
+    while (gee_iterator_next (phone_number_it.get ())) {
+        std::shared_ptr<FolksAbstractFieldDetails> phone_number_field (
+            static_cast<FolksAbstractFieldDetails*> (gee_iterator_get (phone_number_it.get ())), g_object_unref);
+        phone_numbers.emplace_back (
+            static_cast<const gchar*> (folks_abstract_field_details_get_value (phone_number_field.get ())));
+    }
+    return m_contacts.set (id, folks_individual_get_display_name (individual), std::move (phone_numbers));
+}
+
 void
 SMSStorage::on_prepare_cb (GObject* source_object, GAsyncResult* res, SMSStorage* self)
 {
@@ -211,59 +697,184 @@ SMSStorage::on_prepare_cb (GObject* source_object, GAsyncResult* res, SMSStorage
     if (err) {
         g_critical ("Could not prepare Folks.IndividualAggregator (%s)", err->message);
         g_error_free (err);
+        // Keep the snapshot as it is
+        self->m_reconciled = true;
+        self->m_seen_individuals.clear ();
+        return;
     }
+    if (folks_individual_aggregator_get_is_quiescent (self->m_aggregator.get ())) self->finish_reconciliation ();
+}
+
+void
+SMSStorage::on_aggregator_quiescent (FolksIndividualAggregator* aggregator, GParamSpec* pspec, SMSStorage* self)
+{
+    (void) pspec;
+    if (folks_individual_aggregator_get_is_quiescent (aggregator)) self->finish_reconciliation ();
 }
 
 void
 SMSStorage::on_individuals_changed (FolksIndividualAggregator* _sender, GeeMultiMap* changes, SMSStorage* self)
 {
     (void) _sender;
-    std::shared_ptr<GeeCollection> values (gee_multi_map_get (changes, nullptr), g_object_unref);
-    std::shared_ptr<GeeIterator> it (gee_iterable_iterator (GEE_ITERABLE (values.get ())), g_object_unref);
-    int i = self->m_available_contacts.size ();
-    while (gee_iterator_next (it.get ())) {
+    bool changed = false;
+
+    // Keys are removed (or replaced) individuals, values are the individuals replacing them (both may be null)
+    std::shared_ptr<GeeSet> removed (gee_multi_map_get_keys (changes), g_object_unref);
+    std::shared_ptr<GeeIterator> removed_it (gee_iterable_iterator (GEE_ITERABLE (removed.get ())), g_object_unref);
+    while (gee_iterator_next (removed_it.get ())) {
         std::shared_ptr<FolksIndividual> individual (
-            static_cast<FolksIndividual*> (gee_iterator_get (it.get ())), g_object_unref);
-        std::vector<std::string> phone_numbers;
-        GeeCollection* gee_phone_numbers = GEE_COLLECTION (
-            folks_phone_details_get_phone_numbers ((FolksPhoneDetails*) individual.get ()));
-        if (gee_collection_get_size (gee_phone_numbers) < 1) continue;
-        phone_numbers.reserve (gee_collection_get_size (gee_phone_numbers));
-        std::shared_ptr<GeeIterator> phone_number_it (gee_iterable_iterator (GEE_ITERABLE (gee_phone_numbers)),
-                                                      g_object_unref);
-        while (gee_iterator_next (phone_number_it.get ())) {
-            std::shared_ptr<FolksAbstractFieldDetails> phone_number_field (
-                static_cast<FolksAbstractFieldDetails*> (gee_iterator_get (phone_number_it.get ())), g_object_unref);
-            const gchar* phone_number = static_cast<const gchar*> (
-                folks_abstract_field_details_get_value (phone_number_field.get ()));
-            phone_numbers.emplace_back (phone_number);
-            self->m_phone_numbers_map.insert ({ phone_number, i });
-        }
-        i++;
-        self->m_available_contacts.emplace_back (folks_individual_get_display_name (individual.get ()),
-                                                 std::move (phone_numbers));
+            static_cast<FolksIndividual*> (gee_iterator_get (removed_it.get ())),
+            [] (FolksIndividual* individual) { if (individual) g_object_unref (individual); });
+        if (individual) changed = self->untrack_individual (individual.get ()) || changed;
+    }
+
+    std::shared_ptr<GeeCollection> added (gee_multi_map_get_values (changes), g_object_unref);
+    std::shared_ptr<GeeIterator> added_it (gee_iterable_iterator (GEE_ITERABLE (added.get ())), g_object_unref);
+    while (gee_iterator_next (added_it.get ())) {
+        std::shared_ptr<FolksIndividual> individual (
+            static_cast<FolksIndividual*> (gee_iterator_get (added_it.get ())),
+            [] (FolksIndividual* individual) { if (individual) g_object_unref (individual); });
+        if (individual) changed = self->track_individual (individual.get ()) || changed;
     }
-    self->m_signal_available_contacts_changed.emit ();
+
+    if (changed) self->on_contacts_changed ();
+}
+
+void
+SMSStorage::on_individual_notify (FolksIndividual* individual, GParamSpec* pspec, SMSStorage* self)
+{
+    (void) pspec;
+    if (self->update_individual (individual)) self->on_contacts_changed ();
 }
 
-std::vector<SMSStorage::Contact>
-SMSStorage::get_conversation_contacts (const Conecto::Device& device)
+void
+SMSStorage::read_conversation_page (const Conecto::Device& device, const std::string& phone_number,
+                                    const PageKey& from, PageDirection direction, size_t page_size,
+                                    const std::shared_ptr<std::vector<MessageRow>>& buffer, const SlotPage& done,
+                                    const Utils::SqliteWorker::SlotFailed& failed)
+{
+    std::string device_id = device.get_device_id ();
+    auto        rows = buffer ? buffer : std::make_shared<std::vector<MessageRow>> ();
+    m_readers->submit (
+            [device_id, phone_number, from, direction, page_size, rows] (Utils::SqliteConnection& conn) {
+                auto& stmt = conn.get_statement (direction == PageDirection::OLDER ? SELECT_PAGE_OLDER
+                                                                                   : SELECT_PAGE_NEWER)
+                                     .bind (1, device_id)
+                                     .bind (2, phone_number)
+                                     .bind (3, from.timestamp)
+                                     .bind (4, from.id)
+                                     .bind (5, static_cast<int64_t> (page_size));
+
+                // Rows (and their strings) from previous pages are overwritten, so the buffer only grows once
+                size_t n_rows = 0;
+                while (stmt.step ()) {
+                    if (n_rows == rows->size ()) rows->emplace_back ();
+                    MessageRow& row = (*rows)[n_rows++];
+                    row.id = stmt.get_int64 (0);
+                    row.timestamp = stmt.get_int64 (1);
+                    row.from = static_cast<SMS::FromType> (stmt.get_int (2));
+                    stmt.get_string (3, row.message);
+                }
+                return std::make_pair (rows, n_rows);
+            },
+            [done] (std::pair<std::shared_ptr<std::vector<MessageRow>>, size_t> res) { done (res.first, res.second); },
+            failed);
+}
+
+void
+SMSStorage::get_conversations (const Conecto::Device&                                device,
+                               const std::function<void (std::vector<Conversation>)>& done)
 {
-    auto phone_numbers = get_phone_numbers (device);
-    std::vector<Contact> res;
-    res.reserve (phone_numbers.size ());
-    for (const auto& phone_number : phone_numbers) {
-        if (m_phone_numbers_map.find (phone_number) != m_phone_numbers_map.end ()) {
-            res.push_back (m_available_contacts.at (m_phone_numbers_map.at (phone_number)));
-            continue;
+    std::string device_id = device.get_device_id ();
+    m_readers->submit (
+            [device_id] (Utils::SqliteConnection& conn) {
+                std::vector<Conversation> res;
+                auto&                     stmt = conn.get_statement (SELECT_CONVERSATIONS).bind (1, device_id);
+                while (stmt.step ())
+                    res.push_back ({ stmt.get_string (0), stmt.get_string (1), stmt.get_int64 (2), stmt.get_int (3),
+                                     stmt.get_int (4) });
+                return res;
+            },
+            done);
+}
+
+void
+SMSStorage::mark_conversation_read (const Conecto::Device& device, const std::string& phone_number)
+{
+    std::string device_id = device.get_device_id ();
+    m_writer->submit ([device_id, phone_number] (Utils::SqliteConnection& conn) {
+        conn.get_statement (MARK_CONVERSATION_READ).bind (1, device_id).bind (2, phone_number).execute ();
+    });
+}
+
+void
+SMSStorage::get_high_water_marks_virt (const Conecto::Device& device, const SlotHighWaterMarks& done)
+{
+    std::string device_id = device.get_device_id ();
+    m_readers->submit (
+            [device_id] (Utils::SqliteConnection& conn) {
+                HighWaterMarks res;
+                auto&          stmt = conn.get_statement (SELECT_HIGH_WATER_MARKS).bind (1, device_id);
+                while (stmt.step ()) res[stmt.get_int64 (0)] = stmt.get_int64 (1);
+                return res;
+            },
+            [done] (HighWaterMarks res) { done (true, std::move (res)); },
+            [done] (const std::string&) { done (false, HighWaterMarks ()); });
+}
+
+void
+SMSStorage::set_high_water_mark_virt (const Conecto::Device& device, int64_t thread_id, int64_t date)
+{
+    std::string device_id = device.get_device_id ();
+    m_writer->submit ([device_id, thread_id, date] (Utils::SqliteConnection& conn) {
+        conn.get_statement (SET_HIGH_WATER_MARK).bind (1, device_id).bind (2, thread_id).bind (3, date).execute ();
+    });
+}
+
+void
+SMSStorage::store_messages_virt (const Conecto::Device& device, std::vector<Conecto::Plugins::SMSMessage>&& messages,
+                                 const SlotStored& done)
+{
+    std::string device_id = device.get_device_id ();
+    size_t      n_messages = messages.size ();
+    auto        shared_messages = std::make_shared<std::vector<Conecto::Plugins::SMSMessage>> (std::move (messages));
+    m_writer->submit (
+            [device_id, shared_messages] (Utils::SqliteConnection& conn) {
+                return ingest (conn, device_id, *shared_messages);
+            },
+            [this, device_id, n_messages, done] (IngestResult res) {
+                if (res.n_inserted > 0) m_signal_messages_added.emit (device_id);
+                // Ingesting stops at the first chunk which couldn't be committed
+                if (done) done (res.n_inserted + res.n_skipped == n_messages);
+            },
+            [done] (const std::string&) {
+                if (done) done (false);
+            });
+}
+
+void
+SMSStorage::get_conversation_contacts (const Conecto::Device&                           device,
+                                       const std::function<void (std::vector<Contact>)>& done)
+{
+    get_conversations (device, [this, done] (std::vector<Conversation> conversations) {
+        // Contacts are only accessed from the main thread
+        std::vector<Contact> res;
+        res.reserve (conversations.size ());
+        for (const auto& conversation : conversations) {
+            const Contact* contact = m_contacts.find_by_phone_number (conversation.phone_number);
+            // The conversation's number is kept, it identifies the conversation in the database
+            if (contact) {
+                res.emplace_back (contact->display_name, std::vector<std::string> ({ conversation.phone_number }));
+                continue;
+            }
+            res.emplace_back (std::string (), std::vector<std::string> ({ conversation.phone_number }));
         }
-        res.emplace_back (std::string (), std::vector<std::string> ({ phone_number }));
-    }
-    return res;
+        done (std::move (res));
+    });
 }
 
 const std::vector<SMSStorage::Contact>&
 SMSStorage::get_available_contacts ()
 {
-    return m_available_contacts;
+    return m_contacts.get_contacts ();
 }
\ No newline at end of file
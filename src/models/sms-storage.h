@@ -23,68 +23,203 @@
 #include <gtkmm.h>
 #include <sqlite3.h>
 #include <folks/folks.h>
-
-// forward declarations
-namespace Conecto {
-class Device;
-}
+#include <conecto.h>
+#include <unordered_set>
+#include "../utils/sqlite-worker.h"
+#include "contact-index.h"
 
 namespace App {
 namespace Models {
 
 /**
  * @brief A storage for SMS messages built using sqlite
+ *
+ * Database access happens on background threads: Writes are queued on a single writer connection, reads are
+ * distributed across a small pool of read-only connections. Results are passed to callbacks on the main context.
+ *
+ * Messages synced by @p Conecto::Plugins::SMS are stored through the @p Conecto::Plugins::SMSStore interface, which
+ * keeps a high-water mark for every thread of a device.
  */
-class SMSStorage {
+class SMSStorage : public Conecto::Plugins::SMSStore {
   public:
     /**
      * @brief Create a new SMSStorage-model
      */
     SMSStorage ();
+    /**
+     * @brief Create a SMSStorage-model using the database at @p path
+     *
+     * Contacts are only loaded from the snapshot at @p contacts_snapshot_path, libfolks isn't used.
+     */
+    SMSStorage (const std::string& path, const std::string& contacts_snapshot_path);
     ~SMSStorage ();
 
     struct SMS {
         enum FromType : int { FROM_ME = 0, FROM_CONTACT = 1 };
 
-        SMS (const std::string& message, const std::string& phone_number, FromType from, const Glib::DateTime& date_time)
-            : message (message), phone_number (phone_number), from (from), date_time (date_time) {}
+        SMS (const std::string& message, const std::string& phone_number, FromType from, const Glib::DateTime& date_time,
+             int64_t thread_id = -1, int64_t message_id = -1)
+            : message (message), phone_number (phone_number), from (from), date_time (date_time)
+            , thread_id (thread_id), message_id (message_id) {}
 
         std::string message;
         std::string phone_number;
         FromType from;
         Glib::DateTime date_time;
+        /** @brief Ids assigned by the phone (-1 if unknown), used for detecting duplicates */
+        int64_t thread_id;
+        int64_t message_id;
+    };
+
+    struct IngestResult {
+        /** @brief Number of messages which have been added */
+        size_t n_inserted;
+        /** @brief Number of messages which were already stored */
+        size_t n_skipped;
+        /** @brief Time spent writing the messages */
+        double seconds;
+    };
+
+    using Contact = ContactIndex::Contact;
+
+    struct SearchHit {
+        /** @brief The message's row id */
+        int64_t        id;
+        std::string    device_id;
+        std::string    phone_number;
+        Glib::DateTime date_time;
+        /** @brief An excerpt of the message as Pango markup, with the matching words in bold */
+        std::string    snippet;
     };
 
-    struct Contact {
-        Contact (const std::string& display_name, std::vector<std::string>&& phone_numbers)
-            : display_name (display_name), phone_numbers (std::move (phone_numbers)) {}
+    /**
+     * @brief A position in a conversation, used for paginating through its messages
+     */
+    struct PageKey {
+        /** @brief Milliseconds since the epoch */
+        int64_t timestamp;
+        /** @brief The message's row id (distinguishes messages with the same timestamp) */
+        int64_t id;
 
-        std::string              display_name;
-        std::vector<std::string> phone_numbers;
+        /** @brief A key after the newest message (start reading older messages from here) */
+        static PageKey newest () { return { INT64_MAX, INT64_MAX }; }
+        /** @brief A key before the oldest message (start reading newer messages from here) */
+        static PageKey oldest () { return { INT64_MIN, INT64_MIN }; }
     };
 
+    enum class PageDirection { OLDER, NEWER };
+
     /**
-     * @brief Add a new SMS message to the database
+     * @brief A message read by @p read_conversation_page
+     */
+    struct MessageRow {
+        int64_t       id;
+        int64_t       timestamp;
+        SMS::FromType from;
+        std::string   message;
+
+        /** @brief The key for continuing after this message */
+        PageKey get_key () const { return { timestamp, id }; }
+    };
+
+    /**
+     * @brief Summary of a conversation with one phone number
+     */
+    struct Conversation {
+        std::string phone_number;
+        std::string last_message;
+        /** @brief Time of the last message in milliseconds since the epoch */
+        int64_t     last_timestamp;
+        /** @brief Number of received messages since the conversation has been marked as read */
+        int         unread_count;
+        int         message_count;
+    };
+
+    using SlotMessages = std::function<void (std::list<SMS>)>;
+    using SlotPage = std::function<void (const std::shared_ptr<std::vector<MessageRow>>& /* buffer */,
+                                         size_t /* n_rows */)>;
+
+    /**
+     * @brief Queue a new SMS message for being added to the database
      */
     void add_sms (const Conecto::Device& device, const SMS& sms);
+    /**
+     * @brief Queue a batch of SMS messages (e.g. a synced conversation history) for being added to the database
+     *
+     * The messages are written in chunked transactions. Messages with a thread and message id which are already stored
+     * for @p device are skipped.
+     *
+     * @param done Called on the main context once all messages have been written (may be empty)
+     */
+    void add_sms_messages (const Conecto::Device& device, std::vector<SMS>&& messages,
+                           const std::function<void (IngestResult)>& done = std::function<void (IngestResult)> ());
 
     /**
      * @brief Get the latest 20 SMS messages received/sent by @param device from/to @param phone_number
+     *
+     * @param done Called with the messages on the main context
      */
-    std::list<SMS> get_latest_sms_messages (const Conecto::Device& device, const std::string& phone_number);
+    void get_latest_sms_messages (const Conecto::Device& device, const std::string& phone_number,
+                                  const SlotMessages& done);
 
     /**
      * @brief Get the 10 most recent SMS messages received/sent by @param device from/to @param phone_number before @param datetime
+     *
+     * @param done Called with the messages on the main context
      */
-    std::list<SMS> get_sms_messages_before (const Conecto::Device& device, const std::string& phone_number,
-                                            const Glib::DateTime& datetime);
+    void get_sms_messages_before (const Conecto::Device& device, const std::string& phone_number,
+                                  const Glib::DateTime& datetime, const SlotMessages& done);
 
     /**
-     * @brief Get a list of conversation contacts (their display names may be empty if not found using libfolks)
+     * @brief Read up to @p page_size messages of a conversation, starting after @p from in @p direction
+     *
+     * Rows are returned in the order they have been read (i.e. newest first when reading older messages). Pass the key
+     * of the last row to read the next page.
+     *
+     * @param buffer A buffer which is filled with the rows (may be empty). Passing the same buffer for every page
+     *        reuses its rows, so no allocations are necessary once it has grown to the page size. The buffer must not
+     *        be accessed until @p done is called.
+     * @param done Called with the buffer and the number of valid rows at its beginning on the main context
+     * @param failed Called instead of @p done if the page couldn't be read
+     */
+    void read_conversation_page (const Conecto::Device& device, const std::string& phone_number, const PageKey& from,
+                                 PageDirection direction, size_t page_size,
+                                 const std::shared_ptr<std::vector<MessageRow>>& buffer, const SlotPage& done,
+                                 const Utils::SqliteWorker::SlotFailed& failed = Utils::SqliteWorker::SlotFailed ());
+
+    /**
+     * @brief Get the conversations of @p device, most recent first
+     *
+     * @param done Called with the conversations on the main context
+     */
+    void get_conversations (const Conecto::Device&                                device,
+                            const std::function<void (std::vector<Conversation>)>& done);
+    /**
+     * @brief Reset the unread count of a conversation
+     */
+    void mark_conversation_read (const Conecto::Device& device, const std::string& phone_number);
+
+    /**
+     * @brief Get a list of conversation contacts, most recent first (their display names may be empty if not found
+     * using libfolks)
      * 
      * @note The vecotor's item's phone_numbers fields always contain only one element
+     * @param done Called with the contacts on the main context
+     */
+    void get_conversation_contacts (const Conecto::Device&                           device,
+                                    const std::function<void (std::vector<Contact>)>& done);
+    /**
+     * @brief Search the messages of all devices and conversations
+     *
+     * Every word in @p text needs to match the beginning of a word in the message. Hits are ranked by relevance.
+     *
+     * @param offset The number of hits to skip (for pagination)
+     * @param limit The maximum number of hits
+     * @param done Called with the hits on the main context
      */
-    std::vector<Contact> get_conversation_contacts (const Conecto::Device& device);
+    void search_messages (const std::string& text, size_t offset, size_t limit,
+                          const std::function<void (std::vector<SearchHit>)>& done);
+
     /**
      * @brief Get a list of available contacts using libfolks (not including unknown contacts)
      */
@@ -93,30 +228,80 @@ class SMSStorage {
     using type_signal_available_contacts_changed = sigc::signal<void>;
     type_signal_available_contacts_changed signal_available_contacts_changed () { return m_signal_available_contacts_changed; }
 
+    /**
+     * @param device_id The id of the device whose messages have been added
+     */
+    using type_signal_messages_added = sigc::signal<void, const std::string& /* device_id */>;
+    /**
+     * Emitted after messages synced from a device have been written
+     */
+    type_signal_messages_added signal_messages_added () { return m_signal_messages_added; }
+
     SMSStorage (const SMSStorage&) = delete;
     SMSStorage& operator= (const SMSStorage&) = delete;
 
+  protected:
+    // SMSStore overrides
+    void get_high_water_marks_virt (const Conecto::Device& device, const SlotHighWaterMarks& done) override;
+    void set_high_water_mark_virt (const Conecto::Device& device, int64_t thread_id, int64_t date) override;
+    void store_messages_virt (const Conecto::Device& device, std::vector<Conecto::Plugins::SMSMessage>&& messages,
+                              const SlotStored& done) override;
+
   private:
-    std::shared_ptr<sqlite3> m_conn;
+    std::unique_ptr<Utils::SqliteWorker> m_writer;
+    std::unique_ptr<Utils::SqliteWorker> m_readers;
 
     /**
-     * @brief Get a list of phone numbers for which conversations exist through @param device
+     * @brief Queue the next chunk of messages for being added to the full-text index (if necessary)
      */
-    std::list<std::string> get_phone_numbers (const Conecto::Device& device);
+    void schedule_fts_backfill ();
+
     /**
-     * @brief Fetch the contact list using libfolks
+     * @brief Prepare libfolks in the background, reported contacts are reconciled with the snapshot
      */
     void fetch_available_contacts ();
+    void load_contacts_snapshot ();
+    void save_contacts_snapshot ();
+    /**
+     * @brief Remove contacts from the snapshot which haven't been reported by libfolks
+     */
+    void finish_reconciliation ();
+    void on_contacts_changed ();
+    /**
+     * @brief Start tracking changes of @p individual and add it to the contact index
+     *
+     * @return true if the contact index has changed
+     */
+    bool track_individual (FolksIndividual* individual);
+    /**
+     * @brief Stop tracking changes of @p individual and remove it from the contact index
+     *
+     * @return true if the contact index has changed
+     */
+    bool untrack_individual (FolksIndividual* individual);
+    /**
+     * @brief Update the contact index entry of @p individual
+     *
+     * @return true if the contact index has changed
+     */
+    bool update_individual (FolksIndividual* individual);
     static void on_individuals_changed (FolksIndividualAggregator* _sender, GeeMultiMap* changes, SMSStorage* self);
+    static void on_individual_notify (FolksIndividual* individual, GParamSpec* pspec, SMSStorage* self);
     static void on_prepare_cb (GObject *source_object, GAsyncResult *res, SMSStorage* self);
+    static void on_aggregator_quiescent (FolksIndividualAggregator* aggregator, GParamSpec* pspec, SMSStorage* self);
 
     std::shared_ptr<FolksIndividualAggregator> m_aggregator;
     type_signal_available_contacts_changed     m_signal_available_contacts_changed;
+    type_signal_messages_added                 m_signal_messages_added;
 
-    std::vector<Contact>       m_available_contacts;
-    std::map<std::string, int> m_phone_numbers_map;
+    ContactIndex m_contacts;
+    std::string  m_contacts_snapshot_path;
 
-    bool exec_query (const std::string& query, std::function<void(const std::vector<std::string>& /* values */, const std::vector<std::string>& /* column_names */)>&& cb = [] (const std::vector<std::string>&, const std::vector<std::string>&) {});
+    // Individual ids reported by libfolks until it has become quiescent for the first time
+    std::unordered_set<std::string> m_seen_individuals;
+    bool                            m_reconciled;
+    bool                            m_snapshot_dirty;
+    sigc::connection                m_snapshot_save_connection;
 };
 
 } // namespace Models
@@ -0,0 +1,63 @@
+/* phone-number.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "phone-number.h"
+
+using namespace App::Utils;
+
+namespace {
+
+// Number of trailing digits compared when matching (national significant numbers are usually at least this long,
+// country codes and trunk prefixes are ignored this way)
+constexpr size_t MATCH_DIGITS = 9;
+
+} // namespace
+
+std::string
+PhoneNumber::normalize (const std::string& number)
+{
+    std::string digits;
+    digits.reserve (number.size ());
+    bool international = false;
+
+    for (char c : number) {
+        if (c >= '0' && c <= '9')
+            digits += c;
+        else if (c == '+' && digits.empty ())
+            international = true;
+        else if (c == ',' || c == ';')
+            break;
+    }
+
+    if (!international && digits.compare (0, 2, "00") == 0) {
+        international = true;
+        digits.erase (0, 2);
+    }
+    return international ? '+' + digits : digits;
+}
+
+std::string
+PhoneNumber::get_match_key (const std::string& number)
+{
+    std::string normalized = normalize (number);
+    size_t      start = normalized.compare (0, 1, "+") == 0 ? 1 : 0;
+    if (normalized.size () - start > MATCH_DIGITS) start = normalized.size () - MATCH_DIGITS;
+    return normalized.substr (start);
+}
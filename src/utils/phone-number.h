@@ -0,0 +1,52 @@
+/* phone-number.h
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <string>
+
+namespace App {
+namespace Utils {
+
+/**
+ * Phone number helper methods
+ */
+class PhoneNumber {
+  public:
+    /**
+     * @brief Normalize a phone number in an E.164-like way
+     *
+     * Formatting characters are removed and international prefixes ("+" or "00") are turned into "+", so
+     * "+49 170 123-4567" and "0049 170 1234567" both become "+491701234567". Numbers without an international prefix
+     * are kept in their national format (the country code isn't known), dial strings after ',' or ';' are dropped.
+     */
+    static std::string normalize (const std::string& number);
+
+    /**
+     * @brief Get the key used for matching phone numbers
+     *
+     * This consists of the last digits of the normalized number, so numbers with and without country code or trunk
+     * prefix ("+491701234567" and "01701234567") have the same key.
+     */
+    static std::string get_match_key (const std::string& number);
+};
+
+} // namespace Utils
+} // namespace App
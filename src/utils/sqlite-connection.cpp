@@ -0,0 +1,66 @@
+/* sqlite-connection.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "sqlite-connection.h"
+#include <glib.h>
+
+using namespace App::Utils;
+
+SqliteConnection::SqliteConnection (const std::string& path, int flags)
+    : m_handle (nullptr)
+{
+    // Every connection is only used by one thread at a time, so sqlite doesn't need to lock
+    int err = sqlite3_open_v2 (path.c_str (), &m_handle, flags | SQLITE_OPEN_NOMUTEX, nullptr);
+    if (err != SQLITE_OK) {
+        g_warning ("Can't open database %s: %s", path.c_str (), sqlite3_errmsg (m_handle));
+        sqlite3_close (m_handle);
+        throw "Can't open database";
+    }
+    sqlite3_busy_timeout (m_handle, 1000);
+}
+
+SqliteConnection::~SqliteConnection ()
+{
+    // Statements need to be finalized before the connection can be closed
+    m_statements.clear ();
+    sqlite3_close (m_handle);
+}
+
+bool
+SqliteConnection::exec (const std::string& query)
+{
+    char* errmsg = nullptr;
+    int   err = sqlite3_exec (m_handle, query.c_str (), nullptr, nullptr, &errmsg);
+    if (err != SQLITE_OK) {
+        g_warning ("Error while executing sqlite query %s: %s", query.c_str (), errmsg);
+        sqlite3_free (errmsg);
+        return false;
+    }
+    return true;
+}
+
+SqliteStatement&
+SqliteConnection::get_statement (const std::string& sql)
+{
+    auto it = m_statements.find (sql);
+    if (it == m_statements.end ())
+        it = m_statements.emplace (sql, std::make_unique<SqliteStatement> (m_handle, sql)).first;
+    return it->second->reset ();
+}
@@ -0,0 +1,71 @@
+/* sqlite-connection.h
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "sqlite-statement.h"
+#include <memory>
+#include <unordered_map>
+
+namespace App {
+namespace Utils {
+
+/**
+ * @brief A sqlite database connection with a cache of prepared statements
+ *
+ * A connection must only be used by one thread at a time.
+ */
+class SqliteConnection {
+  public:
+    /**
+     * @brief Open the database at @p path
+     *
+     * @param flags Flags passed to sqlite3_open_v2 (e.g. SQLITE_OPEN_READONLY)
+     * @throw const char* if the database can't be opened
+     */
+    SqliteConnection (const std::string& path, int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    ~SqliteConnection ();
+
+    /**
+     * @brief Execute one or more SQL statements without binding parameters or reading results (e.g. schema changes)
+     */
+    bool exec (const std::string& query);
+    /**
+     * @brief Get a cached prepared statement for @p sql, compiling it if necessary
+     *
+     * The returned statement is reset and has no bindings.
+     */
+    SqliteStatement& get_statement (const std::string& sql);
+
+    /**
+     * @brief Get the raw connection handle
+     */
+    sqlite3* get_handle () const noexcept { return m_handle; }
+
+    SqliteConnection (const SqliteConnection&) = delete;
+    SqliteConnection& operator= (const SqliteConnection&) = delete;
+
+  private:
+    sqlite3*                                                          m_handle;
+    std::unordered_map<std::string, std::unique_ptr<SqliteStatement>> m_statements;
+};
+
+} // namespace Utils
+} // namespace App
@@ -0,0 +1,136 @@
+/* sqlite-statement.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "sqlite-statement.h"
+#include <glib.h>
+
+using namespace App::Utils;
+
+SqliteStatement::SqliteStatement (sqlite3* conn, const std::string& sql)
+    : m_conn (conn)
+    , m_stmt (nullptr)
+{
+    int err = sqlite3_prepare_v3 (m_conn, sql.c_str (), static_cast<int> (sql.size () + 1), SQLITE_PREPARE_PERSISTENT,
+                                  &m_stmt, nullptr);
+    if (err != SQLITE_OK) {
+        g_warning ("Error while preparing sqlite statement %s: %s", sql.c_str (), sqlite3_errmsg (m_conn));
+        sqlite3_finalize (m_stmt);
+        throw "Can't prepare sqlite statement";
+    }
+}
+
+SqliteStatement::~SqliteStatement ()
+{
+    sqlite3_finalize (m_stmt);
+}
+
+SqliteStatement&
+SqliteStatement::reset ()
+{
+    sqlite3_reset (m_stmt);
+    sqlite3_clear_bindings (m_stmt);
+    return *this;
+}
+
+SqliteStatement&
+SqliteStatement::bind (int index, const std::string& value)
+{
+    sqlite3_bind_text (m_stmt, index, value.data (), static_cast<int> (value.size ()), SQLITE_TRANSIENT);
+    return *this;
+}
+
+SqliteStatement&
+SqliteStatement::bind (int index, int64_t value)
+{
+    sqlite3_bind_int64 (m_stmt, index, value);
+    return *this;
+}
+
+SqliteStatement&
+SqliteStatement::bind (int index, int value)
+{
+    sqlite3_bind_int (m_stmt, index, value);
+    return *this;
+}
+
+SqliteStatement&
+SqliteStatement::bind_null (int index)
+{
+    sqlite3_bind_null (m_stmt, index);
+    return *this;
+}
+
+bool
+SqliteStatement::step ()
+{
+    int err = sqlite3_step (m_stmt);
+    if (err == SQLITE_ROW) return true;
+
+    if (err != SQLITE_DONE) g_warning ("Error while executing sqlite statement: %s", sqlite3_errmsg (m_conn));
+    // Don't keep the (read) transaction open until the statement is used the next time
+    sqlite3_reset (m_stmt);
+    return false;
+}
+
+bool
+SqliteStatement::execute ()
+{
+    int err;
+    while ((err = sqlite3_step (m_stmt)) == SQLITE_ROW) {}
+    if (err != SQLITE_DONE) g_warning ("Error while executing sqlite statement: %s", sqlite3_errmsg (m_conn));
+    sqlite3_reset (m_stmt);
+    return err == SQLITE_DONE;
+}
+
+std::string
+SqliteStatement::get_string (int column) const
+{
+    const unsigned char* text = sqlite3_column_text (m_stmt, column);
+    if (!text) return std::string ();
+    return std::string (reinterpret_cast<const char*> (text), sqlite3_column_bytes (m_stmt, column));
+}
+
+void
+SqliteStatement::get_string (int column, std::string& value) const
+{
+    const unsigned char* text = sqlite3_column_text (m_stmt, column);
+    if (!text)
+        value.clear ();
+    else
+        value.assign (reinterpret_cast<const char*> (text), sqlite3_column_bytes (m_stmt, column));
+}
+
+int64_t
+SqliteStatement::get_int64 (int column) const
+{
+    return sqlite3_column_int64 (m_stmt, column);
+}
+
+int
+SqliteStatement::get_int (int column) const
+{
+    return sqlite3_column_int (m_stmt, column);
+}
+
+bool
+SqliteStatement::get_is_null (int column) const
+{
+    return sqlite3_column_type (m_stmt, column) == SQLITE_NULL;
+}
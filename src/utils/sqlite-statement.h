@@ -0,0 +1,92 @@
+/* sqlite-statement.h
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <sqlite3.h>
+#include <cstdint>
+#include <string>
+
+namespace App {
+namespace Utils {
+
+/**
+ * @brief A prepared sqlite statement which can be executed multiple times
+ *
+ * The SQL is only compiled once. Parameters are bound by their (1-based) index, columns are read by their (0-based)
+ * index. The statement is reset automatically once all rows have been stepped through.
+ */
+class SqliteStatement {
+  public:
+    /**
+     * @brief Compile @p sql for @p conn
+     *
+     * @throw const char* if the statement can't be compiled
+     */
+    SqliteStatement (sqlite3* conn, const std::string& sql);
+    ~SqliteStatement ();
+
+    /**
+     * @brief Reset the statement and clear all bindings, so it can be executed again
+     */
+    SqliteStatement& reset ();
+
+    SqliteStatement& bind (int index, const std::string& value);
+    SqliteStatement& bind (int index, int64_t value);
+    SqliteStatement& bind (int index, int value);
+    SqliteStatement& bind_null (int index);
+
+    /**
+     * @brief Evaluate the statement until the next row is available
+     *
+     * @return true if a row is available, false if the statement has finished or an error occured
+     */
+    bool step ();
+    /**
+     * @brief Run the statement to completion, ignoring any rows
+     *
+     * @return true if the statement was executed successfully
+     */
+    bool execute ();
+
+    std::string get_string (int column) const;
+    /**
+     * @brief Assign a text column to @p value (reusing its buffer)
+     */
+    void        get_string (int column, std::string& value) const;
+    int64_t     get_int64 (int column) const;
+    int         get_int (int column) const;
+    bool        get_is_null (int column) const;
+
+    /**
+     * @brief Get the raw statement handle
+     */
+    sqlite3_stmt* get_handle () const noexcept { return m_stmt; }
+
+    SqliteStatement (const SqliteStatement&) = delete;
+    SqliteStatement& operator= (const SqliteStatement&) = delete;
+
+  private:
+    sqlite3*      m_conn;
+    sqlite3_stmt* m_stmt;
+};
+
+} // namespace Utils
+} // namespace App
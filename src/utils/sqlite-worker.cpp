@@ -0,0 +1,126 @@
+/* sqlite-worker.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "sqlite-worker.h"
+#include <exception>
+#include <glib.h>
+
+using namespace App::Utils;
+
+SqliteWorker::SqliteWorker (std::vector<std::unique_ptr<SqliteConnection>>&& connections)
+    : m_connections (std::move (connections))
+    , m_stopping (false)
+{
+    m_dispatcher.connect (sigc::mem_fun (*this, &SqliteWorker::on_dispatch));
+
+    m_threads.reserve (m_connections.size ());
+    for (auto& conn : m_connections) {
+        SqliteConnection* conn_ptr = conn.get ();
+        m_threads.emplace_back ([this, conn_ptr] () { run (*conn_ptr); });
+    }
+}
+
+SqliteWorker::~SqliteWorker ()
+{
+    {
+        std::lock_guard<std::mutex> lock (m_jobs_mutex);
+        m_stopping = true;
+    }
+    m_jobs_cond.notify_all ();
+    for (auto& thread : m_threads) thread.join ();
+}
+
+void
+SqliteWorker::submit (Job&& job, const SlotFailed& failed)
+{
+    push ([job] (SqliteConnection& conn) -> Completion {
+              job (conn);
+              return Completion ();
+          },
+          failed);
+}
+
+void
+SqliteWorker::push (std::function<Completion (SqliteConnection&)>&& job, const SlotFailed& failed)
+{
+    {
+        std::lock_guard<std::mutex> lock (m_jobs_mutex);
+        m_jobs.push_back ({ std::move (job), failed });
+    }
+    m_jobs_cond.notify_one ();
+}
+
+void
+SqliteWorker::run (SqliteConnection& conn)
+{
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock (m_jobs_mutex);
+            m_jobs_cond.wait (lock, [this] () { return m_stopping || !m_jobs.empty (); });
+            // Queued jobs (e.g. writes) are still run when stopping
+            if (m_jobs.empty ()) return;
+            task = std::move (m_jobs.front ());
+            m_jobs.pop_front ();
+        }
+
+        // A failing job must not take the thread (and the connection) down with it
+        Completion completion;
+        try {
+            completion = task.job (conn);
+        } catch (const char* err) {
+            completion = fail (conn, task, err);
+        } catch (const std::exception& err) {
+            completion = fail (conn, task, err.what ());
+        } catch (...) {
+            completion = fail (conn, task, "Unknown error");
+        }
+        if (!completion) continue;
+
+        {
+            std::lock_guard<std::mutex> lock (m_completions_mutex);
+            m_completions.push_back (std::move (completion));
+        }
+        m_dispatcher.emit ();
+    }
+}
+
+SqliteWorker::Completion
+SqliteWorker::fail (SqliteConnection& conn, const Task& task, const std::string& error)
+{
+    g_warning ("Database job failed: %s", error.c_str ());
+    // A transaction left open by the job would make every following job on this connection fail
+    if (!sqlite3_get_autocommit (conn.get_handle ())) conn.exec ("ROLLBACK;");
+    if (!task.failed) return Completion ();
+
+    SlotFailed failed = task.failed;
+    return [failed, error] () { failed (error); };
+}
+
+void
+SqliteWorker::on_dispatch ()
+{
+    std::deque<Completion> completions;
+    {
+        std::lock_guard<std::mutex> lock (m_completions_mutex);
+        completions.swap (m_completions);
+    }
+    for (auto& completion : completions) completion ();
+}
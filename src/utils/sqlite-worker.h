@@ -0,0 +1,121 @@
+/* sqlite-worker.h
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "sqlite-connection.h"
+#include <glibmm/dispatcher.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace App {
+namespace Utils {
+
+/**
+ * @brief Runs database jobs on background threads
+ *
+ * Every thread owns one of the connections passed to the constructor and takes jobs from a shared queue (in order).
+ * Results are passed back to the main context, where the completion callbacks are invoked. The worker must be
+ * created on the main thread.
+ */
+class SqliteWorker {
+  public:
+    using Job = std::function<void (SqliteConnection&)>;
+    /**
+     * @param error A description of the error
+     */
+    using SlotFailed = std::function<void (const std::string& /* error */)>;
+
+    /**
+     * @brief Start one thread per connection
+     */
+    SqliteWorker (std::vector<std::unique_ptr<SqliteConnection>>&& connections);
+    /**
+     * @brief Run the remaining jobs and stop all threads
+     *
+     * Completion callbacks which haven't been invoked yet are discarded.
+     */
+    ~SqliteWorker ();
+
+    /**
+     * @brief Queue a job without a result
+     *
+     * @param failed Invoked on the main context if the job throws (may be empty, failures are logged either way)
+     */
+    void submit (Job&& job, const SlotFailed& failed = SlotFailed ());
+
+    /**
+     * @brief Queue a job and invoke @p done with its result on the main context
+     *
+     * @param failed Invoked on the main context instead of @p done if the job throws (may be empty, failures are
+     *        logged either way)
+     */
+    template <typename JobFunc, typename DoneFunc,
+              typename Result = decltype (std::declval<JobFunc> () (std::declval<SqliteConnection&> ())),
+              typename = std::enable_if_t<!std::is_void<Result>::value>>
+    void submit (JobFunc&& job, DoneFunc&& done, const SlotFailed& failed = SlotFailed ())
+    {
+        push ([job, done] (SqliteConnection& conn) -> Completion {
+                  auto res = std::make_shared<Result> (job (conn));
+                  return [done, res] () { done (std::move (*res)); };
+              },
+              failed);
+    }
+
+    SqliteWorker (const SqliteWorker&) = delete;
+    SqliteWorker& operator= (const SqliteWorker&) = delete;
+
+  private:
+    using Completion = std::function<void ()>;
+
+    struct Task {
+        std::function<Completion (SqliteConnection&)> job;
+        SlotFailed                                    failed;
+    };
+
+    void push (std::function<Completion (SqliteConnection&)>&& job, const SlotFailed& failed);
+    void run (SqliteConnection& conn);
+    /**
+     * @brief Log the failure of @p task, roll back its transaction and get the completion reporting the failure
+     */
+    static Completion fail (SqliteConnection& conn, const Task& task, const std::string& error);
+    void on_dispatch ();
+
+    std::vector<std::unique_ptr<SqliteConnection>> m_connections;
+    std::vector<std::thread>                       m_threads;
+
+    std::mutex              m_jobs_mutex;
+    std::condition_variable m_jobs_cond;
+    std::deque<Task>        m_jobs;
+    bool                    m_stopping;
+
+    std::mutex             m_completions_mutex;
+    std::deque<Completion> m_completions;
+    Glib::Dispatcher       m_dispatcher;
+};
+
+} // namespace Utils
+} // namespace App
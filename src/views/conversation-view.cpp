@@ -0,0 +1,221 @@
+/* conversation-view.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "conversation-view.h"
+#include <algorithm>
+
+using namespace App::Views;
+
+namespace {
+
+constexpr size_t PAGE_SIZE = 50;
+constexpr int    MESSAGE_PADDING = 12;
+
+} // namespace
+
+ConversationView::ConversationView (const std::shared_ptr<Models::SMSStorage>& model,
+                                    const std::shared_ptr<Conecto::Device>&    device,
+                                    const std::string&                         phone_number)
+    : Gtk::ScrolledWindow ()
+    , m_model (model)
+    , m_device (device)
+    , m_phone_number (phone_number)
+    , m_oldest (Models::SMSStorage::PageKey::newest ())
+    , m_newest (Models::SMSStorage::PageKey::oldest ())
+    , m_older_buffer (std::make_shared<std::vector<Models::SMSStorage::MessageRow>> ())
+    , m_newer_buffer (std::make_shared<std::vector<Models::SMSStorage::MessageRow>> ())
+    , m_loading_older (false)
+    , m_loading_newer (false)
+    , m_reached_start (false)
+    , m_anchor_from_bottom (0)
+    , m_anchored (true)
+    , m_adjusting (false)
+    , m_wrap_width (0)
+    , m_alive (std::make_shared<bool> (true))
+{
+    m_columns.add (m_column_timestamp);
+    m_columns.add (m_column_from);
+    m_columns.add (m_column_message);
+    m_store = Gtk::ListStore::create (m_columns);
+
+    m_cell_message.property_wrap_mode ().set_value (Pango::WRAP_WORD_CHAR);
+    m_cell_message.property_xpad ().set_value (MESSAGE_PADDING);
+    m_cell_message.property_ypad ().set_value (MESSAGE_PADDING / 2);
+    m_column.pack_start (m_cell_message, true);
+    m_column.set_cell_data_func (m_cell_message, sigc::mem_fun (*this, &ConversationView::cell_data_func_message));
+
+    m_tree_view.set_model (m_store);
+    m_tree_view.append_column (m_column);
+    m_tree_view.set_headers_visible (false);
+    m_tree_view.set_enable_search (false);
+    m_tree_view.get_selection ()->set_mode (Gtk::SELECTION_NONE);
+    m_tree_view.signal_size_allocate ().connect (sigc::mem_fun (*this, &ConversationView::on_size_allocate));
+
+    set_policy (Gtk::POLICY_NEVER, Gtk::POLICY_AUTOMATIC);
+    add (m_tree_view);
+    get_vadjustment ()->signal_value_changed ().connect (sigc::mem_fun (*this, &ConversationView::on_value_changed));
+    get_vadjustment ()->signal_changed ().connect (sigc::mem_fun (*this, &ConversationView::on_adjustment_changed));
+    show_all_children ();
+
+    m_model->mark_conversation_read (*m_device, m_phone_number);
+    load_older ();
+}
+
+ConversationView::~ConversationView ()
+{
+}
+
+void
+ConversationView::load_older ()
+{
+    if (m_loading_older || m_reached_start) return;
+    m_loading_older = true;
+
+    std::weak_ptr<bool> alive = m_alive;
+    m_model->read_conversation_page (
+            *m_device, m_phone_number, m_oldest, Models::SMSStorage::PageDirection::OLDER, PAGE_SIZE, m_older_buffer,
+            [this, alive] (const PageBuffer& buffer, size_t n_rows) {
+                if (alive.expired ()) return;
+                on_older_loaded (buffer, n_rows);
+            },
+            // Allow loading the page again
+            [this, alive] (const std::string&) {
+                if (!alive.expired ()) m_loading_older = false;
+            });
+}
+
+void
+ConversationView::load_newer ()
+{
+    if (m_loading_newer) return;
+    m_loading_newer = true;
+
+    std::weak_ptr<bool> alive = m_alive;
+    m_model->read_conversation_page (
+            *m_device, m_phone_number, m_newest, Models::SMSStorage::PageDirection::NEWER, PAGE_SIZE, m_newer_buffer,
+            [this, alive] (const PageBuffer& buffer, size_t n_rows) {
+                if (alive.expired ()) return;
+                on_newer_loaded (buffer, n_rows);
+            },
+            // Allow loading the page again
+            [this, alive] (const std::string&) {
+                if (!alive.expired ()) m_loading_newer = false;
+            });
+}
+
+void
+ConversationView::on_older_loaded (const PageBuffer& buffer, size_t n_rows)
+{
+    m_loading_older = false;
+    if (n_rows < PAGE_SIZE) m_reached_start = true;
+    if (n_rows == 0) return;
+
+    // Rows are returned newest first, so prepending them one by one results in chronological order
+    m_anchored = true;
+    for (size_t i = 0; i < n_rows; i++) {
+        const auto& message = (*buffer)[i];
+        auto        row = *m_store->prepend ();
+        row[m_column_timestamp] = message.timestamp;
+        row[m_column_from] = static_cast<int> (message.from);
+        row[m_column_message] = message.message;
+    }
+    if (m_store->children ().size () == n_rows) m_newest = buffer->front ().get_key ();
+    m_oldest = (*buffer)[n_rows - 1].get_key ();
+
+    // Fill the visible area if the first page wasn't enough
+    auto adjustment = get_vadjustment ();
+    if (adjustment->get_value () < adjustment->get_page_size ()) load_older ();
+}
+
+void
+ConversationView::on_newer_loaded (const PageBuffer& buffer, size_t n_rows)
+{
+    m_loading_newer = false;
+    if (n_rows == 0) return;
+
+    // Stick to the bottom if the newest message was visible, otherwise the visible messages should stay where they are
+    m_anchored = m_anchor_from_bottom < 1;
+    for (size_t i = 0; i < n_rows; i++) {
+        const auto& message = (*buffer)[i];
+        auto        row = *m_store->append ();
+        row[m_column_timestamp] = message.timestamp;
+        row[m_column_from] = static_cast<int> (message.from);
+        row[m_column_message] = message.message;
+    }
+    m_newest = (*buffer)[n_rows - 1].get_key ();
+    if (m_oldest.id == Models::SMSStorage::PageKey::newest ().id) m_oldest = buffer->front ().get_key ();
+
+    if (n_rows == PAGE_SIZE) load_newer ();
+}
+
+void
+ConversationView::on_value_changed ()
+{
+    auto adjustment = get_vadjustment ();
+    if (!m_adjusting) {
+        // Scrolled by the user
+        m_anchor_from_bottom = adjustment->get_upper () - adjustment->get_page_size () - adjustment->get_value ();
+        m_anchored = true;
+    }
+
+    // Prefetch before the user reaches the top
+    if (adjustment->get_value () < adjustment->get_page_size ()) load_older ();
+}
+
+void
+ConversationView::on_adjustment_changed ()
+{
+    if (!m_anchored) return;
+
+    // Rows have been added or measured, restore the distance to the bottom
+    auto adjustment = get_vadjustment ();
+    m_adjusting = true;
+    adjustment->set_value (adjustment->get_upper () - adjustment->get_page_size () - m_anchor_from_bottom);
+    m_adjusting = false;
+}
+
+void
+ConversationView::on_size_allocate (Gtk::Allocation& allocation)
+{
+    int width = std::max (allocation.get_width () * 3 / 4 - 2 * MESSAGE_PADDING, 1);
+    if (width == m_wrap_width) return;
+
+    // Rows need to be measured again for the new width
+    m_wrap_width = width;
+    m_cell_message.property_wrap_width ().set_value (width);
+    m_tree_view.columns_autosize ();
+}
+
+void
+ConversationView::cell_data_func_message (Gtk::CellRenderer* renderer, const Gtk::TreeModel::iterator& it)
+{
+    Gtk::CellRendererText& text_renderer = dynamic_cast<Gtk::CellRendererText&> (*renderer);
+
+    int64_t        timestamp = it->get_value (m_column_timestamp);
+    Glib::DateTime date_time = Glib::DateTime::create_now_local (timestamp / 1000);
+    bool           from_me = it->get_value (m_column_from) == Models::SMSStorage::SMS::FROM_ME;
+
+    // Sent messages are aligned to the right
+    text_renderer.property_xalign ().set_value (from_me ? 1.0f : 0.0f);
+    text_renderer.property_alignment ().set_value (from_me ? Pango::ALIGN_RIGHT : Pango::ALIGN_LEFT);
+    text_renderer.property_markup ().set_value (Glib::Markup::escape_text (it->get_value (m_column_message)) +
+                                                "\n<small><span alpha=\"70%\">" +
+                                                date_time.format ("%x %H:%M") + "</span></small>");
+}
@@ -0,0 +1,100 @@
+/* conversation-view.h
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gtkmm.h>
+#include "../models/sms-storage.h"
+
+namespace App {
+namespace Views {
+
+/**
+ * @brief The messages of a single conversation, newest at the bottom
+ *
+ * Messages are shown in a tree view, so only the visible rows are rendered. The newest page is loaded first; the next
+ * page of older messages is requested while the user is still one screen away from the top. The distance to the bottom
+ * is kept when older messages are inserted, so the visible messages don't move.
+ *
+ * Connected to the following model: @p App::Models::SMSStorage
+ */
+class ConversationView : public Gtk::ScrolledWindow {
+  public:
+    /**
+     * @brief Create a view for the conversation of @p device with @p phone_number
+     */
+    ConversationView (const std::shared_ptr<Models::SMSStorage>& model, const std::shared_ptr<Conecto::Device>& device,
+                      const std::string& phone_number);
+    ~ConversationView ();
+
+    /**
+     * @brief Load messages which have been added after the newest loaded message
+     */
+    void load_newer ();
+
+    ConversationView (const ConversationView&) = delete;
+    ConversationView& operator= (const ConversationView&) = delete;
+
+  private:
+    using PageBuffer = std::shared_ptr<std::vector<Models::SMSStorage::MessageRow>>;
+
+    void load_older ();
+    void on_older_loaded (const PageBuffer& buffer, size_t n_rows);
+    void on_newer_loaded (const PageBuffer& buffer, size_t n_rows);
+    void on_value_changed ();
+    void on_adjustment_changed ();
+    void on_size_allocate (Gtk::Allocation& allocation);
+    void cell_data_func_message (Gtk::CellRenderer* renderer, const Gtk::TreeModel::iterator& it);
+
+    std::shared_ptr<Models::SMSStorage> m_model;
+    std::shared_ptr<Conecto::Device>    m_device;
+    std::string                         m_phone_number;
+
+    Gtk::TreeModelColumn<int64_t>     m_column_timestamp;
+    Gtk::TreeModelColumn<int>         m_column_from;
+    Gtk::TreeModelColumn<std::string> m_column_message;
+    Gtk::TreeModelColumnRecord        m_columns;
+    Glib::RefPtr<Gtk::ListStore>      m_store;
+    Gtk::TreeView                     m_tree_view;
+    Gtk::TreeViewColumn               m_column;
+    Gtk::CellRendererText             m_cell_message;
+
+    // Keys of the oldest and newest loaded messages
+    Models::SMSStorage::PageKey m_oldest;
+    Models::SMSStorage::PageKey m_newest;
+    // Reused for every page (one per direction, as both may be loaded at the same time)
+    PageBuffer m_older_buffer;
+    PageBuffer m_newer_buffer;
+    bool       m_loading_older;
+    bool       m_loading_newer;
+    bool       m_reached_start;
+
+    // Distance between the bottom of the visible area and the end of the list, kept while m_anchored is true
+    double m_anchor_from_bottom;
+    bool   m_anchored;
+    bool   m_adjusting;
+    int    m_wrap_width;
+
+    // Expires when the view is destroyed, checked by asynchronous model callbacks
+    std::shared_ptr<bool> m_alive;
+};
+
+} // namespace Views
+} // namespace App
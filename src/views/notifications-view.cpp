@@ -20,50 +20,254 @@
 
 #include "notifications-view.h"
 #include "../widgets/notification-row.h"
+#include <climits>
 
 using namespace App::Views;
 using namespace App::Models;
 
+namespace {
+
+// Used for rows which haven't been measured yet
+constexpr int ESTIMATED_ROW_HEIGHT = 64;
+// Rows within this distance (in pixels) of the visible area are created as well, so scrolling doesn't show gaps
+constexpr int OVERSCAN = 256;
+// Maximum number of unbound rows kept for being reused
+constexpr size_t MAX_POOL_SIZE = 8;
+
+} // namespace
+
 NotificationsView::NotificationsView ()
     : Gtk::ListBox ()
+    , m_scrolled_window (nullptr)
+    , m_first (0)
+    , m_width (0)
 {
     set_vexpand (true);
+
+    for (Gtk::ListBoxRow* spacer : { &m_top_spacer, &m_bottom_spacer }) {
+        spacer->set_activatable (false);
+        spacer->set_selectable (false);
+        spacer->set_no_show_all (true);
+        append (*spacer);
+    }
+
+    signal_size_allocate ().connect (sigc::mem_fun (*this, &NotificationsView::on_size_allocate_view));
+    signal_hierarchy_changed ().connect (sigc::mem_fun (*this, &NotificationsView::on_hierarchy_changed_view));
+}
+
+NotificationsView::~NotificationsView ()
+{
+    for (auto& connection : m_model_connections) connection.disconnect ();
+    for (auto& connection : m_scrolled_window_connections) connection.disconnect ();
+    m_relayout_connection.disconnect ();
 }
 
 void
 NotificationsView::update (const Glib::RefPtr<NotificationsList>& model)
 {
     for (auto& connection : m_model_connections) connection.disconnect ();
+    m_model_connections.clear ();
+    clear_rows ();
+    // Pooled rows belong to the previous model
+    m_pool.clear ();
+
     m_model = model;
-    m_row_refs.clear ();
+    m_heights.assign (model->children ().size (), 0);
     m_model_connections.push_back (
             model->signal_row_inserted ().connect (sigc::mem_fun (*this, &NotificationsView::on_row_inserted)));
     m_model_connections.push_back (
             model->signal_row_changed ().connect (sigc::mem_fun (*this, &NotificationsView::on_row_changed)));
     m_model_connections.push_back (
             model->signal_row_deleted ().connect (sigc::mem_fun (*this, &NotificationsView::on_row_deleted)));
+    queue_relayout ();
 }
 
 void
 NotificationsView::on_row_inserted (const Gtk::TreeModel::Path& path, const Gtk::TreeModel::iterator& it)
 {
-    auto row = Widgets::NotificationRow::create (m_model);
-    insert (*row, path[0]);
-    row->show_all ();
-    row->update (it);
-    m_row_refs.push_back (row);
+    size_t index = path[0];
+    if (index > m_heights.size ()) return;
+    m_heights.insert (m_heights.begin () + index, 0);
+
+    // Bound rows keep showing their notifications, a row is bound for the new one by the next relayout
+    if (index < m_first)
+        m_first++;
+    else if (index <= m_first + m_bound.size ())
+        m_bound.insert (m_bound.begin () + (index - m_first), nullptr);
+    queue_relayout ();
 }
 
 void
 NotificationsView::on_row_deleted (const Gtk::TreeModel::Path& path)
 {
-    if (path[0] >= static_cast<int> (get_children ().size ())) return;
-    remove (*get_children ()[path[0]]);
+    size_t index = path[0];
+    if (index >= m_heights.size ()) return;
+    m_heights.erase (m_heights.begin () + index);
+
+    // Only the row of the deleted notification is released, the others stay bound
+    if (index < m_first) {
+        m_first--;
+    } else if (index < m_first + m_bound.size ()) {
+        auto it = m_bound.begin () + (index - m_first);
+        if (*it) {
+            remove (**it);
+            release_row (*it);
+        }
+        m_bound.erase (it);
+    }
+    queue_relayout ();
 }
 
 void
 NotificationsView::on_row_changed (const Gtk::TreeModel::Path& path, const Gtk::TreeModel::iterator& it)
 {
-    if (path[0] >= static_cast<int> (get_children ().size ())) return;
-    dynamic_cast<Widgets::NotificationRow*> (get_children ()[path[0]])->update (it);
-}
\ No newline at end of file
+    size_t index = path[0];
+    if (index >= m_heights.size ()) return;
+
+    // The height is measured again once the row is shown
+    m_heights[index] = 0;
+    if (index >= m_first && index < m_first + m_bound.size () && m_bound[index - m_first])
+        m_bound[index - m_first]->update (it);
+    queue_relayout ();
+}
+
+void
+NotificationsView::on_size_allocate_view (Gtk::Allocation& allocation)
+{
+    if (allocation.get_width () == m_width) return;
+
+    // Rows wrap their text, so all heights change with the width
+    m_width = allocation.get_width ();
+    std::fill (m_heights.begin (), m_heights.end (), 0);
+    clear_rows ();
+}
+
+void
+NotificationsView::on_hierarchy_changed_view (Gtk::Widget* previous_toplevel)
+{
+    auto* scrolled_window = dynamic_cast<Gtk::ScrolledWindow*> (get_ancestor (GTK_TYPE_SCROLLED_WINDOW));
+    if (scrolled_window == m_scrolled_window) return;
+
+    for (auto& connection : m_scrolled_window_connections) connection.disconnect ();
+    m_scrolled_window_connections.clear ();
+    m_scrolled_window = scrolled_window;
+    if (m_scrolled_window) {
+        auto adjustment = m_scrolled_window->get_vadjustment ();
+        m_scrolled_window_connections.push_back (
+                adjustment->signal_value_changed ().connect (sigc::mem_fun (*this, &NotificationsView::queue_relayout)));
+        m_scrolled_window_connections.push_back (
+                adjustment->signal_changed ().connect (sigc::mem_fun (*this, &NotificationsView::queue_relayout)));
+    }
+    queue_relayout ();
+}
+
+void
+NotificationsView::queue_relayout ()
+{
+    if (m_relayout_connection.connected ()) return;
+    m_relayout_connection = Glib::signal_idle ().connect ([this] () {
+        relayout ();
+        return false;
+    });
+}
+
+int
+NotificationsView::get_height (size_t index) const
+{
+    return m_heights[index] > 0 ? m_heights[index] : ESTIMATED_ROW_HEIGHT;
+}
+
+void
+NotificationsView::relayout ()
+{
+    if (!m_model) return;
+
+    // Visible area in the view's coordinates (everything is visible if the view isn't scrolled)
+    int top = INT_MIN;
+    int bottom = INT_MAX;
+    int x, y;
+    if (m_scrolled_window && m_scrolled_window->get_child () &&
+        translate_coordinates (*m_scrolled_window->get_child (), 0, 0, x, y)) {
+        int page_size = static_cast<int> (m_scrolled_window->get_vadjustment ()->get_page_size ());
+        top = -y - OVERSCAN;
+        bottom = page_size - y + OVERSCAN;
+    }
+
+    // Rows intersecting the visible area, the top spacer starts at 0
+    size_t count = m_heights.size ();
+    size_t first = 0;
+    int    pos = 0;
+    while (first < count && pos + get_height (first) <= top) pos += get_height (first++);
+    size_t last = first;
+    while (last < count && pos < bottom) pos += get_height (last++);
+
+    // Release rows which have been scrolled out of view
+    for (size_t i = 0; i < m_bound.size (); i++) {
+        size_t index = m_first + i;
+        if (m_bound[i] && (index < first || index >= last)) {
+            remove (*m_bound[i]);
+            release_row (m_bound[i]);
+        }
+    }
+
+    // Keep rows which are still visible, bind (reused) rows for the others
+    std::deque<std::shared_ptr<Widgets::NotificationRow>> bound;
+    auto                                                   children = m_model->children ();
+    for (size_t index = first; index < last; index++) {
+        if (index >= m_first && index < m_first + m_bound.size () && m_bound[index - m_first]) {
+            bound.push_back (m_bound[index - m_first]);
+        } else {
+            auto row = take_row ();
+            row->update (children[index]);
+            insert (*row, static_cast<int> (1 + index - first));
+            row->show_all ();
+            bound.push_back (row);
+        }
+
+        if (m_heights[index] == 0 && m_width > 0) {
+            int minimum, natural;
+            bound.back ()->get_preferred_height_for_width (m_width, minimum, natural);
+            m_heights[index] = natural;
+        }
+    }
+    m_bound = std::move (bound);
+    m_first = first;
+
+    int top_height = 0, bottom_height = 0;
+    for (size_t index = 0; index < first; index++) top_height += get_height (index);
+    for (size_t index = last; index < count; index++) bottom_height += get_height (index);
+    m_top_spacer.set_size_request (-1, top_height);
+    m_top_spacer.set_visible (top_height > 0);
+    m_bottom_spacer.set_size_request (-1, bottom_height);
+    m_bottom_spacer.set_visible (bottom_height > 0);
+}
+
+void
+NotificationsView::clear_rows ()
+{
+    for (const auto& row : m_bound) {
+        if (!row) continue;
+        remove (*row);
+        release_row (row);
+    }
+    m_bound.clear ();
+    m_first = 0;
+    queue_relayout ();
+}
+
+std::shared_ptr<App::Widgets::NotificationRow>
+NotificationsView::take_row ()
+{
+    if (m_pool.empty ()) return Widgets::NotificationRow::create (m_model);
+
+    auto row = m_pool.back ();
+    m_pool.pop_back ();
+    return row;
+}
+
+void
+NotificationsView::release_row (const std::shared_ptr<Widgets::NotificationRow>& row)
+{
+    // Rows beyond the pool's size are destroyed
+    if (m_pool.size () < MAX_POOL_SIZE) m_pool.push_back (row);
+}
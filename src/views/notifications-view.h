@@ -21,14 +21,24 @@
 #pragma once
 
 #include <gtkmm.h>
+#include <deque>
+#include <vector>
 #include "../models/notifications-list.h"
 
 namespace App {
+namespace Widgets {
+class NotificationRow;
+} // namespace Widgets
+
 namespace Views {
 
 /**
  * @brief A list showing a list of most recent notifications
  *
+ * Only the rows close to the visible part of the surrounding scrolled window are created. Rows scrolled out of view are
+ * reused for other notifications, the space of all other rows is taken up by two spacers. Heights of rows which
+ * haven't been shown yet are estimated, they are measured once a row is shown.
+ *
  * Connected to the following model: @p App::Models::NotificationsList
  */
 class NotificationsView : public Gtk::ListBox {
@@ -37,7 +47,7 @@ class NotificationsView : public Gtk::ListBox {
      * @brief Create a list of notifications
      */
     NotificationsView ();
-    ~NotificationsView () {}
+    ~NotificationsView ();
 
     /** Update the model */
     void update (const Glib::RefPtr<Models::NotificationsList>& model);
@@ -46,13 +56,42 @@ class NotificationsView : public Gtk::ListBox {
     NotificationsView& operator= (const NotificationsView&) = delete;
 
   private:
-    Glib::RefPtr<Models::NotificationsList>     m_model;
-    std::list<sigc::connection>                 m_model_connections;
-    std::list<std::shared_ptr<Gtk::ListBoxRow>> m_row_refs;
-
     void on_row_inserted (const Gtk::TreeModel::Path& path, const Gtk::TreeModel::iterator& it);
     void on_row_deleted (const Gtk::TreeModel::Path& path);
     void on_row_changed (const Gtk::TreeModel::Path& path, const Gtk::TreeModel::iterator& it);
+    void on_size_allocate_view (Gtk::Allocation& allocation);
+    void on_hierarchy_changed_view (Gtk::Widget* previous_toplevel);
+
+    /** @brief Update the shown rows once the main loop is idle (only once, no matter how often this is called) */
+    void queue_relayout ();
+    void relayout ();
+    /** @brief Unbind all rows, they are bound again by the next relayout */
+    void clear_rows ();
+    std::shared_ptr<Widgets::NotificationRow> take_row ();
+    void                                      release_row (const std::shared_ptr<Widgets::NotificationRow>& row);
+    int                                       get_height (size_t index) const;
+
+    Glib::RefPtr<Models::NotificationsList> m_model;
+    std::list<sigc::connection>             m_model_connections;
+
+    // Adjustment of the scrolled window the view is placed in
+    Gtk::ScrolledWindow*        m_scrolled_window;
+    std::list<sigc::connection> m_scrolled_window_connections;
+    sigc::connection            m_relayout_connection;
+
+    // Take up the space of the rows before and after the bound rows
+    Gtk::ListBoxRow m_top_spacer;
+    Gtk::ListBoxRow m_bottom_spacer;
+
+    // Rows bound to the model rows [m_first, m_first + m_bound.size ()), in order (nullptr for inserted model rows which
+    // haven't been bound yet)
+    size_t                                                 m_first;
+    std::deque<std::shared_ptr<Widgets::NotificationRow>> m_bound;
+    // Unbound rows, kept for being reused
+    std::vector<std::shared_ptr<Widgets::NotificationRow>> m_pool;
+    // Measured height of every model row, 0 if it hasn't been measured yet
+    std::vector<int> m_heights;
+    int              m_width;
 };
 
 } // namespace Views
@@ -24,57 +24,8 @@ using namespace App::Views;
 
 namespace {
 
-class ContactRow : public Gtk::Grid {
-  public:
-    ContactRow (const App::Models::SMSStorage::Contact& contact)
-        : Gtk::Grid ()
-        , m_avatar (granite_widgets_avatar_new_with_default_icon (32), g_object_unref)
-    {
-        // Sink reference
-        g_object_ref_sink (m_avatar.get ());
-
-        set_margin_top (6);
-        set_margin_left (6);
-        set_margin_right (6);
-        set_margin_bottom (6);
-        set_column_spacing (6);
-        set_row_spacing (3);
-
-        // Layout
-        gtk_widget_set_size_request (GTK_WIDGET (m_avatar.get ()), 40, 40);
-        attach (*Glib::wrap (GTK_WIDGET (m_avatar.get ())), 0, 0, 1, 2);
-
-        if (contact.display_name == std::string ()) {
-            auto* display_name = Gtk::manage (new Gtk::Label ());
-            display_name->set_markup ("<b>" + contact.phone_numbers.front () + "</b>");
-            display_name->set_halign (Gtk::ALIGN_START);
-            display_name->set_valign (Gtk::ALIGN_CENTER);
-            display_name->set_ellipsize (Pango::ELLIPSIZE_END);
-            display_name->set_hexpand (true);
-            attach (*display_name, 1, 0, 1, 2);
-        } else {
-            auto* display_name = Gtk::manage (new Gtk::Label ());
-            display_name->set_markup ("<b>" + contact.display_name + "</b>");
-            display_name->set_halign (Gtk::ALIGN_START);
-            display_name->set_valign (Gtk::ALIGN_END);
-            display_name->set_ellipsize (Pango::ELLIPSIZE_END);
-            display_name->set_hexpand (true);
-            attach (*display_name, 1, 0, 1, 1);
- 
-            auto* phone_number = Gtk::manage (new Gtk::Label (contact.phone_numbers.front ()));
-            phone_number->get_style_context ()->add_class ("dim-label");
-            phone_number->set_halign (Gtk::ALIGN_START);
-            phone_number->set_valign (Gtk::ALIGN_START);
-            phone_number->set_ellipsize (Pango::ELLIPSIZE_END);
-            phone_number->set_hexpand (true);
-            attach (*phone_number, 1, 1, 1, 1);
-        }
-    }
-    ~ContactRow () = default;
-
-  private:
-    std::shared_ptr<GraniteWidgetsAvatar> m_avatar;
-};
+constexpr int PICKER_WIDTH = 300;
+constexpr int PICKER_HEIGHT = 390;
 
 } // namespace
 
@@ -82,6 +33,11 @@ SMSView::SMSView (const std::shared_ptr<Models::SMSStorage>& model)
     : Gtk::Bin ()
     , m_model (model)
     , m_notebook (granite_widgets_dynamic_notebook_new (), g_object_unref)
+    , m_detaching (false)
+    , m_alive (std::make_shared<bool> (true))
+    , m_picker_entry (nullptr)
+    , m_picker_view (nullptr)
+    , m_contact_search_valid (false)
 {
     // Sink reference
     g_object_ref_sink (m_notebook.get ());
@@ -92,12 +48,26 @@ SMSView::SMSView (const std::shared_ptr<Models::SMSStorage>& model)
         GRANITE_WIDGETS_DYNAMIC_NOTEBOOK_TAB_BAR_BEHAVIOR_ALWAYS);
     g_signal_connect (m_notebook.get (), "new-tab-requested", G_CALLBACK (static_on_new_tab_requested), this);
     g_signal_connect (m_notebook.get (), "close-tab-requested", G_CALLBACK (static_on_close_tab_requested), this);
+    g_signal_connect (m_notebook.get (), "tab-switched", G_CALLBACK (static_on_tab_switched), this);
 
     // Placeholder page
     create_placeholder_tab ();
+    update_placeholder_tab ();
 
     add (*Glib::wrap (GTK_WIDGET (m_notebook.get ())));
     gtk_widget_show_all (GTK_WIDGET (m_notebook.get ()));
+
+    m_messages_added_connection =
+            m_model->signal_messages_added ().connect (sigc::mem_fun (*this, &SMSView::on_messages_added));
+    m_contacts_changed_connection = m_model->signal_available_contacts_changed ().connect (
+            sigc::mem_fun (*this, &SMSView::on_available_contacts_changed));
+}
+
+SMSView::~SMSView ()
+{
+    m_messages_added_connection.disconnect ();
+    m_contacts_changed_connection.disconnect ();
+    m_reload_connection.disconnect ();
 }
 
 std::shared_ptr<SMSView>
@@ -130,51 +100,219 @@ SMSView::create_placeholder_tab ()
     m_placeholder_tab.reset (granite_widgets_tab_new ("Welcome", nullptr, GTK_WIDGET (m_placeholder->gobj ())),
                              g_object_unref);
     g_object_ref_sink (m_placeholder_tab.get ());
-    granite_widgets_dynamic_notebook_insert_tab (m_notebook.get (), m_placeholder_tab.get (), 0);
+}
+
+void
+SMSView::update_placeholder_tab ()
+{
+    auto it = m_device ? m_device_tabs.find (m_device->get_device_id ()) : m_device_tabs.end ();
+    bool empty = it == m_device_tabs.end () || it->second.conversations.empty ();
+    bool shown = granite_widgets_dynamic_notebook_get_tab_position (m_notebook.get (), m_placeholder_tab.get ()) >= 0;
+
+    if (empty && !shown) {
+        granite_widgets_dynamic_notebook_insert_tab (m_notebook.get (), m_placeholder_tab.get (), 0);
+    } else if (!empty && shown) {
+        m_detaching = true;
+        granite_widgets_dynamic_notebook_remove_tab (m_notebook.get (), m_placeholder_tab.get ());
+        m_detaching = false;
+    }
 }
 
 void
 SMSView::on_new_tab_requested ()
+{
+    if (!m_picker) create_contact_picker ();
+    if (!m_contact_search_valid) load_contact_picker ();
+
+    // Changing the text updates the results
+    if (m_picker_entry->get_text ().empty ())
+        update_contact_picker ();
+    else
+        m_picker_entry->set_text ("");
+    m_picker->popup ();
+    m_picker_entry->grab_focus ();
+}
+
+void
+SMSView::create_contact_picker ()
 {
     auto* btn = Glib::wrap (GTK_NOTEBOOK (gtk_bin_get_child (GTK_BIN (m_notebook.get ()))))->get_action_widget ();
-    auto popover = std::make_shared<Gtk::Popover> (*btn);
-    popover->set_position (Gtk::POS_BOTTOM);
+    m_picker = std::make_shared<Gtk::Popover> (*btn);
+    m_picker->set_position (Gtk::POS_BOTTOM);
+
+    m_picker_entry = Gtk::manage (new Gtk::SearchEntry ());
+    m_picker_entry->set_placeholder_text ("Search contacts");
+    m_picker_entry->set_margin_top (12);
+    m_picker_entry->set_margin_left (12);
+    m_picker_entry->set_margin_right (12);
+    // search-changed is delayed, the results should follow every keystroke
+    m_picker_entry->signal_changed ().connect (sigc::mem_fun (*this, &SMSView::update_contact_picker));
+
+    // A tree view only renders the visible rows, every row just stores the contact's index
+    m_picker_columns.add (m_picker_column_index);
+    m_picker_columns.add (m_picker_column_visible);
+    m_picker_store = Gtk::ListStore::create (m_picker_columns);
+    // Search results only toggle the visibility of rows, instead of refilling the store on every keystroke
+    m_picker_filter = Gtk::TreeModelFilter::create (m_picker_store);
+    m_picker_filter->set_visible_column (m_picker_column_visible);
+    m_picker_view = Gtk::manage (new Gtk::TreeView (m_picker_filter));
+    m_picker_view->set_headers_visible (false);
+    m_picker_view->set_enable_search (false);
+
+    auto* column = Gtk::manage (new Gtk::TreeViewColumn ());
+    column->set_sizing (Gtk::TREE_VIEW_COLUMN_FIXED);
+    m_picker_cell_avatar.property_icon_name ().set_value ("avatar-default");
+    m_picker_cell_avatar.property_stock_size ().set_value (Gtk::ICON_SIZE_DND);
+    m_picker_cell_avatar.property_xpad ().set_value (6);
+    m_picker_cell_avatar.property_ypad ().set_value (6);
+    column->pack_start (m_picker_cell_avatar, false);
+    m_picker_cell_text.property_ellipsize ().set_value (Pango::ELLIPSIZE_END);
+    column->pack_start (m_picker_cell_text, true);
+    column->set_cell_data_func (m_picker_cell_text, sigc::mem_fun (*this, &SMSView::cell_data_func_contact));
+    m_picker_view->append_column (*column);
+    // All rows have the same height, so the rows don't need to be measured
+    m_picker_view->set_fixed_height_mode (true);
 
     auto* scrolled_window = Gtk::manage (new Gtk::ScrolledWindow ());
-    auto* listbox = Gtk::manage (new Gtk::ListBox ());
-    listbox->set_margin_top (12);
-    listbox->set_margin_left (12);
-    listbox->set_margin_right (12);
-    listbox->set_margin_bottom (12);
-    listbox->set_selection_mode (Gtk::SELECTION_BROWSE);
-    for (const auto& contact : m_model->get_available_contacts ())
-        listbox->add (*Gtk::manage (new ContactRow (contact)));
-    scrolled_window->add (*listbox);
-    scrolled_window->set_size_request (300, 390);
-    popover->add (*scrolled_window);
-
-    popover->show_all_children ();
-    m_widget_owners.push_back (popover);
-    popover->popup ();
+    scrolled_window->set_margin_top (6);
+    scrolled_window->set_margin_left (12);
+    scrolled_window->set_margin_right (12);
+    scrolled_window->set_margin_bottom (12);
+    scrolled_window->set_size_request (PICKER_WIDTH, PICKER_HEIGHT);
+    scrolled_window->add (*m_picker_view);
+
+    auto* box = Gtk::manage (new Gtk::Box (Gtk::ORIENTATION_VERTICAL));
+    box->pack_start (*m_picker_entry, false, false);
+    box->pack_start (*scrolled_window, true, true);
+    m_picker->add (*box);
+    m_picker->show_all_children ();
+}
+
+void
+SMSView::load_contact_picker ()
+{
+    m_contact_search.set_contacts (m_model->get_available_contacts ());
+    m_contact_search_valid = true;
+
+    // Detach the model while it is refilled, so the view doesn't handle every inserted row
+    m_picker_view->unset_model ();
+    m_picker_store->clear ();
+    for (size_t i = 0; i < m_contact_search.get_contacts ().size (); i++) {
+        auto row = *m_picker_store->append ();
+        row[m_picker_column_index] = static_cast<int> (i);
+        row[m_picker_column_visible] = true;
+    }
+    m_picker_visible.assign (m_contact_search.get_contacts ().size (), true);
+    m_picker_view->set_model (m_picker_filter);
+}
+
+void
+SMSView::update_contact_picker ()
+{
+    const auto& results = m_contact_search.search (m_picker_entry->get_text ());
+
+    std::vector<bool> visible (m_picker_visible.size (), false);
+    for (size_t index : results) visible[index] = true;
+
+    // Only rows whose visibility has changed are touched (rows are stored in the order of the contacts)
+    for (size_t i = 0; i < visible.size (); i++) {
+        if (visible[i] == m_picker_visible[i]) continue;
+        auto it = m_picker_store->get_iter (Gtk::TreePath (1, static_cast<int> (i)));
+        (*it)[m_picker_column_visible] = visible[i];
+    }
+    m_picker_visible = std::move (visible);
+}
+
+void
+SMSView::cell_data_func_contact (Gtk::CellRenderer* renderer, const Gtk::TreeModel::iterator& it)
+{
+    Gtk::CellRendererText& text_renderer = dynamic_cast<Gtk::CellRendererText&> (*renderer);
+
+    const auto& contact = m_contact_search.get_contacts ().at (it->get_value (m_picker_column_index));
+    std::string phone_number = contact.phone_numbers.empty () ? std::string () : contact.phone_numbers.front ();
+    if (contact.display_name.empty ())
+        text_renderer.property_markup ().set_value ("<b>" + Glib::Markup::escape_text (phone_number) + "</b>");
+    else
+        text_renderer.property_markup ().set_value ("<b>" + Glib::Markup::escape_text (contact.display_name) +
+                                                    "</b>\n<span alpha=\"70%\">" +
+                                                    Glib::Markup::escape_text (phone_number) + "</span>");
+}
+
+void
+SMSView::on_available_contacts_changed ()
+{
+    // The contacts of conversations (and therefore the tab labels) may have changed as well
+    for (auto& tabs : m_device_tabs) tabs.second.stale = true;
+    schedule_reload ();
+
+    m_contact_search_valid = false;
+    if (!m_picker || !m_picker->is_visible ()) return;
+
+    load_contact_picker ();
+    update_contact_picker ();
 }
 
 bool
 SMSView::on_close_tab_requested (GraniteWidgetsTab* tab)
 {
-    if (tab == m_placeholder_tab.get ()) return false;
+    if (m_detaching) return true;
+    if (tab == m_placeholder_tab.get () || !m_device) return false;
 
-    if (granite_widgets_dynamic_notebook_get_n_tabs (m_notebook.get ()) <= 1)
-        Glib::signal_idle ().connect_once ([this] () { create_placeholder_tab (); });
+    // The notebook still uses the tab, so it is only dropped from the cache afterwards
+    std::string         device_id = m_device->get_device_id ();
+    std::weak_ptr<bool> alive = m_alive;
+    Glib::signal_idle ().connect_once ([this, alive, device_id, tab] () {
+        if (alive.expired ()) return;
+        auto& tabs = m_device_tabs[device_id];
+        for (auto it = tabs.conversations.begin (); it != tabs.conversations.end (); ++it) {
+            if (it->tab.get () != tab) continue;
+            tabs.closed.insert (it->phone_number);
+            tabs.conversations.erase (it);
+            break;
+        }
+        if (m_device && m_device->get_device_id () == device_id) update_placeholder_tab ();
+    });
 
     return true;
 }
 
+SMSView::ConversationTab*
+SMSView::find_tab (GraniteWidgetsTab* tab)
+{
+    if (!m_device || !tab) return nullptr;
+
+    auto it = m_device_tabs.find (m_device->get_device_id ());
+    if (it == m_device_tabs.end ()) return nullptr;
+    for (auto& conversation : it->second.conversations)
+        if (conversation.tab.get () == tab) return &conversation;
+    return nullptr;
+}
+
+void
+SMSView::on_tab_switched (GraniteWidgetsTab* new_tab)
+{
+    ConversationTab* conversation = find_tab (new_tab);
+    if (!conversation || conversation->view) return;
+
+    // First time the conversation is shown
+    conversation->view = std::make_shared<ConversationView> (m_model, m_device, conversation->phone_number);
+    conversation->page->pack_start (*conversation->view, true, true);
+    conversation->view->show ();
+}
+
 void
 SMSView::static_on_new_tab_requested (GraniteWidgetsDynamicNotebook* sender, SMSView* self)
 {
     self->on_new_tab_requested ();
 }
 
+void
+SMSView::static_on_tab_switched (GraniteWidgetsDynamicNotebook* sender, GraniteWidgetsTab* old_tab,
+                                 GraniteWidgetsTab* new_tab, SMSView* self)
+{
+    self->on_tab_switched (new_tab);
+}
+
 gboolean
 SMSView::static_on_close_tab_requested (GraniteWidgetsDynamicNotebook* sender, GraniteWidgetsTab* tab, SMSView* self)
 {
@@ -184,26 +322,147 @@ SMSView::static_on_close_tab_requested (GraniteWidgetsDynamicNotebook* sender, G
 void
 SMSView::set_device (const std::shared_ptr<Conecto::Device>& device)
 {
+    if (device == m_device) {
+        refresh_device ();
+        return;
+    }
+
+    detach_tabs ();
     m_device = device;
+    attach_tabs ();
+}
+
+void
+SMSView::detach_tabs ()
+{
+    if (!m_device) return;
+
+    // Tabs are removed without closing them, they are attached again when the device is shown
+    auto& tabs = m_device_tabs[m_device->get_device_id ()];
+    tabs.current = granite_widgets_dynamic_notebook_get_current (m_notebook.get ());
+    m_detaching = true;
+    for (const auto& conversation : tabs.conversations)
+        granite_widgets_dynamic_notebook_remove_tab (m_notebook.get (), conversation.tab.get ());
+    m_detaching = false;
+}
 
-    auto conversations = m_model->get_conversation_contacts (*device);
-    {
-        int count = granite_widgets_dynamic_notebook_get_n_tabs (m_notebook.get ());
-        for (int i = 0; i < count; i++)
-            granite_widgets_dynamic_notebook_remove_tab (m_notebook.get (),
-                granite_widgets_dynamic_notebook_get_tab_by_index (m_notebook.get (), 0));
+void
+SMSView::attach_tabs ()
+{
+    m_reload_connection.disconnect ();
+    if (!m_device) {
+        update_placeholder_tab ();
+        return;
     }
 
-    if (conversations.empty ()) {
-        create_placeholder_tab ();
-    } else {
-        for (const auto& contact : conversations) {
-            std::string display = contact.display_name == std::string () ? contact.phone_numbers.front () : contact.display_name;
-            auto lbl = std::make_shared<Gtk::Label> (display);
-            GraniteWidgetsTab* tab = granite_widgets_tab_new (display.c_str (), nullptr, GTK_WIDGET (lbl->gobj ()));
-            m_widget_owners.push_back (lbl);
-            granite_widgets_dynamic_notebook_insert_tab (m_notebook.get (), tab,
-                                                         granite_widgets_dynamic_notebook_get_n_tabs (m_notebook.get ()) - 1);
+    auto& tabs = m_device_tabs[m_device->get_device_id ()];
+    for (const auto& conversation : tabs.conversations)
+        granite_widgets_dynamic_notebook_insert_tab (m_notebook.get (), conversation.tab.get (),
+                                                     granite_widgets_dynamic_notebook_get_n_tabs (m_notebook.get ()));
+    update_placeholder_tab ();
+    if (tabs.current && find_tab (tabs.current)) {
+        granite_widgets_dynamic_notebook_set_current (m_notebook.get (), tabs.current);
+        on_tab_switched (tabs.current);
+    }
+
+    if (!tabs.loaded || tabs.stale) refresh_device ();
+}
+
+void
+SMSView::refresh_device ()
+{
+    if (!m_device) return;
+
+    auto& tabs = m_device_tabs[m_device->get_device_id ()];
+    tabs.stale = false;
+    for (const auto& conversation : tabs.conversations)
+        if (conversation.view) conversation.view->load_newer ();
+    load_conversations ();
+}
+
+void
+SMSView::load_conversations ()
+{
+    std::shared_ptr<Conecto::Device> device = m_device;
+    std::weak_ptr<bool>              alive = m_alive;
+    m_model->get_conversation_contacts (
+            *device, [this, alive, device] (std::vector<Models::SMSStorage::Contact> conversations) {
+                // The view might have been destroyed in the meantime
+                if (alive.expired ()) return;
+                show_conversations (device->get_device_id (), conversations);
+            });
+}
+
+void
+SMSView::on_messages_added (const std::string& device_id)
+{
+    auto it = m_device_tabs.find (device_id);
+    if (it == m_device_tabs.end ()) return;
+
+    it->second.stale = true;
+    if (m_device && m_device->get_device_id () == device_id) schedule_reload ();
+}
+
+void
+SMSView::schedule_reload ()
+{
+    if (!m_device || m_reload_connection.connected ()) return;
+
+    // A sync writes many chunks in a row (and contacts are reported one by one), only reload once they have settled
+    m_reload_connection = Glib::signal_timeout ().connect (
+            [this] () {
+                refresh_device ();
+                return false;
+            },
+            500);
+}
+
+void
+SMSView::show_conversations (const std::string&                               device_id,
+                             const std::vector<Models::SMSStorage::Contact>& conversations)
+{
+    auto& tabs = m_device_tabs[device_id];
+    bool  attached = m_device && m_device->get_device_id () == device_id;
+    tabs.loaded = true;
+
+    std::map<std::string, ConversationTab*> open;
+    for (auto& conversation : tabs.conversations) open[conversation.phone_number] = &conversation;
+
+    // Existing tabs (and their loaded messages) are kept, only new conversations are added
+    for (const auto& contact : conversations) {
+        const std::string& phone_number = contact.phone_numbers.front ();
+        std::string        display = contact.display_name.empty () ? phone_number : contact.display_name;
+
+        auto existing = open.find (phone_number);
+        if (existing != open.end ()) {
+            // The number may have been matched with a (different) contact since the tab has been created
+            if (existing->second->label != display) {
+                existing->second->label = display;
+                granite_widgets_tab_set_label (existing->second->tab.get (), display.c_str ());
+            }
+            continue;
         }
+        if (tabs.closed.count (phone_number)) continue;
+
+        ConversationTab conversation;
+        conversation.phone_number = phone_number;
+        conversation.label = display;
+        conversation.page = std::make_shared<Gtk::Box> (Gtk::ORIENTATION_VERTICAL, 0);
+        conversation.page->show ();
+        conversation.tab.reset (granite_widgets_tab_new (display.c_str (), nullptr,
+                                                         GTK_WIDGET (conversation.page->gobj ())),
+                                g_object_unref);
+        g_object_ref_sink (conversation.tab.get ());
+        if (attached)
+            granite_widgets_dynamic_notebook_insert_tab (
+                    m_notebook.get (), conversation.tab.get (),
+                    granite_widgets_dynamic_notebook_get_n_tabs (m_notebook.get ()));
+        tabs.conversations.push_back (std::move (conversation));
     }
-}
\ No newline at end of file
+
+    if (attached) {
+        update_placeholder_tab ();
+        // The notebook doesn't report the selection of the first inserted tab
+        on_tab_switched (granite_widgets_dynamic_notebook_get_current (m_notebook.get ()));
+    }
+}
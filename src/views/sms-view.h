@@ -23,6 +23,10 @@
 #include <gtkmm.h>
 #include <granite.h>
 #include "../models/sms-storage.h"
+#include "../models/contact-search.h"
+#include "conversation-view.h"
+#include <map>
+#include <set>
 
 namespace App {
 namespace Views {
@@ -38,7 +42,7 @@ class SMSView : public Gtk::Bin {
      * @brief Create an SMS view
      */
     static std::shared_ptr<SMSView> create (const std::shared_ptr<Models::SMSStorage>& model);
-    ~SMSView () {}
+    ~SMSView ();
 
     /**
      * @brief Set the current device
@@ -51,11 +55,61 @@ class SMSView : public Gtk::Bin {
   private:
     SMSView (const std::shared_ptr<Models::SMSStorage>& model);
 
+    /**
+     * @brief An open conversation, the messages are only loaded when the tab is selected for the first time
+     */
+    struct ConversationTab {
+        std::string                        phone_number;
+        // The contact's name (or the phone number if unknown), updated when the contacts change
+        std::string                        label;
+        std::shared_ptr<GraniteWidgetsTab> tab;
+        std::shared_ptr<Gtk::Box>          page;
+        std::shared_ptr<ConversationView>  view;
+    };
+
+    /**
+     * @brief The tabs of a device, kept while another device is shown
+     */
+    struct DeviceTabs {
+        DeviceTabs () : current (nullptr), loaded (false), stale (false) {}
+
+        std::list<ConversationTab> conversations;
+        // Numbers of conversations closed by the user, which are not opened again by a reload
+        std::set<std::string>      closed;
+        GraniteWidgetsTab*         current;
+        bool                       loaded;
+        // true if messages or contacts have changed while the device wasn't shown
+        bool                       stale;
+    };
+
     void create_placeholder_tab ();
+    void update_placeholder_tab ();
+    void detach_tabs ();
+    void attach_tabs ();
+    void refresh_device ();
+    void load_conversations ();
+    void on_messages_added (const std::string& device_id);
+    /**
+     * @brief Reload the conversations of the current device once changes have settled
+     */
+    void schedule_reload ();
+    void show_conversations (const std::string& device_id, const std::vector<Models::SMSStorage::Contact>& conversations);
+    ConversationTab* find_tab (GraniteWidgetsTab* tab);
+    void on_tab_switched (GraniteWidgetsTab* new_tab);
 
     void on_new_tab_requested ();
+    void create_contact_picker ();
+    /**
+     * @brief Rebuild the search index and the picker's rows from the available contacts
+     */
+    void load_contact_picker ();
+    void update_contact_picker ();
+    void cell_data_func_contact (Gtk::CellRenderer* renderer, const Gtk::TreeModel::iterator& it);
+    void on_available_contacts_changed ();
     bool on_close_tab_requested (GraniteWidgetsTab* tab);
     static void static_on_new_tab_requested (GraniteWidgetsDynamicNotebook* sender, SMSView* self);
+    static void static_on_tab_switched (GraniteWidgetsDynamicNotebook* sender, GraniteWidgetsTab* old_tab,
+                                        GraniteWidgetsTab* new_tab, SMSView* self);
     static gboolean static_on_close_tab_requested (GraniteWidgetsDynamicNotebook* sender, GraniteWidgetsTab* tab,
                                                    SMSView* self);
 
@@ -64,8 +118,32 @@ class SMSView : public Gtk::Bin {
     std::shared_ptr<Gtk::Box>                      m_placeholder;
     std::shared_ptr<GraniteWidgetsTab>             m_placeholder_tab;
     std::shared_ptr<Conecto::Device>               m_device;
+    // Tabs of every device which has been shown, by device id
+    std::map<std::string, DeviceTabs> m_device_tabs;
+    // true while tabs are removed from the notebook without being closed
+    bool m_detaching;
+    // Expires when the view is destroyed, checked by asynchronous model callbacks
+    std::shared_ptr<bool> m_alive;
+    sigc::connection      m_messages_added_connection;
+    sigc::connection      m_reload_connection;
+    sigc::connection      m_contacts_changed_connection;
 
-    std::list<std::shared_ptr<Gtk::Widget>> m_widget_owners;
+    // Contact picker, created on first use
+    std::shared_ptr<Gtk::Popover>      m_picker;
+    Gtk::SearchEntry*                  m_picker_entry;
+    Gtk::TreeView*                     m_picker_view;
+    Gtk::TreeModelColumn<int>          m_picker_column_index;
+    Gtk::TreeModelColumn<bool>         m_picker_column_visible;
+    Gtk::TreeModelColumnRecord         m_picker_columns;
+    Glib::RefPtr<Gtk::ListStore>       m_picker_store;
+    Glib::RefPtr<Gtk::TreeModelFilter> m_picker_filter;
+    Gtk::CellRendererPixbuf            m_picker_cell_avatar;
+    Gtk::CellRendererText              m_picker_cell_text;
+    Models::ContactSearch              m_contact_search;
+    // Whether the row of the contact with the same index is visible
+    std::vector<bool> m_picker_visible;
+    // false if the available contacts have changed since the search index has been built
+    bool m_contact_search_valid;
 };
 
 } // namespace Views
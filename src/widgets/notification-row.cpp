@@ -22,6 +22,13 @@
 
 using namespace App::Widgets;
 
+namespace {
+
+// Size of the app icon (in pixels)
+constexpr int ICON_SIZE = 24;
+
+} // namespace
+
 NotificationRow::NotificationRow (const Glib::RefPtr<Models::NotificationsList>& model)
     : Gtk::ListBoxRow ()
     , m_model (model)
@@ -31,6 +38,7 @@ NotificationRow::NotificationRow (const Glib::RefPtr<Models::NotificationsList>&
     , m_lbl_text (nullptr)
     , m_lbl_time (nullptr)
     , m_lbl_app_name (nullptr)
+    , m_img_icon (nullptr)
     , m_btn_dismiss (nullptr)
 {
     Gtk::Grid* widget = nullptr;
@@ -39,6 +47,7 @@ NotificationRow::NotificationRow (const Glib::RefPtr<Models::NotificationsList>&
     m_builder->get_widget ("lbl_text", m_lbl_text);
     m_builder->get_widget ("lbl_time", m_lbl_time);
     m_builder->get_widget ("lbl_app_name", m_lbl_app_name);
+    m_builder->get_widget ("img_icon", m_img_icon);
     m_builder->get_widget ("btn_dismiss", m_btn_dismiss);
     add (*widget);
 
@@ -59,12 +68,20 @@ void
 NotificationRow::update (const Gtk::TreeIter& iter)
 {
     m_id = iter->get_value (m_model->column_id);
-    m_lbl_title->set_label ("<b>" + iter->get_value (m_model->column_title) + "</b>");
-    m_lbl_time->set_label (iter->get_value (m_model->column_time));
-    Glib::ustring message = iter->get_value (m_model->column_body);
-    m_lbl_text->set_visible (message != Glib::ustring ());
-    m_lbl_text->set_label (message);
-    m_lbl_app_name->set_label (iter->get_value (m_model->column_app_name));
+    const auto* notification = m_model->get_notification (m_id);
+    if (!notification) return;
+
+    m_lbl_title->set_label ("<b>" + Glib::ustring (notification->title) + "</b>");
+    m_lbl_time->set_label (notification->time.format ("%X"));
+    m_lbl_text->set_visible (!notification->body.empty ());
+    m_lbl_text->set_label (notification->body);
+    m_lbl_app_name->set_label (notification->app_name);
+
+    auto icon = m_model->get_icon (*notification);
+    if (icon)
+        m_img_icon->set (icon->scale_simple (ICON_SIZE, ICON_SIZE, Gdk::INTERP_BILINEAR));
+    else
+        m_img_icon->set_from_icon_name ("application-x-executable", Gtk::ICON_SIZE_LARGE_TOOLBAR);
 }
 
 void
@@ -54,6 +54,7 @@ class NotificationRow : public Gtk::ListBoxRow {
     Gtk::Label*  m_lbl_text;
     Gtk::Label*  m_lbl_time;
     Gtk::Label*  m_lbl_app_name;
+    Gtk::Image*  m_img_icon;
     Gtk::Button* m_btn_dismiss;
 
     // Current id
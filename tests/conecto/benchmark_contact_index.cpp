@@ -0,0 +1,91 @@
+/* benchmark_contact_index.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+#include <glib.h>
+#include <algorithm>
+#include "../../src/models/contact-index.h"
+
+using namespace App::Models;
+
+namespace {
+
+// The size of a large address book
+constexpr size_t N_CONTACTS = 10000;
+constexpr int    N_ROUNDS = 5;
+
+std::string
+get_subscriber_number (size_t i)
+{
+    return std::to_string (1000000 + i);
+}
+
+/**
+ * Notations the phone or the address book may use for the number of contact @p i
+ */
+std::vector<std::string>
+get_notations (size_t i)
+{
+    std::string number = get_subscriber_number (i);
+    return {
+        "+49 170 " + number,
+        "0170" + number,
+        "+49170" + number,
+        "0049 (170) " + number.substr (0, 3) + "-" + number.substr (3),
+    };
+}
+
+} // namespace
+
+TEST (ContactIndexBenchmark, find_by_phone_number)
+{
+    ContactIndex index;
+    int64_t      start = g_get_monotonic_time ();
+    for (size_t i = 0; i < N_CONTACTS; i++) {
+        index.set (std::to_string (i), "Contact " + std::to_string (i),
+                   std::vector<std::string> ({ get_notations (i)[i % 4] }));
+    }
+    double index_seconds = (g_get_monotonic_time () - start) / 1e6;
+    RecordProperty ("index_ms", static_cast<int> (index_seconds * 1000));
+    EXPECT_LT (index_seconds, 1.0);
+
+    // Look up every contact in every notation, as done for each conversation and incoming message
+    std::vector<std::string> numbers;
+    for (size_t i = 0; i < N_CONTACTS; i++) {
+        auto notations = get_notations (i);
+        numbers.insert (numbers.end (), notations.begin (), notations.end ());
+    }
+    std::vector<double> durations;
+    size_t              n_found = 0;
+    for (int round = 0; round < N_ROUNDS; round++) {
+        n_found = 0;
+        start = g_get_monotonic_time ();
+        for (const auto& number : numbers)
+            if (index.find_by_phone_number (number)) n_found++;
+        durations.push_back ((g_get_monotonic_time () - start) / 1e6);
+    }
+    ASSERT_EQ (n_found, numbers.size ());
+    ASSERT_EQ (index.find_by_phone_number ("+49 170 " + get_subscriber_number (42))->display_name, "Contact 42");
+
+    std::sort (durations.begin (), durations.end ());
+    double lookup_seconds = durations[durations.size () / 2] / numbers.size ();
+    RecordProperty ("lookup_ns", static_cast<int> (lookup_seconds * 1e9));
+    EXPECT_LT (lookup_seconds, 10e-6);
+}
@@ -0,0 +1,237 @@
+/* benchmark_sms_storage.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include "../../src/models/sms-storage.h"
+#include "../test_helpers.h"
+
+using namespace App::Models;
+using Testing::TemporaryDirectory;
+
+namespace {
+
+// The history stored before the benchmark, spread across conversations
+constexpr int64_t N_STORED = 1000000;
+constexpr int64_t N_CONVERSATIONS = 1000;
+constexpr int64_t STORE_CHUNK_SIZE = 100000;
+// The number of messages synced into the full database
+constexpr int64_t N_SYNCED = 100000;
+constexpr size_t  PAGE_SIZE = 50;
+
+const char* const WORDS[] = { "hello", "see", "you", "tomorrow", "meeting", "dinner", "train", "late", "call", "ok" };
+
+std::string
+get_phone_number (int64_t thread_id)
+{
+    return "+49 170 " + std::to_string (1000000 + thread_id);
+}
+
+std::string
+get_text (int64_t id)
+{
+    std::string res;
+    for (int i = 0; i < 6; i++) {
+        if (i > 0) res += ' ';
+        res += WORDS[(id / (i + 1) + i) % G_N_ELEMENTS (WORDS)];
+    }
+    return res;
+}
+
+template <typename T>
+T
+wait_for (const std::function<void (std::function<void (T)>)>& request)
+{
+    bool finished = false;
+    T    res;
+    request ([&finished, &res] (T value) {
+        res = std::move (value);
+        finished = true;
+    });
+    while (!finished) Glib::MainContext::get_default ()->iteration (true);
+    return res;
+}
+
+/**
+ * Run @p request and return the time until it has been completed in seconds
+ */
+double
+measure (const std::function<void (std::function<void (bool)>)>& request)
+{
+    int64_t start = g_get_monotonic_time ();
+    wait_for<bool> (request);
+    return (g_get_monotonic_time () - start) / 1e6;
+}
+
+class SMSStorageBenchmark : public testing::Test {
+  protected:
+    static void
+    SetUpTestCase ()
+    {
+        s_directory = new TemporaryDirectory ("conecto-sms-benchmark-XXXXXX");
+        s_device = Testing::create_device ();
+        s_storage = new SMSStorage (Glib::build_filename (s_directory->get_path (), "sms-storage.db"),
+                                    Glib::build_filename (s_directory->get_path (), "contacts.cache"));
+
+        for (int64_t chunk_start = 0; chunk_start < N_STORED; chunk_start += STORE_CHUNK_SIZE) {
+            std::vector<Conecto::Plugins::SMSMessage> messages;
+            messages.reserve (STORE_CHUNK_SIZE);
+            for (int64_t id = chunk_start; id < chunk_start + STORE_CHUNK_SIZE; id++) {
+                int64_t thread_id = id % N_CONVERSATIONS;
+                messages.push_back (
+                        { get_text (id), get_phone_number (thread_id), id * 1000, id % 2 == 0, true, thread_id, id });
+            }
+            wait_for<bool> ([&messages] (std::function<void (bool)> done) {
+                s_storage->store_messages (*s_device, std::move (messages), done);
+            });
+        }
+    }
+
+    static void
+    TearDownTestCase ()
+    {
+        delete s_storage;
+        s_storage = nullptr;
+        s_device.reset ();
+        // Removes the database (including its WAL files, which are kept until the storage is closed)
+        delete s_directory;
+        s_directory = nullptr;
+    }
+
+    static TemporaryDirectory*              s_directory;
+    static std::shared_ptr<Conecto::Device> s_device;
+    static SMSStorage*                      s_storage;
+};
+
+TemporaryDirectory*              SMSStorageBenchmark::s_directory = nullptr;
+std::shared_ptr<Conecto::Device> SMSStorageBenchmark::s_device;
+SMSStorage*                      SMSStorageBenchmark::s_storage = nullptr;
+
+} // namespace
+
+TEST_F (SMSStorageBenchmark, ingest)
+{
+    auto create_messages = [] () {
+        std::vector<SMSStorage::SMS> res;
+        res.reserve (N_SYNCED);
+        for (int64_t id = N_STORED; id < N_STORED + N_SYNCED; id++) {
+            int64_t thread_id = id % N_CONVERSATIONS;
+            res.emplace_back (get_text (id), get_phone_number (thread_id), SMSStorage::SMS::FROM_CONTACT,
+                              Glib::DateTime::create_now_utc (id), thread_id, id);
+        }
+        return res;
+    };
+
+    auto inserted = wait_for<SMSStorage::IngestResult> (
+            [&create_messages] (std::function<void (SMSStorage::IngestResult)> done) {
+                s_storage->add_sms_messages (*s_device, create_messages (), done);
+            });
+    EXPECT_EQ (inserted.n_inserted, static_cast<size_t> (N_SYNCED));
+    RecordProperty ("ingest_ms", static_cast<int> (inserted.seconds * 1000));
+    EXPECT_LT (inserted.seconds, 10.0);
+
+    // Syncing the same messages again only finds duplicates
+    auto skipped = wait_for<SMSStorage::IngestResult> (
+            [&create_messages] (std::function<void (SMSStorage::IngestResult)> done) {
+                s_storage->add_sms_messages (*s_device, create_messages (), done);
+            });
+    EXPECT_EQ (skipped.n_skipped, static_cast<size_t> (N_SYNCED));
+    RecordProperty ("ingest_duplicates_ms", static_cast<int> (skipped.seconds * 1000));
+    EXPECT_LT (skipped.seconds, 5.0);
+}
+
+TEST_F (SMSStorageBenchmark, read_page)
+{
+    auto                buffer = std::make_shared<std::vector<SMSStorage::MessageRow>> ();
+    SMSStorage::PageKey from = SMSStorage::PageKey::newest ();
+    std::vector<double> durations;
+    for (int i = 0; i < 20; i++) {
+        durations.push_back (measure ([&buffer, &from] (std::function<void (bool)> done) {
+            s_storage->read_conversation_page (
+                    *s_device, get_phone_number (0), from, SMSStorage::PageDirection::OLDER, PAGE_SIZE, buffer,
+                    [&from, done] (const std::shared_ptr<std::vector<SMSStorage::MessageRow>>& rows, size_t n_rows) {
+                        if (n_rows > 0) from = (*rows)[n_rows - 1].get_key ();
+                        done (true);
+                    });
+        }));
+    }
+    std::sort (durations.begin (), durations.end ());
+    RecordProperty ("read_page_median_us", static_cast<int> (durations[durations.size () / 2] * 1e6));
+    EXPECT_LT (durations[durations.size () / 2], 0.05);
+}
+
+TEST_F (SMSStorageBenchmark, conversations)
+{
+    double seconds = measure ([] (std::function<void (bool)> done) {
+        s_storage->get_conversations (*s_device, [done] (std::vector<SMSStorage::Conversation> conversations) {
+            EXPECT_EQ (conversations.size (), static_cast<size_t> (N_CONVERSATIONS));
+            done (true);
+        });
+    });
+    RecordProperty ("conversations_ms", static_cast<int> (seconds * 1000));
+    EXPECT_LT (seconds, 0.1);
+}
+
+TEST_F (SMSStorageBenchmark, search)
+{
+    double seconds = measure ([] (std::function<void (bool)> done) {
+        s_storage->search_messages ("tomorrow din", 0, 20, [done] (std::vector<SMSStorage::SearchHit> hits) {
+            EXPECT_EQ (hits.size (), 20u);
+            done (true);
+        });
+    });
+    RecordProperty ("search_ms", static_cast<int> (seconds * 1000));
+    EXPECT_LT (seconds, 1.0);
+}
+
+TEST_F (SMSStorageBenchmark, latest_messages)
+{
+    std::vector<double> durations;
+    for (int64_t thread_id = 0; thread_id < 20; thread_id++) {
+        durations.push_back (measure ([thread_id] (std::function<void (bool)> done) {
+            s_storage->get_latest_sms_messages (*s_device, get_phone_number (thread_id),
+                                                [done] (std::list<SMSStorage::SMS> messages) {
+                                                    EXPECT_EQ (messages.size (), 20u);
+                                                    done (true);
+                                                });
+        }));
+    }
+    std::sort (durations.begin (), durations.end ());
+    RecordProperty ("latest_messages_median_us", static_cast<int> (durations[durations.size () / 2] * 1e6));
+    EXPECT_LT (durations[durations.size () / 2], 0.05);
+}
+
+TEST_F (SMSStorageBenchmark, add_sms)
+{
+    // Messages sent or received while the app is running are added one at a time
+    constexpr int64_t N_ADDED = 1000;
+
+    double seconds = measure ([] (std::function<void (bool)> done) {
+        for (int64_t id = 2 * N_STORED; id < 2 * N_STORED + N_ADDED; id++) {
+            s_storage->add_sms (*s_device, SMSStorage::SMS (get_text (id), get_phone_number (id % N_CONVERSATIONS),
+                                                            SMSStorage::SMS::FROM_CONTACT,
+                                                            Glib::DateTime::create_now_utc (id)));
+        }
+        // Completes once all queued writes have finished
+        s_storage->store_messages (*s_device, std::vector<Conecto::Plugins::SMSMessage> (), done);
+    });
+    RecordProperty ("add_sms_us", static_cast<int> (seconds / N_ADDED * 1e6));
+    EXPECT_LT (seconds / N_ADDED, 0.01);
+}
@@ -0,0 +1,112 @@
+/* test_contact_search.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+#include <glib.h>
+#include <algorithm>
+#include "../../src/models/contact-search.h"
+
+using namespace App::Models;
+
+namespace {
+
+const char* const FIRST_NAMES[] = { "Anna", "Ben", "Clara", "David", "Emma",
+                                    "Felix", "Greta", "Hannes", "Ida", "Jonas" };
+const char* const LAST_NAMES[] = { "Müller", "Schmidt", "Schneider", "Fischer", "Weber", "Meyer", "Wagner", "Becker" };
+
+// The number of contacts used for measuring the time per keystroke
+constexpr size_t N_CONTACTS = 100000;
+
+std::vector<ContactSearch::Contact>
+create_contacts ()
+{
+    std::vector<ContactSearch::Contact> res;
+    res.emplace_back ("Anna Müller", std::vector<std::string> ({ "+49 170 1234567" }));
+    res.emplace_back ("Bob", std::vector<std::string> ({ "0170 7654321", "030 123456" }));
+    res.emplace_back ("Hannes", std::vector<std::string> ());
+    res.emplace_back ("", std::vector<std::string> ({ "+1 555 0100" }));
+    return res;
+}
+
+} // namespace
+
+TEST (ContactSearchTest, trigram_test)
+{
+    ContactSearch search;
+    search.set_contacts (create_contacts ());
+
+    using Results = std::vector<size_t>;
+    // Names are case-folded
+    ASSERT_EQ (search.search ("MÜLL"), Results ({ 0 }));
+    // Queries shorter than a trigram are matched against every contact
+    ASSERT_EQ (search.search ("an"), Results ({ 0, 2 }));
+    ASSERT_EQ (search.search ("ann"), Results ({ 0, 2 }));
+    // Extending the query filters the previous results
+    ASSERT_EQ (search.search ("anna"), Results ({ 0 }));
+    // Shortening it looks the candidates up again
+    ASSERT_EQ (search.search ("ann"), Results ({ 0, 2 }));
+    ASSERT_EQ (search.search ("xyz"), Results ());
+    ASSERT_EQ (search.search (""), Results ({ 0, 1, 2, 3 }));
+
+    // Numbers are compared digit by digit, in all phone numbers of a contact
+    ASSERT_EQ (search.search ("170 123"), Results ({ 0 }));
+    ASSERT_EQ (search.search ("(030) 12"), Results ({ 1 }));
+    ASSERT_EQ (search.search ("555-0100"), Results ({ 3 }));
+    // Matches don't span the name and a number
+    ASSERT_EQ (search.search ("bob0170"), Results ());
+    ASSERT_EQ (search.search ("bob\n0170"), Results ());
+
+    // The index is rebuilt when the contacts change
+    search.set_contacts ({ ContactSearch::Contact ("Anna Schmidt", std::vector<std::string> ()) });
+    ASSERT_EQ (search.search ("anna"), Results ({ 0 }));
+    ASSERT_EQ (search.search ("müller"), Results ());
+}
+
+TEST (ContactSearchTest, timing_test)
+{
+    std::vector<ContactSearch::Contact> contacts;
+    contacts.reserve (N_CONTACTS);
+    for (size_t i = 0; i < N_CONTACTS; i++) {
+        std::string name = std::string (FIRST_NAMES[i % G_N_ELEMENTS (FIRST_NAMES)]) + " " +
+                           LAST_NAMES[(i / G_N_ELEMENTS (FIRST_NAMES)) % G_N_ELEMENTS (LAST_NAMES)] + " " +
+                           std::to_string (i);
+        contacts.emplace_back (name, std::vector<std::string> ({ "+49 170 " + std::to_string (1000000 + i) }));
+    }
+
+    ContactSearch search;
+    int64_t       start = g_get_monotonic_time ();
+    search.set_contacts (contacts);
+    double index_seconds = (g_get_monotonic_time () - start) / 1e6;
+    RecordProperty ("index_ms", static_cast<int> (index_seconds * 1000));
+    EXPECT_LT (index_seconds, 2.0);
+
+    // Type a name character by character, every keystroke should update the results without a noticeable delay
+    const std::string typed = "hannes weber 4767";
+    double            max_seconds = 0.0;
+    size_t            n_results = 0;
+    for (size_t length = 1; length <= typed.size (); length++) {
+        start = g_get_monotonic_time ();
+        n_results = search.search (typed.substr (0, length)).size ();
+        max_seconds = std::max (max_seconds, (g_get_monotonic_time () - start) / 1e6);
+    }
+    ASSERT_EQ (n_results, 1u);
+    RecordProperty ("max_keystroke_us", static_cast<int> (max_seconds * 1e6));
+    EXPECT_LT (max_seconds, 0.05);
+}
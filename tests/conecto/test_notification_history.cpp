@@ -0,0 +1,187 @@
+/* test_notification_history.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+#include "../../src/models/notification-history.h"
+#include "../test_helpers.h"
+
+using namespace App::Models;
+using Testing::TemporaryDirectory;
+using Testing::create_device;
+
+namespace {
+
+// Retention limits of the history, small so the tests don't need to store thousands of notifications
+constexpr int MAX_AGE_DAYS = 2;
+constexpr int MAX_PER_DEVICE = 5;
+
+std::string
+get_database_path (const TemporaryDirectory& directory)
+{
+    return Glib::build_filename (directory.get_path (), "notification-history.db");
+}
+
+Conecto::Plugins::NotificationInfo
+create_notification (const std::string& id, const Glib::DateTime& time)
+{
+    return { id, "Messages", "Title " + id, "Body " + id, time, false, std::string () };
+}
+
+/**
+ * Store @p notifications and run the main context until they have been written
+ */
+void
+store (NotificationHistory& history, const std::string& device_id,
+       std::vector<Conecto::Plugins::NotificationInfo>&& notifications)
+{
+    bool written = false;
+    auto connection = history.signal_notifications_added ().connect (
+            [&written, device_id] (const std::string& id) { written = written || id == device_id; });
+    history.store_notifications (device_id, std::move (notifications));
+    while (!written) Glib::MainContext::get_default ()->iteration (true);
+    connection.disconnect ();
+}
+
+std::vector<NotificationHistory::Entry>
+read_page (NotificationHistory& history, const Conecto::Device& device, const NotificationHistory::PageKey& before,
+           size_t page_size)
+{
+    bool                                    finished = false;
+    std::vector<NotificationHistory::Entry> res;
+    history.read_page (device, before, page_size, [&finished, &res] (std::vector<NotificationHistory::Entry> entries) {
+        res = std::move (entries);
+        finished = true;
+    });
+    while (!finished) Glib::MainContext::get_default ()->iteration (true);
+    return res;
+}
+
+/**
+ * Compact the history at @p path
+ *
+ * Compaction is started when the history is opened, and pending jobs are finished when it is closed.
+ */
+void
+compact (const std::string& path)
+{
+    NotificationHistory history (path, MAX_AGE_DAYS, MAX_PER_DEVICE);
+}
+
+} // namespace
+
+TEST (NotificationHistoryTest, dedupe_test)
+{
+    auto                device = create_device ("fake_phone");
+    TemporaryDirectory  directory ("conecto-notifications-XXXXXX");
+    NotificationHistory history (get_database_path (directory));
+    auto                time = Glib::DateTime::create_now_utc ();
+
+    store (history, "fake_phone", { create_notification ("1", time), create_notification ("2", time) });
+    // Resent notifications are skipped, updated ones (with a new time) are added
+    store (history, "fake_phone",
+           { create_notification ("1", time), create_notification ("2", time.add_seconds (1)) });
+    // Notifications of other devices are stored separately
+    store (history, "other_phone", { create_notification ("1", time) });
+
+    auto entries = read_page (history, *device, NotificationHistory::PageKey::newest (), 10);
+    ASSERT_EQ (entries.size (), 3u);
+    ASSERT_EQ (entries[0].notification_id, "2");
+    ASSERT_EQ (entries[0].time, entries[1].time + 1000);
+    ASSERT_EQ (entries[1].notification_id, "2");
+    ASSERT_EQ (entries[2].notification_id, "1");
+    ASSERT_EQ (entries[2].title, "Title 1");
+    ASSERT_EQ (read_page (history, *create_device ("other_phone"), NotificationHistory::PageKey::newest (), 10).size (),
+               1u);
+}
+
+TEST (NotificationHistoryTest, pagination_test)
+{
+    auto                device = create_device ("fake_phone");
+    TemporaryDirectory  directory ("conecto-notifications-XXXXXX");
+    NotificationHistory history (get_database_path (directory));
+    auto                time = Glib::DateTime::create_now_utc ();
+
+    std::vector<Conecto::Plugins::NotificationInfo> notifications;
+    for (int i = 0; i < 5; i++)
+        notifications.push_back (create_notification (std::to_string (i), time.add_seconds (i)));
+    // Notifications with the same time are ordered by their row id
+    notifications.push_back (create_notification ("5", time.add_seconds (4)));
+    store (history, "fake_phone", std::move (notifications));
+
+    std::vector<std::string>     ids;
+    NotificationHistory::PageKey key = NotificationHistory::PageKey::newest ();
+    for (;;) {
+        auto page = read_page (history, *device, key, 4);
+        if (page.empty ()) break;
+        ASSERT_LE (page.size (), 4u);
+        for (const auto& entry : page) ids.push_back (entry.notification_id);
+        key = page.back ().get_key ();
+    }
+    ASSERT_EQ (ids, std::vector<std::string> ({ "5", "4", "3", "2", "1", "0" }));
+}
+
+TEST (NotificationHistoryTest, compact_age_test)
+{
+    TemporaryDirectory directory ("conecto-notifications-XXXXXX");
+    std::string        path = get_database_path (directory);
+    auto               device = create_device ("fake_phone");
+    auto               now = Glib::DateTime::create_now_utc ();
+
+    {
+        NotificationHistory history (path, MAX_AGE_DAYS, MAX_PER_DEVICE);
+        store (history, "fake_phone",
+               { create_notification ("expired", now.add_days (-MAX_AGE_DAYS - 1)),
+                 create_notification ("old", now.add_days (-MAX_AGE_DAYS + 1)), create_notification ("new", now) });
+    }
+    compact (path);
+
+    NotificationHistory history (path, MAX_AGE_DAYS, MAX_PER_DEVICE);
+    auto                entries = read_page (history, *device, NotificationHistory::PageKey::newest (), 10);
+    ASSERT_EQ (entries.size (), 2u);
+    ASSERT_EQ (entries[0].notification_id, "new");
+    ASSERT_EQ (entries[1].notification_id, "old");
+}
+
+TEST (NotificationHistoryTest, compact_limit_test)
+{
+    TemporaryDirectory directory ("conecto-notifications-XXXXXX");
+    std::string        path = get_database_path (directory);
+    auto               device = create_device ("fake_phone");
+    auto               time = Glib::DateTime::create_now_utc ().add_days (-1);
+
+    {
+        NotificationHistory                             history (path, MAX_AGE_DAYS, MAX_PER_DEVICE);
+        std::vector<Conecto::Plugins::NotificationInfo> notifications;
+        for (int i = 0; i < MAX_PER_DEVICE + 10; i++)
+            notifications.push_back (create_notification (std::to_string (i), time.add_seconds (i)));
+        store (history, "fake_phone", std::move (notifications));
+        store (history, "other_phone", { create_notification ("0", time) });
+    }
+    compact (path);
+
+    // Only the newest notifications of a device are kept, other devices aren't affected
+    NotificationHistory history (path, MAX_AGE_DAYS, MAX_PER_DEVICE);
+    auto entries = read_page (history, *device, NotificationHistory::PageKey::newest (), 2 * MAX_PER_DEVICE);
+    ASSERT_EQ (entries.size (), static_cast<size_t> (MAX_PER_DEVICE));
+    ASSERT_EQ (entries.front ().notification_id, std::to_string (MAX_PER_DEVICE + 9));
+    ASSERT_EQ (entries.back ().notification_id, "10");
+    ASSERT_EQ (read_page (history, *create_device ("other_phone"), NotificationHistory::PageKey::newest (), 10).size (),
+               1u);
+}
@@ -0,0 +1,313 @@
+/* test_sms_storage.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include "../../src/models/sms-storage.h"
+#include "../test_helpers.h"
+
+using namespace App::Models;
+using Testing::TemporaryDirectory;
+using Testing::create_device;
+
+namespace {
+
+// A database created before the schema was versioned: Escaped strings and ISO 8601 timestamps
+constexpr char UNVERSIONED_DATABASE[] =
+        "CREATE TABLE message("
+        "    id             INTEGER      PRIMARY KEY AUTOINCREMENT,"
+        "    phone_number   TEXT         NOT NULL,"
+        "    message        TEXT         NOT NULL,"
+        "    device_id      TEXT         NOT NULL,"
+        "    date_received  DATETIME     CURRENT_TIMESTAMP,"
+        "    sender         INTEGER      DEFAULT 1"
+        ");"
+        "INSERT INTO message (phone_number, message, device_id, date_received, sender) VALUES"
+        "    ('+49 170 1234567', 'Hello\\n\\\"World\\\"', 'fake_phone', '2020-05-14T16:00:00Z', 1),"
+        "    ('+49 170 1234567', 'Caf\\303\\251', 'fake_phone', '2020-05-14T16:00:01.500Z', 0);";
+
+/**
+ * Run the main context until @p result has been set by a completion callback
+ */
+template <typename T>
+T
+wait_for (const std::function<void (std::function<void (T)>)>& request)
+{
+    bool finished = false;
+    T    res;
+    request ([&finished, &res] (T value) {
+        res = std::move (value);
+        finished = true;
+    });
+    while (!finished) Glib::MainContext::get_default ()->iteration (true);
+    return res;
+}
+
+/**
+ * Wait until the writes queued before have been finished (the writer runs its jobs in order)
+ */
+void
+wait_for_writes (SMSStorage& storage, const Conecto::Device& device)
+{
+    wait_for<bool> ([&storage, &device] (std::function<void (bool)> done) {
+        storage.store_messages (device, std::vector<Conecto::Plugins::SMSMessage> (), done);
+    });
+}
+
+/**
+ * A storage in @p directory, with the contacts in @p contacts as its snapshot
+ */
+std::unique_ptr<SMSStorage>
+create_storage (const std::string& directory, const std::map<std::string, std::vector<Glib::ustring>>& contacts = {})
+{
+    std::string   snapshot_path = Glib::build_filename (directory, "contacts.cache");
+    Glib::KeyFile snapshot;
+    for (const auto& contact : contacts) {
+        snapshot.set_string (contact.first, "name", contact.first);
+        snapshot.set_string_list (contact.first, "phone_numbers", contact.second);
+    }
+    snapshot.save_to_file (snapshot_path);
+    return std::make_unique<SMSStorage> (Glib::build_filename (directory, "sms-storage.db"), snapshot_path);
+}
+
+SMSStorage::SMS
+create_sms (const std::string& phone_number, int64_t seconds, const std::string& message = "Hello")
+{
+    return SMSStorage::SMS (message, phone_number, SMSStorage::SMS::FROM_CONTACT,
+                            Glib::DateTime::create_now_utc (seconds));
+}
+
+} // namespace
+
+TEST (SMSStorageTest, conversation_contacts_test)
+{
+    auto               device = create_device ();
+    TemporaryDirectory directory ("conecto-sms-XXXXXX");
+    auto               storage = create_storage (directory.get_path (), { { "Alice", { "0170 1234567" } } });
+    storage->add_sms (*device, create_sms ("+49 170 123-4567", 1000));
+    storage->add_sms (*device, create_sms ("+49 171 7654321", 2000));
+    wait_for_writes (*storage, *device);
+
+    auto contacts = wait_for<std::vector<SMSStorage::Contact>> (
+            [&storage, &device] (std::function<void (std::vector<SMSStorage::Contact>)> done) {
+                storage->get_conversation_contacts (*device, done);
+            });
+    ASSERT_EQ (contacts.size (), 2u);
+    ASSERT_EQ (contacts[0].display_name, "");
+    ASSERT_EQ (contacts[0].phone_numbers, std::vector<std::string> ({ "+49 171 7654321" }));
+    // Matched contacts keep the number as stored with the conversation, not the contact's notation
+    ASSERT_EQ (contacts[1].display_name, "Alice");
+    ASSERT_EQ (contacts[1].phone_numbers, std::vector<std::string> ({ "+49 170 123-4567" }));
+}
+
+TEST (SMSStorageTest, unread_count_test)
+{
+    auto               device = create_device ();
+    TemporaryDirectory directory ("conecto-sms-XXXXXX");
+    auto               storage = create_storage (directory.get_path ());
+
+    // A synced history, only the last message hasn't been read on the phone
+    std::vector<Conecto::Plugins::SMSMessage> messages = {
+        { "Hi", "+49 170 1234567", 1000, true, true, 1, 1 },
+        { "Hello", "+49 170 1234567", 2000, false, true, 1, 2 },
+        { "How are you?", "+49 170 1234567", 3000, true, true, 1, 3 },
+        { "Are you there?", "+49 170 1234567", 4000, true, false, 1, 4 },
+    };
+    storage->store_messages (*device, std::move (messages), SMSStorage::SlotStored ());
+    wait_for_writes (*storage, *device);
+    auto conversations = wait_for<std::vector<SMSStorage::Conversation>> (
+            [&storage, &device] (std::function<void (std::vector<SMSStorage::Conversation>)> done) {
+                storage->get_conversations (*device, done);
+            });
+    ASSERT_EQ (conversations.size (), 1u);
+    ASSERT_EQ (conversations[0].message_count, 4);
+    ASSERT_EQ (conversations[0].unread_count, 1);
+
+    storage->mark_conversation_read (*device, "+49 170 1234567");
+    storage->add_sms (*device, create_sms ("+49 170 1234567", 5));
+    wait_for_writes (*storage, *device);
+    conversations = wait_for<std::vector<SMSStorage::Conversation>> (
+            [&storage, &device] (std::function<void (std::vector<SMSStorage::Conversation>)> done) {
+                storage->get_conversations (*device, done);
+            });
+    ASSERT_EQ (conversations[0].unread_count, 1);
+}
+
+TEST (SMSStorageTest, failure_test)
+{
+    TemporaryDirectory directory ("conecto-sms-XXXXXX");
+    auto               device = create_device ();
+    auto               storage = create_storage (directory.get_path ());
+    wait_for_writes (*storage, *device);
+
+    // Break the database behind the storage's back, so that its queries can't be prepared
+    std::string path = Glib::build_filename (directory.get_path (), "sms-storage.db");
+    sqlite3*    handle = nullptr;
+    ASSERT_EQ (sqlite3_open (path.c_str (), &handle), SQLITE_OK);
+    ASSERT_EQ (sqlite3_exec (handle, "DROP TABLE sync_state; DROP TABLE message;", nullptr, nullptr, nullptr),
+               SQLITE_OK);
+    sqlite3_close (handle);
+
+    // Failures are reported instead of leaving the sync waiting
+    bool success = wait_for<bool> ([&storage, &device] (std::function<void (bool)> done) {
+        storage->get_high_water_marks (
+                *device, [done] (bool success, Conecto::Plugins::SMSStore::HighWaterMarks) { done (success); });
+    });
+    ASSERT_FALSE (success);
+    success = wait_for<bool> ([&storage, &device] (std::function<void (bool)> done) {
+        std::vector<Conecto::Plugins::SMSMessage> messages = { { "Hi", "+49 170 1234567", 1000, true, true, 1, 1 } };
+        storage->store_messages (*device, std::move (messages), done);
+    });
+    ASSERT_FALSE (success);
+}
+
+TEST (SMSStorageTest, migration_test)
+{
+    TemporaryDirectory directory ("conecto-sms-XXXXXX");
+    std::string        path = Glib::build_filename (directory.get_path (), "sms-storage.db");
+    sqlite3*           handle = nullptr;
+    ASSERT_EQ (sqlite3_open (path.c_str (), &handle), SQLITE_OK);
+    ASSERT_EQ (sqlite3_exec (handle, UNVERSIONED_DATABASE, nullptr, nullptr, nullptr), SQLITE_OK);
+    sqlite3_close (handle);
+
+    auto device = create_device ();
+    auto storage = std::make_unique<SMSStorage> (path, Glib::build_filename (directory.get_path (), "contacts.cache"));
+    // Wait for existing messages to be added to the full-text index
+    wait_for_writes (*storage, *device);
+
+    auto conversations = wait_for<std::vector<SMSStorage::Conversation>> (
+            [&storage, &device] (std::function<void (std::vector<SMSStorage::Conversation>)> done) {
+                storage->get_conversations (*device, done);
+            });
+    ASSERT_EQ (conversations.size (), 1u);
+    ASSERT_EQ (conversations[0].phone_number, "+49 170 1234567");
+    ASSERT_EQ (conversations[0].last_message, "Caf\xc3\xa9");
+    ASSERT_EQ (conversations[0].last_timestamp, 1589472001500);
+    ASSERT_EQ (conversations[0].message_count, 2);
+    // Existing messages are considered read
+    ASSERT_EQ (conversations[0].unread_count, 0);
+
+    auto rows = wait_for<std::vector<SMSStorage::MessageRow>> (
+            [&storage, &device] (std::function<void (std::vector<SMSStorage::MessageRow>)> done) {
+                storage->read_conversation_page (
+                        *device, "+49 170 1234567", SMSStorage::PageKey::oldest (), SMSStorage::PageDirection::NEWER,
+                        10, nullptr,
+                        [done] (const std::shared_ptr<std::vector<SMSStorage::MessageRow>>& buffer, size_t n_rows) {
+                            done (std::vector<SMSStorage::MessageRow> (buffer->begin (), buffer->begin () + n_rows));
+                        });
+            });
+    ASSERT_EQ (rows.size (), 2u);
+    ASSERT_EQ (rows[0].message, "Hello\n\"World\"");
+    ASSERT_EQ (rows[0].timestamp, 1589472000000);
+    ASSERT_EQ (rows[0].from, SMSStorage::SMS::FROM_CONTACT);
+    ASSERT_EQ (rows[1].from, SMSStorage::SMS::FROM_ME);
+
+    auto hits = wait_for<std::vector<SMSStorage::SearchHit>> (
+            [&storage] (std::function<void (std::vector<SMSStorage::SearchHit>)> done) {
+                storage->search_messages ("world", 0, 10, done);
+            });
+    ASSERT_EQ (hits.size (), 1u);
+    ASSERT_EQ (hits[0].id, rows[0].id);
+
+    storage.reset ();
+    ASSERT_EQ (sqlite3_open (path.c_str (), &handle), SQLITE_OK);
+    int version = 0;
+    sqlite3_exec (
+            handle, "PRAGMA user_version;",
+            [] (void* version, int, char** values, char**) {
+                *static_cast<int*> (version) = std::stoi (values[0]);
+                return 0;
+            },
+            &version, nullptr);
+    sqlite3_close (handle);
+    ASSERT_EQ (version, 6);
+}
+
+TEST (SMSStorageTest, pagination_test)
+{
+    auto               device = create_device ();
+    TemporaryDirectory directory ("conecto-sms-XXXXXX");
+    auto               storage = create_storage (directory.get_path ());
+    // Messages 2 to 4 have the same timestamp, so pages need to be split by id
+    for (int64_t seconds : { 1, 2, 2, 2, 3 }) storage->add_sms (*device, create_sms ("+49 170 1234567", seconds));
+    storage->add_sms (*device, create_sms ("+49 171 7654321", 2));
+    wait_for_writes (*storage, *device);
+
+    // Reads all pages in @p direction, the same buffer is used for every page
+    auto read_all = [&storage, &device] (SMSStorage::PageKey from, SMSStorage::PageDirection direction) {
+        auto                 buffer = std::make_shared<std::vector<SMSStorage::MessageRow>> ();
+        std::vector<int64_t> ids;
+        while (true) {
+            size_t n_rows = wait_for<size_t> ([&] (std::function<void (size_t)> done) {
+                storage->read_conversation_page (
+                        *device, "+49 170 1234567", from, direction, 2, buffer,
+                        [done] (const std::shared_ptr<std::vector<SMSStorage::MessageRow>>&, size_t n_rows) {
+                            done (n_rows);
+                        });
+            });
+            if (n_rows == 0) break;
+            for (size_t i = 0; i < n_rows; i++) ids.push_back ((*buffer)[i].id);
+            from = (*buffer)[n_rows - 1].get_key ();
+        }
+        // The buffer doesn't grow beyond the page size
+        EXPECT_EQ (buffer->size (), 2u);
+        return ids;
+    };
+
+    ASSERT_EQ (read_all (SMSStorage::PageKey::newest (), SMSStorage::PageDirection::OLDER),
+               std::vector<int64_t> ({ 5, 4, 3, 2, 1 }));
+    ASSERT_EQ (read_all (SMSStorage::PageKey::oldest (), SMSStorage::PageDirection::NEWER),
+               std::vector<int64_t> ({ 1, 2, 3, 4, 5 }));
+    // Starting in the middle of messages with the same timestamp
+    ASSERT_EQ (read_all ({ 2000, 3 }, SMSStorage::PageDirection::OLDER), std::vector<int64_t> ({ 2, 1 }));
+    ASSERT_EQ (read_all ({ 2000, 3 }, SMSStorage::PageDirection::NEWER), std::vector<int64_t> ({ 4, 5 }));
+}
+
+TEST (SMSStorageTest, search_test)
+{
+    auto               device = create_device ();
+    TemporaryDirectory directory ("conecto-sms-XXXXXX");
+    auto               storage = create_storage (directory.get_path ());
+    for (const char* message : { "He said \"hi\" to me", "foo-bar NEAR(x)", "AND OR NOT", "a < b & c" })
+        storage->add_sms (*device, create_sms ("+49 170 1234567", 1, message));
+    wait_for_writes (*storage, *device);
+
+    auto search = [&storage] (const std::string& text) {
+        auto hits = wait_for<std::vector<SMSStorage::SearchHit>> (
+                [&storage, &text] (std::function<void (std::vector<SMSStorage::SearchHit>)> done) {
+                    storage->search_messages (text, 0, 10, done);
+                });
+        std::vector<std::string> res;
+        for (const auto& hit : hits) res.push_back (hit.snippet);
+        std::sort (res.begin (), res.end ());
+        return res;
+    };
+
+    // Words are matched as prefixes, the query syntax of FTS5 isn't available
+    ASSERT_EQ (search ("\"hi"), std::vector<std::string> ({ "He said &quot;<b>hi</b>&quot; to me" }));
+    ASSERT_EQ (search ("NEAR("), std::vector<std::string> ({ "foo-bar <b>NEAR</b>(x)" }));
+    ASSERT_EQ (search ("and"), std::vector<std::string> ({ "<b>AND</b> OR NOT" }));
+    ASSERT_EQ (search ("foo-b"), std::vector<std::string> ({ "<b>foo-bar</b> NEAR(x)" }));
+    // Every word needs to match, the snippet is escaped
+    ASSERT_EQ (search ("a b"), std::vector<std::string> ({ "<b>a</b> &lt; <b>b</b> &amp; c" }));
+    ASSERT_EQ (search ("b"), std::vector<std::string> ({ "a &lt; <b>b</b> &amp; c", "foo-<b>bar</b> NEAR(x)" }));
+    ASSERT_TRUE (search ("* - \"").empty ());
+    ASSERT_TRUE (search ("").empty ());
+}
@@ -0,0 +1,86 @@
+/* test_sqlite_worker.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+#include <glibmm/main.h>
+#include <stdexcept>
+#include "../../src/utils/sqlite-worker.h"
+
+using namespace App::Utils;
+
+TEST (SqliteWorkerTest, failure_test)
+{
+    std::vector<std::unique_ptr<SqliteConnection>> connections;
+    connections.push_back (std::make_unique<SqliteConnection> (":memory:"));
+    SqliteWorker worker (std::move (connections));
+
+    std::vector<std::string> events;
+    auto                     failed = [&events] (const std::string& error) { events.push_back ("failed: " + error); };
+    worker.submit ([] (SqliteConnection&) -> int { throw "const char*"; },
+                   [&events] (int) { events.push_back ("done"); }, failed);
+    worker.submit ([] (SqliteConnection&) -> int { throw std::runtime_error ("std::exception"); },
+                   [&events] (int) { events.push_back ("done"); }, failed);
+    worker.submit ([] (SqliteConnection&) { throw 42; }, failed);
+    // The thread keeps running jobs after a failure
+    worker.submit ([] (SqliteConnection& conn) { return conn.exec ("SELECT 1;"); },
+                   [&events] (bool res) { events.push_back (res ? "done" : "failed"); }, failed);
+
+    while (events.size () < 4) Glib::MainContext::get_default ()->iteration (true);
+    ASSERT_EQ (events, std::vector<std::string> ({ "failed: const char*", "failed: std::exception",
+                                                   "failed: Unknown error", "done" }));
+}
+
+TEST (SqliteWorkerTest, rollback_test)
+{
+    std::vector<std::unique_ptr<SqliteConnection>> connections;
+    connections.push_back (std::make_unique<SqliteConnection> (":memory:"));
+    SqliteWorker worker (std::move (connections));
+
+    std::vector<std::string> events;
+    worker.submit ([] (SqliteConnection& conn) { return conn.exec ("CREATE TABLE t (x INTEGER);"); },
+                   [&events] (bool res) { events.push_back (res ? "done" : "failed"); });
+    // A job throwing in the middle of a transaction
+    worker.submit (
+        [] (SqliteConnection& conn) -> bool {
+            conn.exec ("BEGIN;");
+            conn.exec ("INSERT INTO t VALUES (1);");
+            throw "Interrupted";
+        },
+        [&events] (bool) { events.push_back ("done"); },
+        [&events] (const std::string& error) { events.push_back ("failed: " + error); });
+    // The insert is rolled back and the connection can start a new transaction
+    worker.submit (
+        [] (SqliteConnection& conn) {
+            bool res = conn.exec ("BEGIN;") && conn.exec ("INSERT INTO t VALUES (2);") && conn.exec ("COMMIT;");
+            int  count = -1;
+            sqlite3_exec (
+                conn.get_handle (), "SELECT COUNT(*) FROM t;",
+                [] (void* count, int, char** values, char**) {
+                    *static_cast<int*> (count) = std::stoi (values[0]);
+                    return 0;
+                },
+                &count, nullptr);
+            return res && count == 1;
+        },
+        [&events] (bool res) { events.push_back (res ? "done" : "failed"); });
+
+    while (events.size () < 3) Glib::MainContext::get_default ()->iteration (true);
+    ASSERT_EQ (events, std::vector<std::string> ({ "done", "failed: Interrupted", "done" }));
+}
@@ -0,0 +1,76 @@
+/* test_battery_history.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+#include <conecto.h>
+
+using namespace Conecto::Plugins;
+
+namespace {
+
+constexpr int64_t MINUTE = 60ll * 1000000;
+constexpr int64_t HOUR = 60 * MINUTE;
+
+} // namespace
+
+TEST (BatteryHistoryTest, downsampling_test)
+{
+    BatteryHistory history;
+    // A week of samples, the level changes every minute
+    int received = 0;
+    for (int64_t time = 0; time < 7 * 24 * HOUR; time += MINUTE, received++)
+        history.add (time, 100 - received % 100, false);
+
+    auto samples = history.get_samples ();
+    ASSERT_LE (samples.size (), BatteryHistory::TIER_CAPACITY * BatteryHistory::TIER_COUNT);
+    ASSERT_EQ (samples.back ().time, 7 * 24 * HOUR - MINUTE);
+    ASSERT_EQ (samples.back ().count, 1);
+
+    // Oldest first, older samples have been aggregated
+    for (size_t i = 1; i < samples.size (); i++) ASSERT_LT (samples[i - 1].time, samples[i].time);
+    ASSERT_GT (samples.front ().count, 1);
+    // Only samples dropped from the last tier are discarded
+    ASSERT_LT (samples.front ().time, 7 * 24 * HOUR - 2 * 24 * HOUR);
+}
+
+TEST (BatteryHistoryTest, discharge_rate_test)
+{
+    BatteryHistory history;
+    double         rate;
+    int64_t        time_to_empty;
+    ASSERT_FALSE (history.get_discharge_rate (rate));
+
+    history.add (0, 90, true);
+    // Resent levels are ignored
+    history.add (MINUTE, 90, true);
+    ASSERT_EQ (history.get_samples ().size (), 1u);
+
+    // Unplugged, then 1% every 6 minutes
+    for (int i = 0; i <= 20; i++) history.add (HOUR + i * 6 * MINUTE, 80 - i, false);
+    ASSERT_TRUE (history.get_discharge_rate (rate));
+    ASSERT_NEAR (rate, 10, 0.01);
+    ASSERT_TRUE (history.get_time_to_empty (time_to_empty));
+    ASSERT_NEAR (static_cast<double> (time_to_empty) / HOUR, 6, 0.01);
+
+    // Not discharging while plugged in
+    history.add (4 * HOUR, 61, true);
+    ASSERT_FALSE (history.get_discharge_rate (rate));
+    ASSERT_FALSE (history.get_time_to_empty (time_to_empty));
+}
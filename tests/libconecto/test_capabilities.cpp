@@ -0,0 +1,75 @@
+/* test_capabilities.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+#include <conecto.h>
+
+using namespace Conecto;
+
+TEST (CapabilityTableTest, intern_test)
+{
+    auto& table = CapabilityTable::get_instance ();
+
+    auto battery = table.intern ("kdeconnect.battery");
+    auto ping = table.intern ("kdeconnect.ping");
+    ASSERT_NE (battery, ping);
+    ASSERT_EQ (table.intern ("kdeconnect.battery"), battery);
+    ASSERT_EQ (table.get_name (battery), "kdeconnect.battery");
+    ASSERT_EQ (table.get_name (ping), "kdeconnect.ping");
+
+    CapabilityTable::Id id;
+    ASSERT_FALSE (table.lookup ("kdeconnect.never-interned", id));
+    ASSERT_TRUE (table.lookup ("kdeconnect.ping", id));
+    ASSERT_EQ (id, ping);
+}
+
+TEST (CapabilitySetTest, diff_test)
+{
+    std::list<std::string> old_names = { "kdeconnect.battery", "kdeconnect.ping", "kdeconnect.notification" };
+    std::list<std::string> new_names = { "kdeconnect.ping", "kdeconnect.notification", "kdeconnect.mousepad.request" };
+
+    auto old_set = CapabilitySet::from_names (old_names);
+    auto new_set = CapabilitySet::from_names (new_names);
+    ASSERT_EQ (old_set.count (), 3);
+    ASSERT_TRUE (old_set.contains ("kdeconnect.battery"));
+    ASSERT_FALSE (new_set.contains ("kdeconnect.battery"));
+
+    auto changed = old_set ^ new_set;
+    auto added = changed & new_set;
+    auto removed = changed & old_set;
+    ASSERT_EQ (added.get_names (), std::vector<std::string> ({ "kdeconnect.mousepad.request" }));
+    ASSERT_EQ (removed.get_names (), std::vector<std::string> ({ "kdeconnect.battery" }));
+    ASSERT_TRUE ((old_set ^ old_set).empty ());
+}
+
+TEST (CapabilitySetTest, equality_test)
+{
+    auto& table = CapabilityTable::get_instance ();
+
+    // Force the second set to use more words than the first one
+    CapabilitySet a;
+    CapabilitySet b;
+    a.insert (table.intern ("kdeconnect.ping"));
+    b.insert (table.intern ("kdeconnect.ping"));
+    b.insert (200);
+    ASSERT_NE (a, b);
+    b.erase (200);
+    ASSERT_EQ (a, b);
+}
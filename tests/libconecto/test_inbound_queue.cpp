@@ -0,0 +1,163 @@
+/* test_inbound_queue.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+#include <conecto.h>
+
+using namespace Conecto;
+
+namespace {
+
+constexpr char BATTERY[] = "kdeconnect.battery";
+constexpr char MOUSEPAD[] = "kdeconnect.mousepad.request";
+constexpr char PING[] = "kdeconnect.ping";
+
+std::unique_ptr<NetworkPacket>
+create_battery (int charge)
+{
+    Json::Value body (Json::objectValue);
+    body["currentCharge"] = charge;
+    body["isCharging"] = false;
+    return std::make_unique<NetworkPacket> (BATTERY, body);
+}
+
+std::unique_ptr<NetworkPacket>
+create_motion (double dx, double dy)
+{
+    Json::Value body (Json::objectValue);
+    body["dx"] = dx;
+    body["dy"] = dy;
+    return std::make_unique<NetworkPacket> (MOUSEPAD, body);
+}
+
+std::unique_ptr<NetworkPacket>
+create_click ()
+{
+    Json::Value body (Json::objectValue);
+    body["singleclick"] = true;
+    return std::make_unique<NetworkPacket> (MOUSEPAD, body);
+}
+
+/**
+ * Records the delivered packets as "type body"
+ */
+class Recorder {
+  public:
+    Recorder (InboundQueue& queue)
+    {
+        queue.signal_packet ().connect ([this] (const NetworkPacket& packet) {
+            Json::StreamWriterBuilder builder;
+            builder["indentation"] = "";
+            delivered.push_back (packet.get_type () + " " + Json::writeString (builder, packet.get_body ()));
+        });
+    }
+
+    std::vector<std::string> delivered;
+};
+
+} // namespace
+
+TEST (InboundQueueTest, coalesce_latest_test)
+{
+    InboundQueue queue;
+    Recorder     recorder (queue);
+
+    for (int charge = 50; charge < 55; charge++) queue.push (create_battery (charge));
+    // Only the latest state is delivered (once the main loop is idle)
+    ASSERT_TRUE (recorder.delivered.empty ());
+    ASSERT_EQ (queue.size (), 1u);
+    queue.flush ();
+    ASSERT_EQ (recorder.delivered,
+               std::vector<std::string> ({ "kdeconnect.battery {\"currentCharge\":54,\"isCharging\":false}" }));
+    ASSERT_EQ (queue.get_counters ().at (BATTERY).received, 5u);
+    ASSERT_EQ (queue.get_counters ().at (BATTERY).coalesced, 4u);
+    ASSERT_EQ (queue.get_counters ().at (BATTERY).delivered, 1u);
+}
+
+TEST (InboundQueueTest, sum_deltas_test)
+{
+    InboundQueue queue;
+    Recorder     recorder (queue);
+
+    queue.push (create_motion (1, 2));
+    queue.push (create_motion (3, 4));
+    // Motion isn't merged across clicks
+    queue.push (create_click ());
+    queue.push (create_motion (5, 6));
+    ASSERT_EQ (queue.size (), 3u);
+    queue.flush ();
+    ASSERT_EQ (recorder.delivered,
+               std::vector<std::string> ({ "kdeconnect.mousepad.request {\"dx\":4.0,\"dy\":6.0}",
+                                           "kdeconnect.mousepad.request {\"singleclick\":true}",
+                                           "kdeconnect.mousepad.request {\"dx\":5.0,\"dy\":6.0}" }));
+}
+
+TEST (InboundQueueTest, ordering_test)
+{
+    InboundQueue queue;
+    Recorder     recorder (queue);
+
+    queue.push (create_battery (50));
+    queue.push (create_motion (1, 1));
+    // Packets which can't be merged are delivered immediately, after the pending ones
+    queue.push (std::make_unique<NetworkPacket> (PING, Json::Value (Json::objectValue)));
+    ASSERT_EQ (queue.size (), 0u);
+    ASSERT_EQ (recorder.delivered,
+               std::vector<std::string> ({ "kdeconnect.battery {\"currentCharge\":50,\"isCharging\":false}",
+                                           "kdeconnect.mousepad.request {\"dx\":1.0,\"dy\":1.0}",
+                                           "kdeconnect.ping {}" }));
+}
+
+TEST (InboundQueueTest, max_pending_test)
+{
+    InboundQueue queue;
+    Recorder     recorder (queue);
+
+    for (size_t i = 1; i < InboundQueue::MAX_PENDING; i++) queue.push (create_click ());
+    ASSERT_TRUE (recorder.delivered.empty ());
+    // The queue is flushed synchronously once it is full
+    queue.push (create_click ());
+    ASSERT_EQ (queue.size (), 0u);
+    ASSERT_EQ (recorder.delivered.size (), InboundQueue::MAX_PENDING);
+}
+
+TEST (InboundQueueTest, clear_test)
+{
+    InboundQueue queue;
+    Recorder     recorder (queue);
+
+    queue.push (create_battery (50));
+    queue.clear ();
+    queue.flush ();
+    ASSERT_TRUE (recorder.delivered.empty ());
+}
+
+TEST (InboundQueueTest, counters_test)
+{
+    InboundQueue queue;
+
+    for (size_t i = 0; i < 2 * InboundQueue::MAX_COUNTED_TYPES; i++)
+        queue.push (std::make_unique<NetworkPacket> ("kdeconnect.unknown." + std::to_string (i),
+                                                     Json::Value (Json::objectValue)));
+    // Types beyond the limit share a single entry
+    ASSERT_EQ (queue.get_counters ().size (), InboundQueue::MAX_COUNTED_TYPES + 1);
+    ASSERT_EQ (queue.get_counters ().at (InboundQueue::OTHER_TYPES).received, InboundQueue::MAX_COUNTED_TYPES);
+    ASSERT_EQ (queue.get_counters ().at (InboundQueue::OTHER_TYPES).delivered, InboundQueue::MAX_COUNTED_TYPES);
+}
@@ -0,0 +1,186 @@
+/* test_mouse.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+#include <conecto.h>
+#include "../test_helpers.h"
+
+using namespace Conecto;
+using namespace Conecto::Plugins;
+
+namespace {
+
+constexpr char REQUEST[] = "kdeconnect.mousepad.request";
+
+/**
+ * A Mouse plugin injecting events into a recording backend, fed by a fake device
+ */
+class MouseFixture {
+  public:
+    MouseFixture ()
+        : backend (new RecordingInputBackend ())
+        , mouse (std::unique_ptr<InputBackend> (backend))
+        , device (Testing::create_device ())
+    {
+        mouse.register_device (device);
+    }
+
+    ~MouseFixture () { mouse.unregister_device (device); }
+
+    void
+    receive (const std::string& key, const Json::Value& value)
+    {
+        Json::Value body (Json::objectValue);
+        body[key] = value;
+        device->signal_message ().emit (NetworkPacket (REQUEST, body));
+    }
+
+    void
+    receive_motion (double dx, double dy, bool scroll = false)
+    {
+        Json::Value body (Json::objectValue);
+        body["dx"] = dx;
+        body["dy"] = dy;
+        if (scroll) body["scroll"] = true;
+        device->signal_message ().emit (NetworkPacket (REQUEST, body));
+    }
+
+    /**
+     * The recorded events in a readable form
+     */
+    std::vector<std::string>
+    get_events () const
+    {
+        std::vector<std::string> res;
+        for (const auto& event : backend->get_events ()) {
+            switch (event.type) {
+            case InputEvent::MOTION:
+                res.push_back ("motion " + std::to_string (event.dx) + " " + std::to_string (event.dy));
+                break;
+            case InputEvent::CLICK:
+                res.push_back ("click " + std::to_string (event.button));
+                break;
+            case InputEvent::KEYSYM:
+                res.push_back (std::string ("keysym ") + gdk_keyval_name (event.keyval));
+                break;
+            case InputEvent::TEXT:
+                res.push_back ("text " + event.str);
+                break;
+            }
+        }
+        return res;
+    }
+
+    RecordingInputBackend*  backend; // owned by mouse
+    Mouse                   mouse;
+    std::shared_ptr<Device> device;
+};
+
+} // namespace
+
+TEST (MouseTest, click_test)
+{
+    MouseFixture fixture;
+
+    fixture.receive ("singleclick", true);
+    fixture.receive ("doubleclick", true);
+    fixture.receive ("rightclick", true);
+    fixture.receive ("middleclick", true);
+    ASSERT_EQ (fixture.get_events (),
+               std::vector<std::string> ({ "click 1", "click 1", "click 1", "click 3", "click 2" }));
+    // Both clicks of a double click are submitted at once
+    ASSERT_EQ (fixture.backend->get_n_bursts (), 4u);
+}
+
+TEST (MouseTest, motion_test)
+{
+    MouseFixture fixture;
+    fixture.mouse.set_motion_pacing (false);
+
+    fixture.receive_motion (1.5, -2.0);
+    // The fractional part is kept for the next motion event
+    fixture.receive_motion (0.5, 0.0);
+    ASSERT_EQ (fixture.get_events (), std::vector<std::string> ({ "motion 1 -2", "motion 1 0" }));
+}
+
+TEST (MouseTest, keyboard_test)
+{
+    MouseFixture fixture;
+
+    fixture.receive ("key", "a");
+    fixture.receive ("specialKey", 12);
+    fixture.receive ("key", "b");
+    fixture.receive ("specialKey", 1);
+    // Unknown special keys are ignored
+    fixture.receive ("specialKey", 99);
+    // Text and special keys are sent through the same backend, in order
+    ASSERT_EQ (fixture.get_events (),
+               std::vector<std::string> ({ "text a", "keysym Return", "text b", "keysym BackSpace" }));
+}
+
+TEST (MouseTest, pacing_test)
+{
+    MouseFixture fixture;
+    fixture.mouse.set_flush_interval (1);
+
+    fixture.receive_motion (1, 2);
+    fixture.receive_motion (3, 4);
+    fixture.receive_motion (-0.5, 0.5);
+    // Motion is accumulated until the flush interval has passed
+    ASSERT_TRUE (fixture.get_events ().empty ());
+    while (fixture.get_events ().empty ()) Glib::MainContext::get_default ()->iteration (true);
+    ASSERT_EQ (fixture.get_events (), std::vector<std::string> ({ "motion 3 6" }));
+    ASSERT_EQ (fixture.backend->get_n_bursts (), 1u);
+    ASSERT_EQ (fixture.mouse.get_motion_latency ().count, 1u);
+}
+
+TEST (MouseTest, flush_before_click_test)
+{
+    MouseFixture fixture;
+    fixture.mouse.set_flush_interval (1000);
+
+    fixture.receive_motion (5, 5);
+    fixture.receive ("singleclick", true);
+    // Pending motion is injected before the click, without waiting for the flush interval
+    ASSERT_EQ (fixture.get_events (), std::vector<std::string> ({ "motion 5 5", "click 1" }));
+    ASSERT_EQ (fixture.backend->get_n_bursts (), 2u);
+    ASSERT_EQ (fixture.mouse.get_button_latency ().count, 1u);
+}
+
+TEST (MouseTest, scroll_test)
+{
+    MouseFixture fixture;
+    fixture.mouse.set_motion_pacing (false);
+
+    // Small deltas add up until they exceed the threshold, each click divides the remaining delta by 4
+    fixture.receive_motion (0, 3, true);
+    ASSERT_TRUE (fixture.get_events ().empty ());
+    fixture.receive_motion (0, 3, true);
+    ASSERT_EQ (fixture.get_events (), std::vector<std::string> ({ "click 5" }));
+    fixture.receive_motion (0, -10, true);
+    ASSERT_EQ (fixture.get_events (), std::vector<std::string> ({ "click 5", "click 4" }));
+
+    // Fast swipes scroll by a few clicks, not linearly (100 -> 25 -> 6.25 -> 1.56)
+    fixture.receive_motion (0, 2.125, true);
+    ASSERT_EQ (fixture.get_events ().size (), 2u);
+    fixture.receive_motion (0, 100, true);
+    ASSERT_EQ (fixture.get_events (),
+               std::vector<std::string> ({ "click 5", "click 4", "click 5", "click 5", "click 5" }));
+}
@@ -0,0 +1,111 @@
+/* test_network_packet.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+#include <conecto.h>
+#include <cstdlib>
+#include <new>
+
+using namespace Conecto;
+
+namespace {
+
+size_t allocation_count = 0;
+
+constexpr char BATTERY_PACKET[] = "{\"id\":1589468436,\"type\":\"kdeconnect.battery\","
+                                  "\"body\":{\"currentCharge\":54,\"isCharging\":false,\"thresholdEvent\":0}}";
+constexpr char PAYLOAD_PACKET[] = "{\"id\":1589468437,\"type\":\"kdeconnect.notification\","
+                                  "\"body\":{\"id\":\"0|org.example|1\",\"appName\":\"Example\",\"ticker\":\"Hi\"},"
+                                  "\"payloadSize\":2048,\"payloadTransferInfo\":{\"port\":1739}}";
+constexpr int  ITERATIONS = 1000;
+
+} // namespace
+
+// Count every heap allocation made by the test binary
+void*
+operator new (size_t size)
+{
+    allocation_count++;
+    void* res = malloc (size ? size : 1);
+    if (!res) throw std::bad_alloc ();
+    return res;
+}
+
+void
+operator delete (void* ptr) noexcept
+{
+    free (ptr);
+}
+
+void
+operator delete (void* ptr, size_t) noexcept
+{
+    free (ptr);
+}
+
+TEST (NetworkPacketTest, parse_test)
+{
+    NetworkPacket packet (PAYLOAD_PACKET);
+    ASSERT_EQ (packet.get_type (), "kdeconnect.notification");
+    ASSERT_EQ (packet.get_id (), 1589468437);
+    ASSERT_EQ (packet.get_body ()["appName"].asString (), "Example");
+    ASSERT_TRUE (packet.get_payload ());
+    ASSERT_EQ (packet.get_payload ()->size, 2048);
+    ASSERT_EQ (packet.get_payload ()->port, 1739);
+
+    auto       reader = NetworkPacket::create_reader ();
+    std::string data = BATTERY_PACKET;
+    NetworkPacket reused (data, *reader);
+    ASSERT_EQ (reused.get_type (), "kdeconnect.battery");
+    ASSERT_EQ (reused.get_body ()["currentCharge"].asInt (), 54);
+    ASSERT_FALSE (reused.get_payload ());
+}
+
+TEST (NetworkPacketTest, malformed_test)
+{
+    auto reader = NetworkPacket::create_reader ();
+    ASSERT_THROW (NetworkPacket ("{\"id\":1,\"type\":\"kdeconnect.ping\"", *reader), MalformedPacketException);
+    ASSERT_THROW (NetworkPacket ("{\"id\":1,\"body\":{}}", *reader), MalformedPacketException);
+    // The reader must still be usable after an error
+    ASSERT_NO_THROW (NetworkPacket (BATTERY_PACKET, *reader));
+}
+
+TEST (NetworkPacketTest, allocations_test)
+{
+    std::string data = BATTERY_PACKET;
+
+    size_t start = allocation_count;
+    for (int i = 0; i < ITERATIONS; i++) NetworkPacket packet (data);
+    size_t fresh = allocation_count - start;
+
+    start = allocation_count;
+    auto   reader = NetworkPacket::create_reader ();
+    size_t reader_allocations = allocation_count - start;
+
+    start = allocation_count;
+    for (int i = 0; i < ITERATIONS; i++) NetworkPacket packet (data, *reader);
+    size_t reused = allocation_count - start;
+
+    RecordProperty ("allocations_new_reader", static_cast<int> (fresh / ITERATIONS));
+    RecordProperty ("allocations_reused_reader", static_cast<int> (reused / ITERATIONS));
+    // Reusing the reader saves (at least) the allocations made for creating one, for every packet
+    ASSERT_GT (reader_allocations, 0u);
+    ASSERT_LE (reused + ITERATIONS * reader_allocations, fresh);
+}
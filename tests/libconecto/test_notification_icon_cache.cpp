@@ -0,0 +1,98 @@
+/* test_notification_icon_cache.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+#include <conecto.h>
+#include <glibmm/fileutils.h>
+#include "../test_helpers.h"
+
+using namespace Conecto::Plugins;
+using Testing::TemporaryDirectory;
+
+namespace {
+
+size_t
+count_files (const std::string& directory)
+{
+    Glib::Dir dir (directory);
+    size_t    res = 0;
+    for (auto it = dir.begin (); it != dir.end (); ++it) res++;
+    return res;
+}
+
+std::string
+create_png ()
+{
+    auto pixbuf = Gdk::Pixbuf::create (Gdk::COLORSPACE_RGB, false, 8, 4, 4);
+    pixbuf->fill (0xff0000ff);
+    gchar* buffer = nullptr;
+    gsize  size = 0;
+    pixbuf->save_to_buffer (buffer, size, "png");
+    std::string res (buffer, size);
+    g_free (buffer);
+    return res;
+}
+
+} // namespace
+
+TEST (NotificationIconCacheTest, dedup_test)
+{
+    TemporaryDirectory    directory ("conecto-icons-XXXXXX");
+    NotificationIconCache cache (directory.get_path (), 4);
+
+    std::string hash = cache.add ("icon");
+    // MD5 of the contents, as announced by devices
+    ASSERT_EQ (hash, "baec6461b0d69dde1b861aefbe375d8a");
+    ASSERT_EQ (cache.add ("icon"), hash);
+    ASSERT_TRUE (cache.contains (hash));
+    ASSERT_EQ (count_files (directory.get_path ()), 1u);
+
+    // Stored icons are found again after restarting
+    NotificationIconCache restarted (directory.get_path (), 4);
+    ASSERT_TRUE (restarted.contains (hash));
+
+    // A stored icon isn't downloaded again (the device and payload aren't touched)
+    std::vector<std::string> fetched;
+    restarted.fetch (nullptr, hash, nullptr, [&fetched] (const std::string& icon) { fetched.push_back (icon); });
+    // Announced hashes are used as file names, anything else is rejected
+    restarted.fetch (nullptr, "../icon", nullptr, [&fetched] (const std::string& icon) { fetched.push_back (icon); });
+    ASSERT_EQ (fetched, std::vector<std::string> ({ hash, std::string () }));
+}
+
+TEST (NotificationIconCacheTest, decode_test)
+{
+    TemporaryDirectory    directory ("conecto-icons-XXXXXX");
+    NotificationIconCache cache (directory.get_path (), 1);
+    std::string           png = cache.add (create_png ());
+    std::string           invalid = cache.add ("not an image");
+
+    auto pixbuf = cache.get_pixbuf (png);
+    ASSERT_TRUE (pixbuf);
+    ASSERT_EQ (pixbuf->get_width (), 4);
+    // Decoded icons are kept in memory
+    ASSERT_EQ (cache.get_pixbuf (png), pixbuf);
+
+    ASSERT_FALSE (cache.get_pixbuf (invalid));
+    ASSERT_FALSE (cache.get_pixbuf ("0123456789abcdef0123456789abcdef"));
+    // The least recently used icon has been dropped and is decoded again
+    auto decoded = cache.get_pixbuf (png);
+    ASSERT_TRUE (decoded);
+    ASSERT_NE (decoded, pixbuf);
+}
@@ -0,0 +1,62 @@
+/* test_notification_rate_limiter.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+#include <conecto.h>
+
+using namespace Conecto::Plugins;
+
+namespace {
+
+constexpr int64_t SECOND = 1000000;
+
+} // namespace
+
+TEST (NotificationRateLimiterTest, burst_test)
+{
+    NotificationRateLimiter limiter ({ 5, 2 * SECOND }, { 3, 5 * SECOND });
+
+    // A group chat sends many messages at once: Only the burst is shown
+    for (int i = 0; i < 3; i++) ASSERT_TRUE (limiter.submit ("phone", "chat", 0));
+    for (int i = 0; i < 50; i++) ASSERT_FALSE (limiter.submit ("phone", "chat", i * 1000));
+
+    // Other apps still have their own bucket, limited by the device
+    ASSERT_TRUE (limiter.submit ("phone", "mail", 0));
+    ASSERT_TRUE (limiter.submit ("phone", "mail", 0));
+    ASSERT_FALSE (limiter.submit ("phone", "mail", 0));
+
+    // Other devices are not affected
+    ASSERT_TRUE (limiter.submit ("tablet", "chat", 0));
+}
+
+TEST (NotificationRateLimiterTest, refill_test)
+{
+    NotificationRateLimiter limiter ({ 5, 2 * SECOND }, { 3, 5 * SECOND });
+
+    for (int i = 0; i < 3; i++) ASSERT_TRUE (limiter.submit ("phone", "chat", 0));
+    ASSERT_FALSE (limiter.submit ("phone", "chat", 4 * SECOND));
+    // One token has been refilled
+    ASSERT_TRUE (limiter.submit ("phone", "chat", 5 * SECOND));
+    ASSERT_FALSE (limiter.submit ("phone", "chat", 5 * SECOND));
+
+    // Buckets are not refilled above the burst
+    for (int i = 0; i < 3; i++) ASSERT_TRUE (limiter.submit ("phone", "chat", 100 * SECOND));
+    ASSERT_FALSE (limiter.submit ("phone", "chat", 100 * SECOND));
+}
@@ -0,0 +1,117 @@
+/* test_notification_store.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+#include <conecto.h>
+
+using namespace Conecto::Plugins;
+
+namespace {
+
+NotificationInfo
+create_notification (const std::string& id, const std::string& title)
+{
+    return { id, "Messages", title, std::string (), Glib::DateTime::create_now_utc (1589468400), false };
+}
+
+std::vector<std::string>
+get_ids (const NotificationStore& store, const std::string& device_id)
+{
+    std::vector<std::string> res;
+    for (const auto* notification : store.get_notifications (device_id)) res.push_back (notification->id);
+    return res;
+}
+
+} // namespace
+
+TEST (NotificationStoreTest, resync_test)
+{
+    NotificationStore store (10);
+    int               added = 0, updated = 0, tablet_added = 0;
+    store.signal_added ("phone").connect ([&added] (const std::string&) { added++; });
+    store.signal_updated ("phone").connect ([&updated] (const std::string&) { updated++; });
+    store.signal_added ("tablet").connect ([&tablet_added] (const std::string&) { tablet_added++; });
+
+    ASSERT_EQ (store.insert ("phone", create_notification ("1", "Hello")), NotificationStore::InsertResult::ADDED);
+    ASSERT_EQ (store.insert ("phone", create_notification ("2", "Hi")), NotificationStore::InsertResult::ADDED);
+    // The phone reconnects and resends its notifications
+    ASSERT_EQ (store.insert ("phone", create_notification ("1", "Hello")), NotificationStore::InsertResult::UNCHANGED);
+    ASSERT_EQ (store.insert ("phone", create_notification ("2", "Hi!")), NotificationStore::InsertResult::UPDATED);
+    // Ids are only unique per device
+    ASSERT_EQ (store.insert ("tablet", create_notification ("1", "Hello")), NotificationStore::InsertResult::ADDED);
+
+    // Subscribers are only invoked for their device
+    ASSERT_EQ (added, 2);
+    ASSERT_EQ (updated, 1);
+    ASSERT_EQ (tablet_added, 1);
+    ASSERT_EQ (store.get_count ("phone"), 2);
+    ASSERT_EQ (store.find ("phone", "2")->title, "Hi!");
+    ASSERT_EQ (store.find ("phone", "3"), nullptr);
+}
+
+TEST (NotificationStoreTest, eviction_test)
+{
+    NotificationStore        store (3);
+    std::vector<std::string> removed;
+    store.signal_removed ("phone").connect ([&removed] (const std::string& id) { removed.push_back (id); });
+
+    for (const char* id : { "1", "2", "3" }) store.insert ("phone", create_notification (id, "Hello"));
+    // Resending 1 makes 2 the least recently received notification
+    store.insert ("phone", create_notification ("1", "Hello"));
+    store.insert ("phone", create_notification ("4", "Hello"));
+    store.insert ("tablet", create_notification ("5", "Hello"));
+
+    ASSERT_EQ (removed, (std::vector<std::string>{ "2" }));
+    ASSERT_EQ (get_ids (store, "phone"), (std::vector<std::string>{ "3", "1", "4" }));
+
+    ASSERT_TRUE (store.remove ("phone", "3"));
+    ASSERT_FALSE (store.remove ("phone", "3"));
+    ASSERT_EQ (get_ids (store, "phone"), (std::vector<std::string>{ "1", "4" }));
+}
+
+TEST (NotificationStoreTest, popup_test)
+{
+    NotificationStore store (2);
+    int               handle_a = 0, handle_b = 0;
+    // The store never calls into libnotify, so the popups don't have to be real
+    std::shared_ptr<NotifyNotification> popup_a (reinterpret_cast<NotifyNotification*> (&handle_a),
+                                                 [] (NotifyNotification*) {});
+    std::shared_ptr<NotifyNotification> popup_b (reinterpret_cast<NotifyNotification*> (&handle_b),
+                                                 [] (NotifyNotification*) {});
+
+    store.insert ("phone", create_notification ("1", "Hello"));
+    store.insert ("phone", create_notification ("2", "Hello"));
+    store.set_popup ("phone", "1", popup_a);
+    store.set_popup ("phone", "2", popup_b);
+
+    std::string device_id, id;
+    ASSERT_TRUE (store.find_popup (popup_b.get (), device_id, id));
+    ASSERT_EQ (device_id, "phone");
+    ASSERT_EQ (id, "2");
+
+    // Evicting a notification also drops its popup
+    store.insert ("phone", create_notification ("3", "Hello"));
+    ASSERT_FALSE (store.find_popup (popup_a.get (), device_id, id));
+    ASSERT_EQ (store.get_popups (), (std::vector<NotifyNotification*>{ popup_b.get () }));
+
+    store.set_popup ("phone", "2", nullptr);
+    ASSERT_FALSE (store.find_popup (popup_b.get (), device_id, id));
+    ASSERT_EQ (store.get_popup ("phone", "2"), nullptr);
+}
@@ -0,0 +1,360 @@
+/* test_sms_sync.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+#include <conecto.h>
+#include <deque>
+#include "../test_helpers.h"
+
+using namespace Conecto;
+using namespace Conecto::Plugins;
+
+namespace {
+
+// Packets recorded from a phone with two conversations: Thread 1 has the messages 1, 2, 3 (and 5 after the phone has
+// received a new message), thread 2 has message 4
+#define MESSAGE(id, thread, date, type, body)                                                                          \
+    "{\"event\":1,\"body\":\"" body "\",\"addresses\":[{\"address\":\"+49 170 1234567" #thread "\"}],"                 \
+    "\"date\":" #date ",\"type\":" #type ",\"read\":1,\"thread_id\":" #thread ",\"_id\":" #id ",\"sub_id\":1}"
+#define MESSAGES_PACKET(messages)                                                                                      \
+    "{\"id\":1589468401,\"type\":\"kdeconnect.sms.messages\",\"body\":{\"messages\":[" messages "]}}"
+
+constexpr char CONVERSATIONS[] =
+        MESSAGES_PACKET (MESSAGE (3, 1, 3000, 1, "How are you?") "," MESSAGE (4, 2, 2500, 2, "See you"));
+constexpr char CONVERSATIONS_UPDATED[] =
+        MESSAGES_PACKET (MESSAGE (5, 1, 4000, 2, "Fine") "," MESSAGE (4, 2, 2500, 2, "See you"));
+constexpr char THREAD_1_BEFORE_4000[] =
+        MESSAGES_PACKET (MESSAGE (3, 1, 3000, 1, "How are you?") "," MESSAGE (2, 1, 2000, 2, "Hello"));
+constexpr char THREAD_1_BEFORE_3000[] =
+        MESSAGES_PACKET (MESSAGE (2, 1, 2000, 2, "Hello") "," MESSAGE (1, 1, 1000, 1, "Hi"));
+constexpr char THREAD_1_BEFORE_1000[] = MESSAGES_PACKET ("");
+constexpr char THREAD_2_BEFORE_2500[] = MESSAGES_PACKET ("");
+constexpr char LIVE_MESSAGE[] = MESSAGES_PACKET (MESSAGE (6, 2, 5000, 1, "Are you there?"));
+constexpr char PUSHED_THREAD_1[] = MESSAGES_PACKET (MESSAGE (7, 1, 6000, 1, "Hello?"));
+constexpr char PUSHED_THREAD_2[] =
+        MESSAGES_PACKET (MESSAGE (8, 2, 6000, 1, "Call me") "," MESSAGE (9, 2, 6001, 1, "Please"));
+
+#undef MESSAGE
+#undef MESSAGES_PACKET
+
+constexpr int PAGE_SIZE = 2;
+
+/**
+ * Answers requests with recorded packets, the replies are delivered by calling @p replay
+ */
+class FakePeer {
+  public:
+    FakePeer (const char* conversations)
+        : m_conversations (conversations)
+    {
+    }
+
+    void on_request (const NetworkPacket& packet)
+    {
+        std::string request = packet.get_type ();
+        if (packet.get_type () == "kdeconnect.sms.request_conversation") {
+            request += " " + std::to_string (packet.get_body ()["threadID"].asInt64 ()) + " " +
+                       std::to_string (packet.get_body ()["rangeStartTimestamp"].asInt64 ()) + " " +
+                       std::to_string (packet.get_body ()["numberToRequest"].asInt ());
+        }
+        requests.push_back (request);
+
+        if (request == "kdeconnect.sms.request_conversations")
+            m_replies.push_back (m_conversations);
+        else if (request == "kdeconnect.sms.request_conversation 1 4000 2")
+            m_replies.push_back (THREAD_1_BEFORE_4000);
+        else if (request == "kdeconnect.sms.request_conversation 1 3000 2")
+            m_replies.push_back (THREAD_1_BEFORE_3000);
+        else if (request == "kdeconnect.sms.request_conversation 1 1000 2")
+            m_replies.push_back (THREAD_1_BEFORE_1000);
+        else if (request == "kdeconnect.sms.request_conversation 2 2500 2")
+            m_replies.push_back (THREAD_2_BEFORE_2500);
+        else
+            ADD_FAILURE () << "Unexpected request: " << request;
+    }
+
+    /**
+     * Queue a packet which is not a reply to a request
+     */
+    void push (const char* packet) { m_replies.push_back (packet); }
+
+    /**
+     * Deliver all queued packets to @p sync
+     */
+    void replay (SMSSync& sync)
+    {
+        while (replay_next (sync)) {}
+    }
+
+    /**
+     * Deliver the next queued packet to @p sync
+     *
+     * @return false if there was no packet
+     */
+    bool replay_next (SMSSync& sync)
+    {
+        if (m_replies.empty ()) return false;
+        NetworkPacket packet (m_replies.front ());
+        m_replies.pop_front ();
+        sync.handle_messages (packet);
+        return true;
+    }
+
+    /**
+     * Drop all queued packets (e.g. because the connection has been lost)
+     */
+    void disconnect () { m_replies.clear (); }
+
+    std::vector<std::string> requests;
+
+  private:
+    const char*             m_conversations;
+    std::deque<const char*> m_replies;
+};
+
+class MemoryStore : public SMSStore {
+  public:
+    std::map<int64_t, SMSMessage> messages;
+    HighWaterMarks                high_water_marks;
+    std::vector<size_t>           chunk_sizes;
+    // Simulate a database error for every read or write
+    bool failing = false;
+
+  protected:
+    void get_high_water_marks_virt (const Device&, const SlotHighWaterMarks& done) override
+    {
+        if (failing)
+            done (false, HighWaterMarks ());
+        else
+            done (true, high_water_marks);
+    }
+
+    void set_high_water_mark_virt (const Device&, int64_t thread_id, int64_t date) override
+    {
+        high_water_marks[thread_id] = date;
+    }
+
+    void store_messages_virt (const Device&, std::vector<SMSMessage>&& chunk, const SlotStored& done) override
+    {
+        if (!failing) {
+            chunk_sizes.push_back (chunk.size ());
+            for (auto& message : chunk) messages.insert ({ message.message_id, std::move (message) });
+        }
+        if (done) done (!failing);
+    }
+};
+
+std::shared_ptr<Device>
+create_device ()
+{
+    return Testing::create_device ("fake_phone",
+                                   { "kdeconnect.sms.request_conversations", "kdeconnect.sms.request_conversation" },
+                                   { "kdeconnect.sms.messages" });
+}
+
+} // namespace
+
+TEST (SMSSyncTest, parse_test)
+{
+    NetworkPacket packet (CONVERSATIONS);
+    SMSMessage    message;
+    ASSERT_TRUE (SMSMessage::from_json (packet.get_body ()["messages"][0], message));
+    ASSERT_EQ (message.body, "How are you?");
+    ASSERT_EQ (message.address, "+49 170 12345671");
+    ASSERT_EQ (message.date, 3000);
+    ASSERT_TRUE (message.received);
+    ASSERT_TRUE (message.read);
+    ASSERT_EQ (message.thread_id, 1);
+    ASSERT_EQ (message.message_id, 3);
+
+    ASSERT_TRUE (SMSMessage::from_json (packet.get_body ()["messages"][1], message));
+    ASSERT_FALSE (message.received);
+
+    ASSERT_FALSE (SMSMessage::from_json (Json::Value (Json::objectValue), message));
+}
+
+TEST (SMSSyncTest, initial_sync_test)
+{
+    auto     store = std::make_shared<MemoryStore> ();
+    FakePeer peer (CONVERSATIONS);
+    SMSSync  sync (create_device (), store, [&peer] (const NetworkPacket& packet) { peer.on_request (packet); },
+                  PAGE_SIZE);
+    bool     finished = false;
+    sync.signal_finished ().connect ([&finished] () { finished = true; });
+
+    sync.start ();
+    peer.replay (sync);
+
+    ASSERT_TRUE (finished);
+    ASSERT_FALSE (sync.get_is_running ());
+    ASSERT_EQ (peer.requests, (std::vector<std::string>{ "kdeconnect.sms.request_conversations",
+                                                         "kdeconnect.sms.request_conversation 1 3000 2",
+                                                         "kdeconnect.sms.request_conversation 1 1000 2",
+                                                         "kdeconnect.sms.request_conversation 2 2500 2" }));
+    ASSERT_EQ (store->messages.size (), 4);
+    ASSERT_EQ (store->high_water_marks, (SMSStore::HighWaterMarks{ { 1, 3000 }, { 2, 2500 } }));
+    // Every page is stored separately
+    ASSERT_EQ (store->chunk_sizes, (std::vector<size_t>{ 2, 2 }));
+}
+
+TEST (SMSSyncTest, incremental_sync_test)
+{
+    auto store = std::make_shared<MemoryStore> ();
+    store->high_water_marks = { { 1, 3000 }, { 2, 2500 } };
+    FakePeer peer (CONVERSATIONS_UPDATED);
+    SMSSync  sync (create_device (), store, [&peer] (const NetworkPacket& packet) { peer.on_request (packet); },
+                  PAGE_SIZE);
+
+    sync.start ();
+    peer.replay (sync);
+
+    // Thread 2 is up to date and the first page of thread 1 reaches its high-water mark
+    ASSERT_EQ (peer.requests, (std::vector<std::string>{ "kdeconnect.sms.request_conversations",
+                                                         "kdeconnect.sms.request_conversation 1 4000 2" }));
+    ASSERT_EQ (store->messages.size (), 1);
+    ASSERT_EQ (store->messages.at (5).body, "Fine");
+    ASSERT_EQ (store->high_water_marks, (SMSStore::HighWaterMarks{ { 1, 4000 }, { 2, 2500 } }));
+}
+
+TEST (SMSSyncTest, live_message_test)
+{
+    auto     store = std::make_shared<MemoryStore> ();
+    FakePeer peer (CONVERSATIONS);
+    SMSSync  sync (create_device (), store, [&peer] (const NetworkPacket& packet) { peer.on_request (packet); },
+                  PAGE_SIZE);
+
+    // Received right after the list of conversations, while the first page is requested
+    sync.start ();
+    peer.push (LIVE_MESSAGE);
+    peer.replay (sync);
+
+    ASSERT_EQ (store->messages.size (), 5);
+    ASSERT_EQ (store->messages.at (6).thread_id, 2);
+    // Messages which are not part of a requested page don't move the high-water mark
+    ASSERT_EQ (store->high_water_marks.at (2), 2500);
+}
+
+TEST (SMSSyncTest, store_destroyed_test)
+{
+    auto     store = std::make_shared<MemoryStore> ();
+    FakePeer peer (CONVERSATIONS);
+    SMSSync  sync (create_device (), store, [&peer] (const NetworkPacket& packet) { peer.on_request (packet); },
+                  PAGE_SIZE);
+
+    sync.start ();
+    store.reset ();
+    peer.replay (sync);
+
+    ASSERT_FALSE (sync.get_is_running ());
+    ASSERT_EQ (peer.requests.size (), 1);
+}
+
+TEST (SMSSyncTest, abort_test)
+{
+    auto     store = std::make_shared<MemoryStore> ();
+    FakePeer peer (CONVERSATIONS);
+    SMSSync  sync (create_device (), store, [&peer] (const NetworkPacket& packet) { peer.on_request (packet); },
+                  PAGE_SIZE);
+    bool     finished = false;
+    sync.signal_finished ().connect ([&finished] () { finished = true; });
+
+    // The connection is lost while the first page of thread 1 is requested
+    sync.start ();
+    ASSERT_TRUE (peer.replay_next (sync));
+    ASSERT_TRUE (sync.get_is_running ());
+    peer.disconnect ();
+    sync.abort ();
+    ASSERT_FALSE (sync.get_is_running ());
+    ASSERT_FALSE (finished);
+    // No thread has been synced completely
+    ASSERT_TRUE (store->high_water_marks.empty ());
+
+    // The next sync starts over after reconnecting
+    sync.start ();
+    peer.replay (sync);
+
+    ASSERT_TRUE (finished);
+    ASSERT_EQ (peer.requests, (std::vector<std::string>{ "kdeconnect.sms.request_conversations",
+                                                         "kdeconnect.sms.request_conversation 1 3000 2",
+                                                         "kdeconnect.sms.request_conversations",
+                                                         "kdeconnect.sms.request_conversation 1 3000 2",
+                                                         "kdeconnect.sms.request_conversation 1 1000 2",
+                                                         "kdeconnect.sms.request_conversation 2 2500 2" }));
+    ASSERT_EQ (store->messages.size (), 4);
+    ASSERT_EQ (store->high_water_marks, (SMSStore::HighWaterMarks{ { 1, 3000 }, { 2, 2500 } }));
+}
+
+TEST (SMSSyncTest, pushed_message_test)
+{
+    auto     store = std::make_shared<MemoryStore> ();
+    FakePeer peer (CONVERSATIONS);
+    SMSSync  sync (create_device (), store, [&peer] (const NetworkPacket& packet) { peer.on_request (packet); },
+                  PAGE_SIZE);
+
+    // Messages of a single thread pushed before the list of conversations aren't taken as the list
+    sync.start ();
+    sync.handle_messages (NetworkPacket (PUSHED_THREAD_2));
+    ASSERT_TRUE (peer.replay_next (sync));
+    ASSERT_EQ (peer.requests.back (), "kdeconnect.sms.request_conversation 1 3000 2");
+
+    // A message pushed to the requested thread between the request of a page and its reply isn't taken as the page
+    sync.handle_messages (NetworkPacket (PUSHED_THREAD_1));
+    peer.replay (sync);
+
+    ASSERT_FALSE (sync.get_is_running ());
+    ASSERT_EQ (peer.requests, (std::vector<std::string>{ "kdeconnect.sms.request_conversations",
+                                                         "kdeconnect.sms.request_conversation 1 3000 2",
+                                                         "kdeconnect.sms.request_conversation 1 1000 2",
+                                                         "kdeconnect.sms.request_conversation 2 2500 2" }));
+    ASSERT_EQ (store->messages.size (), 7);
+    ASSERT_EQ (store->high_water_marks, (SMSStore::HighWaterMarks{ { 1, 3000 }, { 2, 2500 } }));
+}
+
+TEST (SMSSyncTest, store_failure_test)
+{
+    auto     store = std::make_shared<MemoryStore> ();
+    FakePeer peer (CONVERSATIONS);
+    SMSSync  sync (create_device (), store, [&peer] (const NetworkPacket& packet) { peer.on_request (packet); },
+                  PAGE_SIZE);
+
+    // The sync can't start without its high-water marks
+    store->failing = true;
+    sync.start ();
+    ASSERT_FALSE (sync.get_is_running ());
+    ASSERT_TRUE (peer.requests.empty ());
+
+    // A page which can't be written aborts the sync, without moving the high-water mark
+    store->failing = false;
+    sync.start ();
+    ASSERT_TRUE (peer.replay_next (sync));
+    store->failing = true;
+    ASSERT_TRUE (peer.replay_next (sync));
+    ASSERT_FALSE (sync.get_is_running ());
+    ASSERT_TRUE (store->high_water_marks.empty ());
+
+    // The next sync starts over
+    store->failing = false;
+    peer.disconnect ();
+    sync.start ();
+    peer.replay (sync);
+    ASSERT_FALSE (sync.get_is_running ());
+    ASSERT_EQ (store->messages.size (), 4);
+    ASSERT_EQ (store->high_water_marks, (SMSStore::HighWaterMarks{ { 1, 3000 }, { 2, 2500 } }));
+}
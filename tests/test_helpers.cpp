@@ -0,0 +1,85 @@
+/* test_helpers.cpp
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "test_helpers.h"
+#include <glib.h>
+#include <glib/gstdio.h>
+
+using namespace Testing;
+
+namespace {
+
+void
+remove_recursively (const std::string& path)
+{
+    if (g_file_test (path.c_str (), G_FILE_TEST_IS_DIR) && !g_file_test (path.c_str (), G_FILE_TEST_IS_SYMLINK)) {
+        GDir* dir = g_dir_open (path.c_str (), 0, nullptr);
+        if (dir) {
+            while (const gchar* name = g_dir_read_name (dir)) {
+                gchar* child = g_build_filename (path.c_str (), name, nullptr);
+                remove_recursively (child);
+                g_free (child);
+            }
+            g_dir_close (dir);
+        }
+        g_rmdir (path.c_str ());
+    } else {
+        g_remove (path.c_str ());
+    }
+}
+
+Json::Value
+to_array (const std::vector<std::string>& values)
+{
+    Json::Value res (Json::arrayValue);
+    for (const auto& value : values) res.append (value);
+    return res;
+}
+
+} // namespace
+
+std::shared_ptr<Conecto::Device>
+Testing::create_device (const std::string& device_id, const std::vector<std::string>& incoming_capabilities,
+                        const std::vector<std::string>& outgoing_capabilities)
+{
+    Json::Value body;
+    body["deviceId"] = device_id;
+    body["deviceName"] = "Fake Phone";
+    body["deviceType"] = "phone";
+    body["protocolVersion"] = 7;
+    body["tcpPort"] = 1716;
+    body["incomingCapabilities"] = to_array (incoming_capabilities);
+    body["outgoingCapabilities"] = to_array (outgoing_capabilities);
+    return Conecto::Device::create_from_packet (Conecto::NetworkPacket ("kdeconnect.identity", body, 1589468400),
+                                                Glib::RefPtr<Gio::InetAddress> ());
+}
+
+TemporaryDirectory::TemporaryDirectory (const std::string& name_template)
+{
+    gchar* path = g_dir_make_tmp (name_template.c_str (), nullptr);
+    if (!path) throw "Can't create temporary directory";
+    m_path = path;
+    g_free (path);
+}
+
+TemporaryDirectory::~TemporaryDirectory ()
+{
+    remove_recursively (m_path);
+}
@@ -0,0 +1,59 @@
+/* test_helpers.h
+ *
+ * Copyright 2020 Hannes Schulze <haschu0103@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <conecto.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Testing {
+
+/**
+ * @brief Create a phone as announced by its identity packet
+ *
+ * @param incoming_capabilities Packet types the phone accepts
+ * @param outgoing_capabilities Packet types the phone sends
+ */
+std::shared_ptr<Conecto::Device> create_device (const std::string&              device_id = "fake_phone",
+                                                const std::vector<std::string>& incoming_capabilities = {},
+                                                const std::vector<std::string>& outgoing_capabilities = {});
+
+/**
+ * @brief A new directory for the files of a test, removed with all its contents when destroyed
+ */
+class TemporaryDirectory {
+  public:
+    /**
+     * @param name_template Name of the directory (in the system's temporary directory), ending with XXXXXX
+     */
+    explicit TemporaryDirectory (const std::string& name_template);
+    ~TemporaryDirectory ();
+    TemporaryDirectory (const TemporaryDirectory&) = delete;
+    TemporaryDirectory& operator= (const TemporaryDirectory&) = delete;
+
+    const std::string& get_path () const noexcept { return m_path; }
+
+  private:
+    std::string m_path;
+};
+
+} // namespace Testing